@@ -8,169 +8,658 @@
 #include <chrono>
 #include <sstream>
 #include <algorithm>
+#include <map>
+#include <cstring>
+#include <set>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <tuple>
+#include <deque>
+#include <cmath>
+#include <atomic>
+#include <csignal>
+#include <cerrno>
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <new>
+#include <filesystem>
+#include <functional>
+#include <utility>
+#include <optional>
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define RAILWAY_HAS_COROUTINES 1
+#else
+#define RAILWAY_HAS_COROUTINES 0
+#endif
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <cxxabi.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 // This header file must be in the same folder as your .cpp file.
 #include "sqlite3.h"
 
-// --- Class Forward Declarations ---
-class Train;
-class Booking;
-
 // ===================================================================
-//  DatabaseManager Class (Singleton)
-//  Handles all interactions with the SQLite database.
+//  Metrics
+//  Named measurement regions. A region is entered with METRICS_SCOPE
+//  at the top of a menu action or DatabaseManager call and records
+//  calls and wall time. Builds with -DRAILWAY_ALLOC_PROFILE also
+//  replace the global operator new/delete and attribute allocations,
+//  bytes and peak live bytes to every region active on the thread.
+//  With RAILWAY_PERF set in the environment, each scope also reads
+//  CPU time and hardware counters (Linux perf_event_open) at entry
+//  and exit.
 // ===================================================================
-class DatabaseManager {
-public:
-    static DatabaseManager& getInstance() {
-        static DatabaseManager instance;
-        return instance;
+namespace Metrics {
+#ifdef RAILWAY_ALLOC_PROFILE
+    constexpr bool ALLOC_PROFILING = true;
+#else
+    constexpr bool ALLOC_PROFILING = false;
+#endif
+
+    enum Counter { CPU_NANOS, CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, COUNTER_COUNT };
+
+    struct CounterSample {
+        unsigned long long value[COUNTER_COUNT];
+    };
+
+    struct Region {
+        explicit Region(const char* regionName) : name(regionName) {}
+        const char* name;
+        std::atomic<unsigned long long> calls{0};
+        std::atomic<unsigned long long> nanos{0};
+        std::atomic<unsigned long long> allocations{0};
+        std::atomic<unsigned long long> bytes{0};
+        std::atomic<long long> peakLiveBytes{0};
+        std::atomic<unsigned long long> counters[COUNTER_COUNT] = {};
+    };
+
+    // Allocation counters for one thread or one active scope. Plain data so the
+    // thread_local instances need no constructor and are safe to touch from operator new.
+    struct AllocCounters {
+        unsigned long long allocations;
+        unsigned long long bytes;
+        long long liveBytes;
+        long long peakLiveBytes;
+    };
+
+    // Deeper scopes still count calls and time, but not allocations
+    constexpr int MAX_SCOPE_DEPTH = 16;
+    thread_local AllocCounters threadAllocs;
+    thread_local AllocCounters scopeAllocs[MAX_SCOPE_DEPTH];
+    thread_local int scopeDepth;
+
+    inline void recordAllocation(std::size_t size) {
+        int depth = std::min(scopeDepth, MAX_SCOPE_DEPTH);
+        threadAllocs.allocations++;
+        threadAllocs.bytes += size;
+        threadAllocs.liveBytes += static_cast<long long>(size);
+        threadAllocs.peakLiveBytes = std::max(threadAllocs.peakLiveBytes, threadAllocs.liveBytes);
+        for (int i = 0; i < depth; ++i) {
+            AllocCounters& frame = scopeAllocs[i];
+            frame.allocations++;
+            frame.bytes += size;
+            frame.liveBytes += static_cast<long long>(size);
+            frame.peakLiveBytes = std::max(frame.peakLiveBytes, frame.liveBytes);
+        }
     }
 
-    // Executes non-query SQL (INSERT, UPDATE, DELETE, CREATE)
-    bool executeUpdate(const std::string& sql) {
-        char* zErrMsg = nullptr;
-        int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &zErrMsg);
-        if (rc != SQLITE_OK) {
-            std::cerr << "SQL error: " << zErrMsg << std::endl;
-            sqlite3_free(zErrMsg);
-            return false;
+    // Blocks allocated before a scope began still lower its live bytes when freed inside it
+    inline void recordFree(std::size_t size) {
+        int depth = std::min(scopeDepth, MAX_SCOPE_DEPTH);
+        threadAllocs.liveBytes -= static_cast<long long>(size);
+        for (int i = 0; i < depth; ++i) scopeAllocs[i].liveBytes -= static_cast<long long>(size);
+    }
+
+    bool countersEnabled() {
+        static const bool enabled = std::getenv("RAILWAY_PERF") != nullptr;
+        return enabled;
+    }
+
+    // Bit per Counter, set once any thread has opened that event
+    std::atomic<unsigned> countersAvailable{0};
+
+    // Per-thread perf event descriptors, closed when the thread exits: -2 not opened yet, -1 unsupported here
+    struct ThreadCounters {
+        int fds[COUNTER_COUNT] = {-2, -2, -2, -2, -2};
+
+        ~ThreadCounters() {
+#ifdef __linux__
+            for (int fd : fds) {
+                if (fd >= 0) ::close(fd);
+            }
+#endif
         }
-        return true;
+    };
+    thread_local ThreadCounters threadCounters;
+
+    void openCounters() {
+#ifdef __linux__
+        const std::pair<unsigned, unsigned long long> events[COUNTER_COUNT] = {
+            {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[i].first;
+            attr.config = events[i].second;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            threadCounters.fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+            if (threadCounters.fds[i] >= 0) countersAvailable |= 1u << i;
+        }
+#else
+        for (int i = 0; i < COUNTER_COUNT; ++i) threadCounters.fds[i] = -1;
+#endif
     }
 
-    // Executes a SELECT query and returns the results
-    std::vector<std::vector<std::string>> executeQuery(const std::string& sql) {
-        std::vector<std::vector<std::string>> results;
-        char* zErrMsg = nullptr;
-        int rc = sqlite3_exec(db, sql.c_str(), callback, &results, &zErrMsg);
-        if (rc != SQLITE_OK) {
-            std::cerr << "SQL error: " << zErrMsg << std::endl;
-            sqlite3_free(zErrMsg);
+    // Events that could not be opened read as zero
+    void readCounters(CounterSample& sample) {
+        if (threadCounters.fds[0] == -2) openCounters();
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            sample.value[i] = 0;
+#ifdef __linux__
+            if (threadCounters.fds[i] >= 0 && ::read(threadCounters.fds[i], &sample.value[i], sizeof(sample.value[i])) != sizeof(sample.value[i])) {
+                sample.value[i] = 0;
+            }
+#endif
         }
-        return results;
     }
 
-    // Transaction management
-    bool beginTransaction() { return executeUpdate("BEGIN IMMEDIATE TRANSACTION;"); }
-    bool commit() { return executeUpdate("COMMIT;"); }
-    bool rollback() { return executeUpdate("ROLLBACK;"); }
+    // Regions live for the whole process; a deque keeps their addresses stable
+    std::deque<Region>& registry() {
+        static std::deque<Region> regions;
+        return regions;
+    }
 
-private:
-    DatabaseManager() {
-        int rc = sqlite3_open("railway_advanced_oop.db", &db);
-        if (rc) {
-            std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
-            exit(1);
+    std::mutex& registryMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    Region& region(const char* name) {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        for (auto& existing : registry()) {
+            if (std::strcmp(existing.name, name) == 0) return existing;
         }
-        initializeSchema();
+        registry().emplace_back(name);
+        return registry().back();
     }
 
-    ~DatabaseManager() {
-        sqlite3_close(db);
+    class Scope {
+    public:
+        explicit Scope(Region& target) : region(target), depth(scopeDepth++) {
+            if (depth < MAX_SCOPE_DEPTH) scopeAllocs[depth] = AllocCounters{};
+            if (countersEnabled()) readCounters(startCounters);
+            start = std::chrono::steady_clock::now();
+        }
+
+        ~Scope() {
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            if (countersEnabled()) {
+                CounterSample end;
+                readCounters(end);
+                for (int i = 0; i < COUNTER_COUNT; ++i) region.counters[i] += end.value[i] - startCounters.value[i];
+            }
+            --scopeDepth;
+            region.calls++;
+            region.nanos += static_cast<unsigned long long>(elapsed.count());
+            if (!ALLOC_PROFILING || depth >= MAX_SCOPE_DEPTH) return;
+            const AllocCounters& frame = scopeAllocs[depth];
+            region.allocations += frame.allocations;
+            region.bytes += frame.bytes;
+            long long peak = region.peakLiveBytes.load();
+            while (frame.peakLiveBytes > peak && !region.peakLiveBytes.compare_exchange_weak(peak, frame.peakLiveBytes)) {}
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Region& region;
+        int depth;
+        CounterSample startCounters;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // Second table of the report; the caller holds the registry lock
+    void reportCounters(std::ostream& out) {
+        const int W_NAME = 28, W_CPU = 12, W_COUNT = 15, W_IPC = 7, W_MISS = 13;
+        unsigned available = countersAvailable.load();
+        auto cell = [&](const Region& r, Counter counter, int width) {
+            if (available & (1u << counter)) out << std::setw(width) << r.counters[counter].load();
+            else out << std::setw(width) << "n/a";
+        };
+        out << "\n" << std::left << std::setw(W_NAME) << "Region" << std::right << std::setw(W_CPU) << "CPU ms"
+            << std::setw(W_COUNT) << "Cycles" << std::setw(W_COUNT) << "Instructions" << std::setw(W_IPC) << "IPC"
+            << std::setw(W_MISS) << "Cache miss" << std::setw(W_MISS) << "Branch miss" << "\n";
+        out << std::string(W_NAME + W_CPU + 2 * W_COUNT + W_IPC + 2 * W_MISS, '-') << "\n";
+        for (const auto& r : registry()) {
+            if (r.calls.load() == 0) continue;
+            out << std::left << std::setw(W_NAME) << r.name << std::right << std::fixed << std::setprecision(2);
+            if (available & (1u << CPU_NANOS)) out << std::setw(W_CPU) << r.counters[CPU_NANOS].load() / 1e6;
+            else out << std::setw(W_CPU) << "n/a";
+            cell(r, CYCLES, W_COUNT);
+            cell(r, INSTRUCTIONS, W_COUNT);
+            unsigned long long cycles = r.counters[CYCLES].load();
+            if ((available & (1u << CYCLES)) && (available & (1u << INSTRUCTIONS)) && cycles > 0) {
+                out << std::setw(W_IPC) << static_cast<double>(r.counters[INSTRUCTIONS].load()) / cycles;
+            } else {
+                out << std::setw(W_IPC) << "n/a";
+            }
+            cell(r, CACHE_MISSES, W_MISS);
+            cell(r, BRANCH_MISSES, W_MISS);
+            out << "\n";
+        }
+        if ((available >> CYCLES) == 0) out << "Hardware counters are not available (perf_event_paranoid, container or VM).\n";
     }
 
-    DatabaseManager(const DatabaseManager&) = delete;
-    DatabaseManager& operator=(const DatabaseManager&) = delete;
+    void report(std::ostream& out) {
+        const int W_NAME = 28, W_CALLS = 9, W_MS = 12, W_AVG = 11, W_ALLOCS = 12, W_BYTES = 14, W_PEAK = 12;
+        out << std::left << std::setw(W_NAME) << "Region" << std::right << std::setw(W_CALLS) << "Calls"
+            << std::setw(W_MS) << "Total ms" << std::setw(W_AVG) << "Avg us";
+        if (ALLOC_PROFILING) out << std::setw(W_ALLOCS) << "Allocs" << std::setw(W_BYTES) << "Bytes" << std::setw(W_PEAK) << "Peak live";
+        out << "\n" << std::string(W_NAME + W_CALLS + W_MS + W_AVG + (ALLOC_PROFILING ? W_ALLOCS + W_BYTES + W_PEAK : 0), '-') << "\n";
 
-    void initializeSchema() {
-        executeUpdate(
-            "CREATE TABLE IF NOT EXISTS users ("
-            "username TEXT PRIMARY KEY NOT NULL,"
-            "password TEXT NOT NULL);"
-        );
+        std::lock_guard<std::mutex> lock(registryMutex());
+        for (const auto& r : registry()) {
+            unsigned long long calls = r.calls.load();
+            if (calls == 0) continue;
+            double ms = r.nanos.load() / 1e6;
+            out << std::left << std::setw(W_NAME) << r.name << std::right << std::setw(W_CALLS) << calls
+                << std::fixed << std::setprecision(2) << std::setw(W_MS) << ms << std::setw(W_AVG) << ms * 1000.0 / calls;
+            if (ALLOC_PROFILING) {
+                out << std::setw(W_ALLOCS) << r.allocations.load() << std::setw(W_BYTES) << r.bytes.load()
+                    << std::setw(W_PEAK) << r.peakLiveBytes.load();
+            }
+            out << "\n";
+        }
+        if (countersEnabled()) reportCounters(out);
+        if (ALLOC_PROFILING) {
+            out << "This thread: " << threadAllocs.allocations << " allocations, " << threadAllocs.bytes
+                << " bytes, peak live " << threadAllocs.peakLiveBytes << " bytes.\n";
+        } else {
+            out << "Allocation tracking is off; build with -DRAILWAY_ALLOC_PROFILE to enable it.\n";
+        }
+    }
+}
 
-        executeUpdate(
-            "CREATE TABLE IF NOT EXISTS trains ("
-            "train_number TEXT PRIMARY KEY NOT NULL,"
-            "train_name TEXT NOT NULL,"
-            "source TEXT NOT NULL,"
-            "destination TEXT NOT NULL,"
-            "departure_time TEXT NOT NULL,"
-            "journey_duration TEXT NOT NULL,"
-            "total_ac_seats INTEGER NOT NULL,"
-            "total_sleeper_seats INTEGER NOT NULL,"
-            "ac_fare REAL NOT NULL,"
-            "sleeper_fare REAL NOT NULL);"
-        );
+// Declares a static region for this call site and measures the rest of the enclosing block
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+#define METRICS_SCOPE(name) \
+    static Metrics::Region& METRICS_CONCAT(metricsRegion_, __LINE__) = Metrics::region(name); \
+    Metrics::Scope METRICS_CONCAT(metricsScope_, __LINE__)(METRICS_CONCAT(metricsRegion_, __LINE__))
 
-        executeUpdate(
-            "CREATE TABLE IF NOT EXISTS schedules ("
-            "schedule_id INTEGER PRIMARY KEY AUTOINCREMENT,"
-            "train_number TEXT NOT NULL,"
-            "departure_date TEXT NOT NULL,"
-            "ac_seats_available INTEGER NOT NULL,"
-            "sleeper_seats_available INTEGER NOT NULL,"
-            "FOREIGN KEY(train_number) REFERENCES trains(train_number),"
-            "UNIQUE(train_number, departure_date));" // Prevent duplicate schedules
-        );
-        
-        executeUpdate(
-            "CREATE TABLE IF NOT EXISTS bookings ("
-            "ticket_id TEXT PRIMARY KEY NOT NULL,"
-            "username TEXT NOT NULL,"
-            "schedule_id INTEGER NOT NULL,"
-            "class TEXT NOT NULL,"
-            "num_seats INTEGER NOT NULL,"
-            "total_fare REAL NOT NULL,"
-            "date_of_booking TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
-            "FOREIGN KEY(schedule_id) REFERENCES schedules(schedule_id));"
-        );
+#ifdef RAILWAY_ALLOC_PROFILE
+// Each block carries its size in a header so operator delete can account for it
+static constexpr std::size_t ALLOC_HEADER = alignof(std::max_align_t);
 
-        if (executeQuery("SELECT * FROM users WHERE username='admin';").empty()) {
-            executeUpdate("INSERT INTO users (username, password) VALUES ('admin', 'admin123');");
+void* operator new(std::size_t size) {
+    void* block = std::malloc(size + ALLOC_HEADER);
+    if (!block) throw std::bad_alloc();
+    *static_cast<std::size_t*>(block) = size;
+    Metrics::recordAllocation(size);
+    return static_cast<char*>(block) + ALLOC_HEADER;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    void* block = std::malloc(size + ALLOC_HEADER);
+    if (!block) return nullptr;
+    *static_cast<std::size_t*>(block) = size;
+    Metrics::recordAllocation(size);
+    return static_cast<char*>(block) + ALLOC_HEADER;
+}
+
+void operator delete(void* ptr) noexcept {
+    if (!ptr) return;
+    char* block = static_cast<char*>(ptr) - ALLOC_HEADER;
+    Metrics::recordFree(*reinterpret_cast<std::size_t*>(block));
+    std::free(block);
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete[](void* ptr) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { operator delete(ptr); }
+#endif
+
+// ===================================================================
+//  LockProfiler Class (Singleton)
+//  Contention statistics per named lock: acquisitions, how many had
+//  to wait, log2 histograms of wait and hold times, and the call
+//  sites that spent the most time waiting. Fed by InstrumentedMutex
+//  and by DatabaseManager for the SQLite write lock.
+// ===================================================================
+class LockProfiler {
+public:
+    // Bucket i counts durations below 2^i microseconds; the last bucket is open-ended
+    struct Histogram {
+        static const int BUCKETS = 24;
+        unsigned long long counts[BUCKETS] = {};
+        long long maxNanos = 0;
+
+        void add(long long nanos) {
+            int bucket = 0;
+            while (bucket < BUCKETS - 1 && nanos >= (1000LL << bucket)) ++bucket;
+            counts[bucket]++;
+            maxNanos = std::max(maxNanos, nanos);
+        }
+
+        // Upper bound of the bucket holding the given fraction of samples, in microseconds
+        long long percentileMicros(double fraction) const {
+            unsigned long long total = 0, seen = 0;
+            for (auto count : counts) total += count;
+            if (total == 0) return 0;
+            for (int i = 0; i < BUCKETS; ++i) {
+                seen += counts[i];
+                if (seen >= fraction * total) return std::min(1LL << i, maxNanos / 1000);
+            }
+            return maxNanos / 1000;
         }
+    };
+
+    struct SiteStats {
+        unsigned long long contended = 0;
+        long long waitNanos = 0;
+    };
+
+    struct LockStats {
+        explicit LockStats(const char* lockName) : name(lockName) {}
+        const char* name;
+        unsigned long long acquisitions = 0;
+        unsigned long long contended = 0;
+        long long waitNanos = 0;
+        Histogram wait;
+        Histogram hold;
+        std::map<std::string, SiteStats> sites;
+    };
+
+    static LockProfiler& getInstance() {
+        static LockProfiler instance;
+        return instance;
     }
 
-    static int callback(void* data, int argc, char** argv, char** azColName) {
-        auto* rows = static_cast<std::vector<std::vector<std::string>>*>(data);
-        std::vector<std::string> row;
-        for (int i = 0; i < argc; i++) {
-            row.push_back(argv[i] ? argv[i] : "NULL");
+    LockStats& lockStats(const char* name) {
+        std::lock_guard<std::mutex> guard(mutex);
+        for (auto& existing : locks) {
+            if (std::strcmp(existing.name, name) == 0) return existing;
         }
-        rows->push_back(row);
-        return 0;
+        locks.emplace_back(name);
+        return locks.back();
     }
 
-    sqlite3* db;
+    void recordAcquire(LockStats& stats, const char* site, int line, long long waitNanos, bool contended) {
+        std::lock_guard<std::mutex> guard(mutex);
+        stats.acquisitions++;
+        stats.wait.add(waitNanos);
+        if (!contended) return;
+        stats.contended++;
+        stats.waitNanos += waitNanos;
+        SiteStats& siteStats = stats.sites[std::string(site) + ":" + std::to_string(line)];
+        siteStats.contended++;
+        siteStats.waitNanos += waitNanos;
+    }
+
+    void recordRelease(LockStats& stats, long long holdNanos) {
+        std::lock_guard<std::mutex> guard(mutex);
+        stats.hold.add(holdNanos);
+    }
+
+    void report(std::ostream& out) {
+        std::lock_guard<std::mutex> guard(mutex);
+        const int W_NAME = 20, W_COUNT = 10, W_PCT = 8, W_TIME = 11;
+        out << "\n" << std::left << std::setw(W_NAME) << "Lock" << std::right << std::setw(W_COUNT) << "Acquired"
+            << std::setw(W_COUNT) << "Waited" << std::setw(W_PCT) << "Cont %" << std::setw(W_TIME) << "Wait ms"
+            << std::setw(W_TIME) << "Wait p50" << std::setw(W_TIME) << "Wait p99" << std::setw(W_TIME) << "Wait max"
+            << std::setw(W_TIME) << "Hold p50" << std::setw(W_TIME) << "Hold p99" << std::setw(W_TIME) << "Hold max" << "\n";
+        out << std::string(W_NAME + 2 * W_COUNT + W_PCT + 7 * W_TIME, '-') << "\n";
+        std::vector<std::tuple<long long, const char*, std::string, unsigned long long>> topSites;
+        for (const auto& stats : locks) {
+            if (stats.acquisitions == 0) continue;
+            // Percentiles are bucket bounds in microseconds, maxima are exact
+            out << std::left << std::setw(W_NAME) << stats.name << std::right << std::setw(W_COUNT) << stats.acquisitions
+                << std::setw(W_COUNT) << stats.contended << std::fixed << std::setprecision(1)
+                << std::setw(W_PCT) << 100.0 * stats.contended / stats.acquisitions << std::setprecision(2)
+                << std::setw(W_TIME) << stats.waitNanos / 1e6
+                << std::setw(W_TIME) << formatMicros(stats.wait.percentileMicros(0.5))
+                << std::setw(W_TIME) << formatMicros(stats.wait.percentileMicros(0.99))
+                << std::setw(W_TIME) << formatMicros(stats.wait.maxNanos / 1000)
+                << std::setw(W_TIME) << formatMicros(stats.hold.percentileMicros(0.5))
+                << std::setw(W_TIME) << formatMicros(stats.hold.percentileMicros(0.99))
+                << std::setw(W_TIME) << formatMicros(stats.hold.maxNanos / 1000) << "\n";
+            for (const auto& site : stats.sites) {
+                topSites.emplace_back(site.second.waitNanos, stats.name, site.first, site.second.contended);
+            }
+        }
+        if (topSites.empty()) {
+            out << "No contended acquisitions.\n";
+            return;
+        }
+        std::sort(topSites.begin(), topSites.end(), [](const auto& a, const auto& b) { return std::get<0>(a) > std::get<0>(b); });
+        if (topSites.size() > TOP_SITES) topSites.resize(TOP_SITES);
+        out << "Top contended call sites:\n";
+        for (const auto& site : topSites) {
+            out << "  " << std::left << std::setw(W_NAME) << std::get<1>(site) << std::setw(30) << std::get<2>(site) << std::right
+                << std::setw(W_COUNT) << std::get<3>(site) << " waits" << std::setw(W_TIME) << std::fixed << std::setprecision(2)
+                << std::get<0>(site) / 1e6 << " ms\n";
+        }
+    }
+
+private:
+    LockProfiler() {}
+    LockProfiler(const LockProfiler&) = delete;
+    LockProfiler& operator=(const LockProfiler&) = delete;
+
+    static const size_t TOP_SITES = 10;
+
+    static std::string formatMicros(long long micros) {
+        if (micros < 1000) return std::to_string(micros) + "us";
+        if (micros < 1000000) return std::to_string(micros / 1000) + "ms";
+        return std::to_string(micros / 1000000) + "s";
+    }
+
+    // The profiler's own lock is deliberately not instrumented
+    std::mutex mutex;
+    std::deque<LockStats> locks;
 };
 
 // ===================================================================
-//  Date/Time Utility Functions
+//  InstrumentedMutex Class
+//  std::mutex that reports to LockProfiler. Lock through Guard so the
+//  calling function and line are recorded as the call site.
 // ===================================================================
-namespace TimeUtil {
-    std::string calculateArrival(const std::string& departureDate, const std::string& departureTime, const std::string& duration) {
-        std::tm start_tm = {};
-        std::stringstream ss_date(departureDate + " " + departureTime);
-        ss_date >> std::get_time(&start_tm, "%Y-%m-%d %H:%M");
+class InstrumentedMutex {
+public:
+    explicit InstrumentedMutex(const char* name) : stats(LockProfiler::getInstance().lockStats(name)) {}
 
-        int duration_hours = 0, duration_minutes = 0;
-        std::stringstream ss_duration(duration);
-        char colon;
-        ss_duration >> duration_hours >> colon >> duration_minutes;
+    void lock(const char* site = __builtin_FUNCTION(), int line = __builtin_LINE()) {
+        if (mutex.try_lock()) {
+            acquired(site, line, 0, false);
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        mutex.lock();
+        acquired(site, line, elapsedNanos(start), true);
+    }
 
-        auto start_time_point = std::chrono::system_clock::from_time_t(std::mktime(&start_tm));
-        auto end_time_point = start_time_point + std::chrono::hours(duration_hours) + std::chrono::minutes(duration_minutes);
-        
-        std::time_t end_time_t = std::chrono::system_clock::to_time_t(end_time_point);
-        std::tm* end_tm = std::localtime(&end_time_t);
-        
-        std::stringstream result;
-        result << std::put_time(end_tm, "%Y-%m-%d %H:%M");
-        return result.str();
+    bool try_lock(const char* site = __builtin_FUNCTION(), int line = __builtin_LINE()) {
+        if (!mutex.try_lock()) return false;
+        acquired(site, line, 0, false);
+        return true;
+    }
+
+    void unlock() {
+        long long held = elapsedNanos(acquiredAt);
+        mutex.unlock();
+        LockProfiler::getInstance().recordRelease(stats, held);
+    }
+
+    class Guard {
+    public:
+        explicit Guard(InstrumentedMutex& target, const char* site = __builtin_FUNCTION(), int line = __builtin_LINE())
+            : mutex(target) {
+            mutex.lock(site, line);
+        }
+        ~Guard() { mutex.unlock(); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        InstrumentedMutex& mutex;
+    };
+
+    static long long elapsedNanos(std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count();
+    }
+
+private:
+    void acquired(const char* site, int line, long long waitNanos, bool contended) {
+        acquiredAt = std::chrono::steady_clock::now();
+        LockProfiler::getInstance().recordAcquire(stats, site, line, waitNanos, contended);
     }
+
+    std::mutex mutex;
+    LockProfiler::LockStats& stats;
+    std::chrono::steady_clock::time_point acquiredAt;
+};
+
+// Region table followed by lock contention
+void writeMetricsReport(std::ostream& out) {
+    Metrics::report(out);
+    LockProfiler::getInstance().report(out);
+}
+
+// Writes the report when the process exits if RAILWAY_METRICS names a file ("-" for stderr)
+void dumpMetricsAtExit() {
+    if (!std::getenv("RAILWAY_METRICS")) return;
+    // Constructed before the handler is registered, so still alive when it runs
+    Metrics::registry();
+    LockProfiler::getInstance();
+    std::atexit([] {
+        std::string path = std::getenv("RAILWAY_METRICS");
+        if (path == "-") {
+            writeMetricsReport(std::cerr);
+            return;
+        }
+        std::ofstream out(path);
+        if (out) writeMetricsReport(out);
+    });
 }
 
 // ===================================================================
-//  Train Class
+//  PreparedStatement Class
+//  RAII wrapper around sqlite3_stmt for statements that are executed
+//  many times with different parameters (bulk inserts, hot lookups).
+// ===================================================================
+class PreparedStatement {
+public:
+    PreparedStatement(sqlite3* db, const std::string& sql) {
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "SQL prepare error: " << sqlite3_errmsg(db) << std::endl;
+            stmt = nullptr;
+        }
+    }
+
+    ~PreparedStatement() { sqlite3_finalize(stmt); }
+
+    PreparedStatement(PreparedStatement&& other) noexcept : stmt(other.stmt) { other.stmt = nullptr; }
+    PreparedStatement& operator=(PreparedStatement&& other) noexcept {
+        std::swap(stmt, other.stmt);
+        return *this;
+    }
+    PreparedStatement(const PreparedStatement&) = delete;
+    PreparedStatement& operator=(const PreparedStatement&) = delete;
+
+    bool valid() const { return stmt != nullptr; }
+
+    // Parameter indexes are 1-based, as in sqlite3_bind_*
+    void bind(int index, const std::string& value) { sqlite3_bind_text(stmt, index, value.c_str(), static_cast<int>(value.size()), SQLITE_TRANSIENT); }
+    void bind(int index, int value) { sqlite3_bind_int(stmt, index, value); }
+    void bind(int index, long long value) { sqlite3_bind_int64(stmt, index, value); }
+    void bind(int index, double value) { sqlite3_bind_double(stmt, index, value); }
+
+    // Returns SQLITE_ROW, SQLITE_DONE or an error code
+    int step() { return sqlite3_step(stmt); }
+
+    // Runs a statement that returns no rows and rearms it for the next bind
+    bool execute() {
+        int rc = sqlite3_step(stmt);
+        if (rc != SQLITE_DONE) {
+            std::cerr << "SQL error: " << sqlite3_errmsg(sqlite3_db_handle(stmt)) << std::endl;
+        }
+        reset();
+        return rc == SQLITE_DONE;
+    }
+
+    void reset() {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+
+    int columnCount() const { return sqlite3_column_count(stmt); }
+    int columnInt(int column) const { return sqlite3_column_int(stmt, column); }
+    long long columnInt64(int column) const { return sqlite3_column_int64(stmt, column); }
+    double columnDouble(int column) const { return sqlite3_column_double(stmt, column); }
+    std::string columnText(int column) const {
+        const unsigned char* text = sqlite3_column_text(stmt, column);
+        return text ? reinterpret_cast<const char*>(text) : "NULL";
+    }
+
+private:
+    sqlite3_stmt* stmt = nullptr;
+};
+
+// ===================================================================
+//  Row Classes
+//  One typed struct per table; the column layout that maps them to
+//  SQL lives in the Schema table descriptors below.
 // ===================================================================
+class User {
+public:
+    int userId = 0;
+    std::string username, password;
+};
+
 class Train {
 public:
+    int id = 0;
     std::string number, name, source, destination, departureTime, journeyDuration;
+    int totalAcSeats = 0, totalSleeperSeats = 0;
+    double acFare = 0.0, sleeperFare = 0.0;
 
     // ============================ FORMATTING FIX START ============================
-    void displayAsHeader() const {
-        const int W_NUM = 10, W_NAME = 45, W_SRC = 25, W_DEST = 25, W_DEP = 11, W_DUR = 10;
+    // nameWidth shrinks the name column so the table fits narrow terminals
+    void displayAsHeader(int nameWidth = 45) const {
+        const int W_NUM = 10, W_NAME = nameWidth, W_SRC = 25, W_DEST = 25, W_DEP = 11, W_DUR = 10;
         std::cout << std::string(W_NUM + W_NAME + W_SRC + W_DEST + W_DEP + W_DUR + 19, '-') << std::endl;
         std::cout << "| " << std::left << std::setw(W_NUM) << "Train No."
                   << "| " << std::setw(W_NAME) << "Train Name"
@@ -181,24 +670,6726 @@ public:
         std::cout << std::string(W_NUM + W_NAME + W_SRC + W_DEST + W_DEP + W_DUR + 19, '-') << std::endl;
     }
 
-    void displayAsRow() const {
-        const int W_NUM = 10, W_NAME = 45, W_SRC = 25, W_DEST = 25, W_DEP = 11, W_DUR = 10;
+    void displayAsRow(int nameWidth = 45) const {
+        const int W_NUM = 10, W_NAME = nameWidth, W_SRC = 25, W_DEST = 25, W_DEP = 11, W_DUR = 10;
+
+        auto truncate = [](const std::string& str, int width) {
+            if (str.length() > width) {
+                return str.substr(0, width - 1) + "."; // Truncate and add a '.'
+            }
+            return str;
+        };
+
+        std::cout << "| " << std::left << std::setw(W_NUM) << truncate(number, W_NUM)
+                  << "| " << std::setw(W_NAME) << truncate(name, W_NAME)
+                  << "| " << std::setw(W_SRC) << truncate(source, W_SRC)
+                  << "| " << std::setw(W_DEST) << truncate(destination, W_DEST)
+                  << "| " << std::setw(W_DEP) << truncate(departureTime, W_DEP)
+                  << "| " << std::setw(W_DUR) << truncate(journeyDuration, W_DUR) << " |" << std::endl;
+    }
+    // ============================ FORMATTING FIX END ============================
+};
+
+class Schedule {
+public:
+    int scheduleId = 0;
+    int trainId = 0;
+    std::string departureDate;
+    int acSeatsAvailable = 0, sleeperSeatsAvailable = 0;
+};
+
+class Booking {
+public:
+    int scheduleId = 0;
+    long long ticket = 0; // shown to users as "TKT<ticket>"
+    int userId = 0;
+    std::string seatClass;
+    int numSeats = 0;
+    double totalFare = 0.0;
+    std::string dateOfBooking;
+};
+
+// Station position in decimal degrees; city groups the stations of one place
+class Station {
+public:
+    std::string name, city;
+    double latitude = 0.0, longitude = 0.0;
+};
+
+// Coach type: berths per coach and the berth types of one bay ("LB MB UB ..."),
+// repeated along the coach; coaches of the type are labelled prefix + number
+class CoachType {
+public:
+    std::string code, seatClass, labelPrefix, layout;
+    int berths = 0;
+};
+
+// One coach of a train's standard rake
+class TrainCoach {
+public:
+    std::string trainNumber;
+    int position = 0;
+    std::string label, coachType;
+};
+
+// One coach of a departure that runs with its own rake
+class ScheduleCoach {
+public:
+    int scheduleId = 0;
+    int position = 0;
+    std::string label, coachType;
+};
+
+// Discount rule; '*' in category or seatClass matches any, empty dates are open-ended
+class ConcessionRule {
+public:
+    int ruleId = 0;
+    std::string name, category, seatClass, promoCode;
+    double percentOff = 0.0, flatOff = 0.0; // per passenger
+    std::string validFrom, validTo;         // YYYY-MM-DD, inclusive
+    int active = 1;
+};
+
+// ===================================================================
+//  Schema Definitions
+//  Tables are declared once as constexpr column descriptors holding a
+//  pointer to the row member each column maps to. DDL and statement
+//  text are generated from them, and binding or reading a row goes
+//  straight through the member pointers.
+// ===================================================================
+namespace Schema {
+    template <typename Row, typename T>
+    struct Column {
+        const char* name;
+        T Row::* member;
+        const char* definition;
+        bool insertable; // false for AUTOINCREMENT keys and DEFAULT-filled columns
+    };
+
+    template <typename Row, typename T>
+    constexpr Column<Row, T> column(const char* name, T Row::* member, const char* definition, bool insertable = true) {
+        return {name, member, definition, insertable};
+    }
+
+    inline void bindValue(PreparedStatement& stmt, int index, const std::string& value) { stmt.bind(index, value); }
+    inline void bindValue(PreparedStatement& stmt, int index, int value) { stmt.bind(index, value); }
+    inline void bindValue(PreparedStatement& stmt, int index, long long value) { stmt.bind(index, value); }
+    inline void bindValue(PreparedStatement& stmt, int index, double value) { stmt.bind(index, value); }
+
+    inline void readValue(const PreparedStatement& stmt, int column, std::string& value) { value = stmt.columnText(column); }
+    inline void readValue(const PreparedStatement& stmt, int column, int& value) { value = stmt.columnInt(column); }
+    inline void readValue(const PreparedStatement& stmt, int column, long long& value) { value = stmt.columnInt64(column); }
+    inline void readValue(const PreparedStatement& stmt, int column, double& value) { value = stmt.columnDouble(column); }
+
+    template <typename Table, typename F>
+    void forEachColumn(F&& f) {
+        std::apply([&](const auto&... columns) { (f(columns), ...); }, Table::columns);
+    }
+
+    template <typename Table>
+    constexpr int columnCount() { return static_cast<int>(std::tuple_size<decltype(Table::columns)>::value); }
+
+    template <typename Table>
+    const std::string& createSql() {
+        static const std::string sql = [] {
+            std::string s = std::string("CREATE TABLE IF NOT EXISTS ") + Table::name + " (";
+            const char* separator = "";
+            forEachColumn<Table>([&](const auto& c) {
+                s = s + separator + c.name + " " + c.definition;
+                separator = ", ";
+            });
+            if (*Table::constraints) s = s + ", " + Table::constraints;
+            return s + ")" + Table::options + ";";
+        }();
+        return sql;
+    }
+
+    template <typename Table>
+    const std::string& insertSql() {
+        static const std::string sql = [] {
+            std::string names, params;
+            forEachColumn<Table>([&](const auto& c) {
+                if (!c.insertable) return;
+                names += (names.empty() ? "" : ", ") + std::string(c.name);
+                params += params.empty() ? "?" : ", ?";
+            });
+            return std::string("INSERT INTO ") + Table::name + " (" + names + ") VALUES (" + params + ");";
+        }();
+        return sql;
+    }
+
+    // Comma-separated column list in declaration order, optionally qualified by a table alias
+    template <typename Table>
+    std::string columnList(const std::string& alias = "") {
+        std::string list;
+        forEachColumn<Table>([&](const auto& c) {
+            list += (list.empty() ? "" : ", ") + (alias.empty() ? "" : alias + ".") + c.name;
+        });
+        return list;
+    }
+
+    template <typename Table>
+    const std::string& selectSql() {
+        static const std::string sql = "SELECT " + columnList<Table>() + " FROM " + Table::name;
+        return sql;
+    }
+
+    template <typename Table>
+    void bindInsert(PreparedStatement& stmt, const typename Table::Row& row) {
+        int index = 1;
+        forEachColumn<Table>([&](const auto& c) {
+            if (c.insertable) bindValue(stmt, index++, row.*(c.member));
+        });
+    }
+
+    // Reads a row whose columns start at result column 'offset' in declaration order
+    template <typename Table>
+    typename Table::Row readRow(const PreparedStatement& stmt, int offset = 0) {
+        typename Table::Row row;
+        int index = offset;
+        forEachColumn<Table>([&](const auto& c) { readValue(stmt, index++, row.*(c.member)); });
+        return row;
+    }
+
+    struct Users {
+        using Row = User;
+        static constexpr const char* name = "users";
+        static constexpr auto columns = std::make_tuple(
+            column("user_id", &User::userId, "INTEGER PRIMARY KEY", false),
+            column("username", &User::username, "TEXT NOT NULL UNIQUE"),
+            column("password", &User::password, "TEXT NOT NULL"));
+        static constexpr const char* constraints = "";
+        static constexpr const char* options = "";
+    };
+
+    struct Trains {
+        using Row = Train;
+        static constexpr const char* name = "trains";
+        static constexpr auto columns = std::make_tuple(
+            // AUTOINCREMENT: ids of deleted trains are never handed out again
+            column("train_id", &Train::id, "INTEGER PRIMARY KEY AUTOINCREMENT", false),
+            column("train_number", &Train::number, "TEXT NOT NULL UNIQUE"),
+            column("train_name", &Train::name, "TEXT NOT NULL"),
+            column("source", &Train::source, "TEXT NOT NULL"),
+            column("destination", &Train::destination, "TEXT NOT NULL"),
+            column("departure_time", &Train::departureTime, "TEXT NOT NULL"),
+            column("journey_duration", &Train::journeyDuration, "TEXT NOT NULL"),
+            column("total_ac_seats", &Train::totalAcSeats, "INTEGER NOT NULL"),
+            column("total_sleeper_seats", &Train::totalSleeperSeats, "INTEGER NOT NULL"),
+            column("ac_fare", &Train::acFare, "REAL NOT NULL"),
+            column("sleeper_fare", &Train::sleeperFare, "REAL NOT NULL"));
+        static constexpr const char* constraints = "";
+        static constexpr const char* options = "";
+    };
+
+    struct Schedules {
+        using Row = Schedule;
+        static constexpr const char* name = "schedules";
+        static constexpr auto columns = std::make_tuple(
+            column("schedule_id", &Schedule::scheduleId, "INTEGER PRIMARY KEY AUTOINCREMENT", false),
+            column("train_id", &Schedule::trainId, "INTEGER NOT NULL"),
+            column("departure_date", &Schedule::departureDate, "TEXT NOT NULL"),
+            column("ac_seats_available", &Schedule::acSeatsAvailable, "INTEGER NOT NULL"),
+            column("sleeper_seats_available", &Schedule::sleeperSeatsAvailable, "INTEGER NOT NULL"));
+        static constexpr const char* constraints =
+            "FOREIGN KEY(train_id) REFERENCES trains(train_id), "
+            "UNIQUE(train_id, departure_date)"; // Prevent duplicate schedules
+        static constexpr const char* options = "";
+    };
+
+    struct Stations {
+        using Row = Station;
+        static constexpr const char* name = "stations";
+        static constexpr auto columns = std::make_tuple(
+            column("name", &Station::name, "TEXT PRIMARY KEY"),
+            column("city", &Station::city, "TEXT NOT NULL"),
+            column("latitude", &Station::latitude, "REAL NOT NULL"),
+            column("longitude", &Station::longitude, "REAL NOT NULL"));
+        static constexpr const char* constraints = "";
+        static constexpr const char* options = " WITHOUT ROWID";
+    };
+
+    struct CoachTypes {
+        using Row = CoachType;
+        static constexpr const char* name = "coach_types";
+        static constexpr auto columns = std::make_tuple(
+            column("code", &CoachType::code, "TEXT PRIMARY KEY"),
+            column("seat_class", &CoachType::seatClass, "TEXT NOT NULL"),
+            column("berths", &CoachType::berths, "INTEGER NOT NULL"),
+            column("label_prefix", &CoachType::labelPrefix, "TEXT NOT NULL"),
+            column("layout", &CoachType::layout, "TEXT NOT NULL"));
+        static constexpr const char* constraints = "";
+        static constexpr const char* options = " WITHOUT ROWID";
+    };
+
+    struct TrainCoaches {
+        using Row = TrainCoach;
+        static constexpr const char* name = "train_coaches";
+        static constexpr auto columns = std::make_tuple(
+            column("train_number", &TrainCoach::trainNumber, "TEXT NOT NULL"),
+            column("position", &TrainCoach::position, "INTEGER NOT NULL"),
+            column("label", &TrainCoach::label, "TEXT NOT NULL"),
+            column("coach_type", &TrainCoach::coachType, "TEXT NOT NULL"));
+        static constexpr const char* constraints = "PRIMARY KEY(train_number, position)";
+        static constexpr const char* options = " WITHOUT ROWID";
+    };
+
+    // Only departures whose rake differs from their train's have rows here
+    struct ScheduleCoaches {
+        using Row = ScheduleCoach;
+        static constexpr const char* name = "schedule_coaches";
+        static constexpr auto columns = std::make_tuple(
+            column("schedule_id", &ScheduleCoach::scheduleId, "INTEGER NOT NULL"),
+            column("position", &ScheduleCoach::position, "INTEGER NOT NULL"),
+            column("label", &ScheduleCoach::label, "TEXT NOT NULL"),
+            column("coach_type", &ScheduleCoach::coachType, "TEXT NOT NULL"));
+        static constexpr const char* constraints = "PRIMARY KEY(schedule_id, position)";
+        static constexpr const char* options = " WITHOUT ROWID";
+    };
+
+    struct ConcessionRules {
+        using Row = ConcessionRule;
+        static constexpr const char* name = "concession_rules";
+        static constexpr auto columns = std::make_tuple(
+            column("rule_id", &ConcessionRule::ruleId, "INTEGER PRIMARY KEY", false),
+            column("name", &ConcessionRule::name, "TEXT NOT NULL"),
+            column("category", &ConcessionRule::category, "TEXT NOT NULL DEFAULT '*'"),
+            column("seat_class", &ConcessionRule::seatClass, "TEXT NOT NULL DEFAULT '*'"),
+            column("promo_code", &ConcessionRule::promoCode, "TEXT NOT NULL DEFAULT ''"),
+            column("percent_off", &ConcessionRule::percentOff, "REAL NOT NULL DEFAULT 0"),
+            column("flat_off", &ConcessionRule::flatOff, "REAL NOT NULL DEFAULT 0"),
+            column("valid_from", &ConcessionRule::validFrom, "TEXT NOT NULL DEFAULT ''"),
+            column("valid_to", &ConcessionRule::validTo, "TEXT NOT NULL DEFAULT ''"),
+            column("active", &ConcessionRule::active, "INTEGER NOT NULL DEFAULT 1"));
+        static constexpr const char* constraints = "";
+        static constexpr const char* options = "";
+    };
+
+    struct Bookings {
+        using Row = Booking;
+        static constexpr const char* name = "bookings";
+        static constexpr auto columns = std::make_tuple(
+            column("schedule_id", &Booking::scheduleId, "INTEGER NOT NULL"),
+            column("ticket", &Booking::ticket, "INTEGER NOT NULL"),
+            column("user_id", &Booking::userId, "INTEGER NOT NULL"),
+            column("class", &Booking::seatClass, "TEXT NOT NULL"),
+            column("num_seats", &Booking::numSeats, "INTEGER NOT NULL"),
+            column("total_fare", &Booking::totalFare, "REAL NOT NULL"),
+            column("date_of_booking", &Booking::dateOfBooking, "TIMESTAMP DEFAULT CURRENT_TIMESTAMP", false));
+        // Clustered by departure so a schedule's bookings sit on adjacent pages
+        static constexpr const char* constraints =
+            "PRIMARY KEY(schedule_id, ticket), "
+            "FOREIGN KEY(schedule_id) REFERENCES schedules(schedule_id), "
+            "FOREIGN KEY(user_id) REFERENCES users(user_id)";
+        static constexpr const char* options = " WITHOUT ROWID";
+    };
+}
+
+// ===================================================================
+//  DatabaseManager Class (Singleton)
+//  Handles all interactions with the SQLite database.
+// ===================================================================
+class DatabaseManager {
+public:
+    static constexpr const char* DATABASE_FILE = "railway_advanced_oop.db";
+
+    // DATABASE_FILE unless RAILWAY_DB names another file (e.g. a scratch copy for benchmarks)
+    static const char* databasePath() {
+        const char* path = std::getenv("RAILWAY_DB");
+        return path && *path ? path : DATABASE_FILE;
+    }
+
+    static DatabaseManager& getInstance() {
+        static DatabaseManager instance;
+        return instance;
+    }
+
+    // Executes non-query SQL (INSERT, UPDATE, DELETE, CREATE)
+    bool executeUpdate(const std::string& sql) {
+        METRICS_SCOPE("db.executeUpdate");
+        char* zErrMsg = nullptr;
+        int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &zErrMsg);
+        if (rc != SQLITE_OK) {
+            std::cerr << "SQL error: " << zErrMsg << std::endl;
+            sqlite3_free(zErrMsg);
+            return false;
+        }
+        return true;
+    }
+
+    // Executes a SELECT query and returns the results
+    std::vector<std::vector<std::string>> executeQuery(const std::string& sql) {
+        METRICS_SCOPE("db.executeQuery");
+        std::vector<std::vector<std::string>> results;
+        char* zErrMsg = nullptr;
+        int rc = sqlite3_exec(db, sql.c_str(), callback, &results, &zErrMsg);
+        if (rc != SQLITE_OK) {
+            std::cerr << "SQL error: " << zErrMsg << std::endl;
+            sqlite3_free(zErrMsg);
+        }
+        return results;
+    }
+
+    // Transaction management. BEGIN IMMEDIATE takes the database write lock, so the
+    // time it takes is recorded as the wait for "sqlite.write" and the time until
+    // COMMIT or ROLLBACK as its hold time, attributed to the calling function.
+    bool beginTransaction(const char* site = __builtin_FUNCTION(), int line = __builtin_LINE()) {
+        METRICS_SCOPE("db.beginTransaction");
+        busyWaits = 0;
+        auto start = std::chrono::steady_clock::now();
+        if (!executeUpdate("BEGIN IMMEDIATE TRANSACTION;")) return false;
+        LockProfiler::getInstance().recordAcquire(writeLock, site, line, InstrumentedMutex::elapsedNanos(start), busyWaits > 0);
+        transactionStart = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    bool commit() {
+        METRICS_SCOPE("db.commit");
+        if (!executeUpdate("COMMIT;")) return false;
+        LockProfiler::getInstance().recordRelease(writeLock, InstrumentedMutex::elapsedNanos(transactionStart));
+        return true;
+    }
+
+    bool rollback() {
+        METRICS_SCOPE("db.rollback");
+        bool ok = executeUpdate("ROLLBACK;");
+        LockProfiler::getInstance().recordRelease(writeLock, InstrumentedMutex::elapsedNanos(transactionStart));
+        return ok;
+    }
+
+    PreparedStatement prepare(const std::string& sql) {
+        METRICS_SCOPE("db.prepare");
+        return PreparedStatement(db, sql);
+    }
+
+    // Secondary indexes on bookings; bulk loaders drop them and call this afterwards
+    bool createBookingIndexes() {
+        // Covering index so per-schedule seat sums never touch the bookings table itself
+        return executeUpdate(
+                   "CREATE INDEX IF NOT EXISTS idx_bookings_schedule_class "
+                   "ON bookings(schedule_id, class, num_seats);")
+            // Ticket numbers are unique across departures; cancellation looks them up here
+            && executeUpdate("CREATE UNIQUE INDEX IF NOT EXISTS idx_bookings_ticket ON bookings(ticket);")
+            // Covers viewMyBookings: every bookings column it reads is in the index
+            && executeUpdate(
+                   "CREATE INDEX IF NOT EXISTS idx_bookings_user "
+                   "ON bookings(user_id, class, num_seats, total_fare);");
+    }
+
+    bool dropBookingIndexes() {
+        return executeUpdate("DROP INDEX IF EXISTS idx_bookings_schedule_class;")
+            && executeUpdate("DROP INDEX IF EXISTS idx_bookings_ticket;")
+            && executeUpdate("DROP INDEX IF EXISTS idx_bookings_user;");
+    }
+
+    // Inserts one typed row through the statement generated from its table descriptor
+    template <typename Table>
+    bool insertRow(const typename Table::Row& row) {
+        METRICS_SCOPE("db.insertRow");
+        PreparedStatement& stmt = cached(Schema::insertSql<Table>());
+        if (!stmt.valid()) return false;
+        Schema::bindInsert<Table>(stmt, row);
+        return stmt.execute();
+    }
+
+    // Runs the table's SELECT followed by 'suffix' (WHERE/ORDER BY with ? placeholders)
+    template <typename Table>
+    std::vector<typename Table::Row> selectRows(const std::string& suffix = "", const std::vector<std::string>& params = {}) {
+        METRICS_SCOPE("db.selectRows");
+        std::vector<typename Table::Row> rows;
+        PreparedStatement& stmt = cached(Schema::selectSql<Table>() + " " + suffix + ";");
+        if (!stmt.valid()) return rows;
+        for (size_t i = 0; i < params.size(); ++i) stmt.bind(static_cast<int>(i) + 1, params[i]);
+        while (stmt.step() == SQLITE_ROW) rows.push_back(Schema::readRow<Table>(stmt));
+        stmt.reset();
+        return rows;
+    }
+
+    // Rows modified by the most recent INSERT, UPDATE or DELETE
+    int changes() const { return sqlite3_changes(db); }
+
+private:
+    DatabaseManager() {
+        int rc = sqlite3_open(databasePath(), &db);
+        if (rc) {
+            std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+            exit(1);
+        }
+        sqlite3_busy_handler(db, busyHandler, this);
+        initializeSchema();
+    }
+
+    ~DatabaseManager() {
+        statements.clear(); // finalized before the connection closes
+        sqlite3_close(db);
+    }
+
+    DatabaseManager(const DatabaseManager&) = delete;
+    DatabaseManager& operator=(const DatabaseManager&) = delete;
+
+    // How long a statement retries while another connection holds a conflicting lock
+    static const int BUSY_TIMEOUT_MS = 5000;
+
+    // Called by SQLite while the database is locked; returning 0 gives up with SQLITE_BUSY
+    static int busyHandler(void* self, int attempt) {
+        static const int delaysMs[] = {1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100};
+        const int steps = sizeof(delaysMs) / sizeof(delaysMs[0]);
+        auto* manager = static_cast<DatabaseManager*>(self);
+        if (attempt == 0) manager->busyWaitedMs = 0;
+        int delay = delaysMs[std::min(attempt, steps - 1)];
+        if (manager->busyWaitedMs + delay > BUSY_TIMEOUT_MS) return 0;
+        manager->busyWaits++;
+        sqlite3_sleep(delay);
+        manager->busyWaitedMs += delay;
+        return 1;
+    }
+
+    // Bumped whenever initializeSchema needs to migrate existing data (PRAGMA user_version)
+    static const int SCHEMA_VERSION = 3;
+
+    void initializeSchema() {
+        if (userVersion() < 2 && !executeQuery("SELECT 1 FROM pragma_table_info('bookings') WHERE name = 'ticket_id';").empty()) {
+            migrateToIntegerKeys();
+        }
+        if (userVersion() < 3 && !executeQuery("SELECT 1 FROM sqlite_master WHERE name = 'trains' AND sql NOT LIKE '%AUTOINCREMENT%';").empty()) {
+            migrateTrainIdsToAutoincrement();
+        }
+
+        // Readers on pooled connections then never block the booking writer, nor it them
+        executeUpdate("PRAGMA journal_mode = WAL;");
+
+        executeUpdate(Schema::createSql<Schema::Users>());
+        executeUpdate(Schema::createSql<Schema::Trains>());
+        executeUpdate(Schema::createSql<Schema::Schedules>());
+        executeUpdate(Schema::createSql<Schema::Bookings>());
+        executeUpdate(Schema::createSql<Schema::ConcessionRules>());
+        executeUpdate(Schema::createSql<Schema::Stations>());
+        executeUpdate(Schema::createSql<Schema::CoachTypes>());
+        executeUpdate(Schema::createSql<Schema::TrainCoaches>());
+        executeUpdate(Schema::createSql<Schema::ScheduleCoaches>());
+
+        // Standard coach types. Types are never modified once defined, because departure capacities are built from them
+        executeUpdate(
+            "INSERT OR IGNORE INTO coach_types (code, seat_class, berths, label_prefix, layout) VALUES "
+            "('1A', 'AC', 24, 'H', 'LB UB'), "
+            "('2A', 'AC', 48, 'A', 'LB UB LB UB SL SU'), "
+            "('3A', 'AC', 64, 'B', 'LB MB UB LB MB UB SL SU'), "
+            "('SL', 'Sleeper', 72, 'S', 'LB MB UB LB MB UB SL SU');");
+
+        createBookingIndexes();
+
+        // Bookable departures are listed by date
+        executeUpdate("CREATE INDEX IF NOT EXISTS idx_schedules_date ON schedules(departure_date, train_id);");
+
+        // Intermediate stops; offsets are minutes after the origin departure
+        executeUpdate(
+            "CREATE TABLE IF NOT EXISTS train_stops ("
+            "train_number TEXT NOT NULL,"
+            "stop_seq INTEGER NOT NULL,"
+            "station TEXT NOT NULL,"
+            "arrival_offset INTEGER NOT NULL,"
+            "departure_offset INTEGER NOT NULL,"
+            "PRIMARY KEY(train_number, stop_seq)) WITHOUT ROWID;"
+        );
+
+        // Live delay estimates per departure and stop
+        executeUpdate(
+            "CREATE TABLE IF NOT EXISTS running_status ("
+            "schedule_id INTEGER NOT NULL,"
+            "stop_seq INTEGER NOT NULL,"
+            "delay_minutes INTEGER NOT NULL,"
+            "observed INTEGER NOT NULL,"
+            "version INTEGER NOT NULL DEFAULT 0,"
+            "PRIMARY KEY(schedule_id, stop_seq)) WITHOUT ROWID;"
+        );
+        // Each flush stamps its rows with the next version, so other processes can read only what changed
+        if (executeQuery("SELECT 1 FROM pragma_table_info('running_status') WHERE name = 'version';").empty()) {
+            executeUpdate("ALTER TABLE running_status ADD COLUMN version INTEGER NOT NULL DEFAULT 0;");
+        }
+        executeUpdate("CREATE INDEX IF NOT EXISTS idx_running_status_version ON running_status(version);");
+
+        // Guaranteed connections: the connecting departure is held for a late feeder
+        executeUpdate(
+            "CREATE TABLE IF NOT EXISTS connections ("
+            "feeder_schedule_id INTEGER NOT NULL,"
+            "station TEXT NOT NULL,"
+            "connecting_schedule_id INTEGER NOT NULL,"
+            "min_transfer_minutes INTEGER NOT NULL,"
+            "PRIMARY KEY(feeder_schedule_id, station, connecting_schedule_id)) WITHOUT ROWID;"
+        );
+
+        if (executeQuery("SELECT * FROM users WHERE username='admin';").empty()) {
+            executeUpdate("INSERT INTO users (username, password) VALUES ('admin', 'admin123');");
+        }
+        executeUpdate("PRAGMA user_version = " + std::to_string(SCHEMA_VERSION) + ";");
+    }
+
+    int userVersion() {
+        auto rows = executeQuery("PRAGMA user_version;");
+        return rows.empty() ? 0 : std::stoi(rows[0][0]);
+    }
+
+    // Version 1 keyed users and trains by TEXT and bookings by a TEXT ticket_id.
+    // Rebuilds the four core tables with integer keys in one transaction.
+    void migrateToIntegerKeys() {
+        std::cout << "Migrating database to integer keys...\n";
+        // Renaming must not rewrite references in other tables to the *_v1 names
+        executeUpdate("PRAGMA legacy_alter_table = ON;");
+        bool ok = beginTransaction()
+            && executeUpdate("DROP INDEX IF EXISTS idx_bookings_schedule_class;")
+            && executeUpdate("ALTER TABLE users RENAME TO users_v1;")
+            && executeUpdate("ALTER TABLE trains RENAME TO trains_v1;")
+            && executeUpdate("ALTER TABLE schedules RENAME TO schedules_v1;")
+            && executeUpdate("ALTER TABLE bookings RENAME TO bookings_v1;")
+            && executeUpdate(Schema::createSql<Schema::Users>())
+            && executeUpdate(Schema::createSql<Schema::Trains>())
+            && executeUpdate(Schema::createSql<Schema::Schedules>())
+            && executeUpdate(Schema::createSql<Schema::Bookings>())
+            && executeUpdate("INSERT INTO users (username, password) SELECT username, password FROM users_v1;")
+            && executeUpdate(
+                "INSERT INTO trains (train_number, train_name, source, destination, departure_time, journey_duration, "
+                "total_ac_seats, total_sleeper_seats, ac_fare, sleeper_fare) SELECT train_number, train_name, source, destination, "
+                "departure_time, journey_duration, total_ac_seats, total_sleeper_seats, ac_fare, sleeper_fare FROM trains_v1;")
+            // Schedules orphaned by a deleted train keep a unique negative train_id so their bookings survive
+            && executeUpdate(
+                "INSERT INTO schedules (schedule_id, train_id, departure_date, ac_seats_available, sleeper_seats_available) "
+                "SELECT s.schedule_id, IFNULL(t.train_id, -s.schedule_id), s.departure_date, s.ac_seats_available, s.sleeper_seats_available "
+                "FROM schedules_v1 s LEFT JOIN trains t ON t.train_number = s.train_number;")
+            && executeUpdate(
+                "INSERT INTO bookings (schedule_id, ticket, user_id, class, num_seats, total_fare, date_of_booking) "
+                "SELECT b.schedule_id, CASE WHEN b.ticket_id GLOB 'TKT[0-9]*' THEN CAST(SUBSTR(b.ticket_id, 4) AS INTEGER) "
+                "ELSE 1000000000 + b.rowid END, IFNULL(u.user_id, 0), b.class, b.num_seats, b.total_fare, b.date_of_booking "
+                "FROM bookings_v1 b LEFT JOIN users u ON u.username = b.username;")
+            && executeUpdate("DROP TABLE bookings_v1;")
+            && executeUpdate("DROP TABLE schedules_v1;")
+            && executeUpdate("DROP TABLE trains_v1;")
+            && executeUpdate("DROP TABLE users_v1;");
+        if (ok && commit()) {
+            executeUpdate("PRAGMA legacy_alter_table = OFF;");
+            executeUpdate("VACUUM;");
+            return;
+        }
+        rollback();
+        executeUpdate("PRAGMA legacy_alter_table = OFF;");
+        std::cerr << "Migration to integer keys failed; the database was left unchanged." << std::endl;
+        exit(1);
+    }
+
+    // Version 2 declared train_id without AUTOINCREMENT, so a new train could take the id of a deleted one
+    // and inherit its departures. Rebuilds trains with the same ids and reserves every id already used.
+    void migrateTrainIdsToAutoincrement() {
+        executeUpdate("PRAGMA legacy_alter_table = ON;");
+        const std::string columns = Schema::columnList<Schema::Trains>();
+        bool ok = beginTransaction()
+            && executeUpdate("ALTER TABLE trains RENAME TO trains_v2;")
+            && executeUpdate(Schema::createSql<Schema::Trains>())
+            && executeUpdate("INSERT INTO trains (" + columns + ") SELECT " + columns + " FROM trains_v2;")
+            && executeUpdate("DROP TABLE trains_v2;")
+            // Departures of trains deleted earlier may still carry ids above the current maximum
+            && executeUpdate("DELETE FROM sqlite_sequence WHERE name = 'trains';")
+            && executeUpdate(
+                "INSERT INTO sqlite_sequence (name, seq) SELECT 'trains', MAX(IFNULL((SELECT MAX(train_id) FROM trains), 0), "
+                "IFNULL((SELECT MAX(train_id) FROM schedules), 0));");
+        if (ok && commit()) {
+            executeUpdate("PRAGMA legacy_alter_table = OFF;");
+            return;
+        }
+        rollback();
+        executeUpdate("PRAGMA legacy_alter_table = OFF;");
+        std::cerr << "Migration of train ids failed; the database was left unchanged." << std::endl;
+        exit(1);
+    }
+
+    static int callback(void* data, int argc, char** argv, char** azColName) {
+        auto* rows = static_cast<std::vector<std::vector<std::string>>*>(data);
+        std::vector<std::string> row;
+        for (int i = 0; i < argc; i++) {
+            row.push_back(argv[i] ? argv[i] : "NULL");
+        }
+        rows->push_back(row);
+        return 0;
+    }
+
+    // Statement for 'sql', prepared on first use and kept for the life of the connection;
+    // one that failed to prepare is tried again next time
+    PreparedStatement& cached(const std::string& sql) {
+        auto it = statements.find(sql);
+        if (it == statements.end()) return statements.emplace(sql, prepare(sql)).first->second;
+        if (!it->second.valid()) it->second = prepare(sql);
+        return it->second;
+    }
+
+    sqlite3* db;
+    std::unordered_map<std::string, PreparedStatement> statements; // generated row statements, by SQL
+    LockProfiler::LockStats& writeLock = LockProfiler::getInstance().lockStats("sqlite.write");
+    int busyWaits = 0;
+    int busyWaitedMs = 0;
+    std::chrono::steady_clock::time_point transactionStart;
+};
+
+// ===================================================================
+//  ConnectionPool Class (Singleton)
+//  Read workload classes with their own connection slice, concurrency
+//  limit and statement deadline. Bookings stay on the DatabaseManager
+//  connection (the one writer); reads get pooled read-only
+//  connections. In WAL mode readers never block the writer, in this
+//  process or any other, which is what keeps admin analytics from
+//  holding up bookings. A progress handler aborts a statement when
+//  its deadline passes or its class is cancelled. There is no
+//  booking class and reports do not yield to bookings.
+// ===================================================================
+enum class WorkloadClass { UserRead, AdminReport };
+
+class ConnectionPool {
+    struct State;
+
+public:
+    struct ClassLimits {
+        const char* name;
+        int maxConcurrent;
+        int deadlineMs;          // 0: no deadline
+    };
+
+    class Lease {
+    public:
+        Lease() {}
+        Lease(Lease&& other) noexcept { *this = std::move(other); }
+        Lease& operator=(Lease&& other) noexcept {
+            std::swap(pool, other.pool);
+            std::swap(state, other.state);
+            return *this;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { if (pool) pool->release(state); }
+
+        // False when no slot of the class came free before its deadline
+        bool valid() const { return state != nullptr; }
+
+        sqlite3* connection() const { return state ? state->connection : nullptr; }
+
+        // Why the last statement was interrupted, or empty
+        std::string interruption() const {
+            if (!state) return "no free connection";
+            switch (state->stopReason.load()) {
+                case STOP_DEADLINE: return "deadline exceeded";
+                case STOP_CANCELLED: return "cancelled";
+                default: return "";
+            }
+        }
+
+        // Runs a read query on the leased connection
+        bool query(const std::string& sql, std::vector<std::vector<std::string>>& rows) const {
+            if (!connection()) return false;
+            PreparedStatement stmt(connection(), sql);
+            if (!stmt.valid()) return false;
+            int rc;
+            while ((rc = stmt.step()) == SQLITE_ROW) {
+                std::vector<std::string> row;
+                for (int i = 0; i < stmt.columnCount(); ++i) row.push_back(stmt.columnText(i));
+                rows.push_back(std::move(row));
+            }
+            return rc == SQLITE_DONE;
+        }
+
+    private:
+        friend class ConnectionPool;
+        ConnectionPool* pool = nullptr;
+        State* state = nullptr;
+    };
+
+    static ConnectionPool& getInstance() {
+        static ConnectionPool instance;
+        return instance;
+    }
+
+    // Waits for a slot of the class (at most its deadline); check valid() on the result
+    Lease acquire(WorkloadClass workload) {
+        DatabaseManager::getInstance(); // schema and WAL mode are set up before any reader opens
+        const int index = static_cast<int>(workload);
+        const ClassLimits& limits = LIMITS[index];
+        auto now = std::chrono::steady_clock::now();
+        auto deadline = limits.deadlineMs > 0 ? now + std::chrono::milliseconds(limits.deadlineMs)
+                                              : std::chrono::steady_clock::time_point::max();
+        Lease lease;
+        InstrumentedMutex::Guard guard(mutex);
+        auto hasSlot = [&] { return active[index] < limits.maxConcurrent; };
+        if (!hasSlot()) {
+            bool admitted = limits.deadlineMs > 0 ? admission.wait_until(mutex, deadline, hasSlot) : (admission.wait(mutex, hasSlot), true);
+            if (!admitted) return lease;
+        }
+
+        State* state = nullptr;
+        if (!idle[index].empty()) {
+            state = idle[index].back();
+            idle[index].pop_back();
+        } else {
+            owned.emplace_back(new State());
+            state = owned.back().get();
+            state->workload = workload;
+            if (!openReader(*state)) {
+                owned.pop_back();
+                return lease;
+            }
+        }
+        active[index]++;
+        state->deadline = deadline;
+        state->cancelGeneration = cancelGenerations[index].load();
+        state->stopReason = STOP_NONE;
+        lease.pool = this;
+        lease.state = state;
+        return lease;
+    }
+
+    // Interrupts every running statement of the class; async-signal-safe
+    void cancel(WorkloadClass workload) { cancelGenerations[static_cast<int>(workload)]++; }
+
+    static const ClassLimits& limits(WorkloadClass workload) { return LIMITS[static_cast<int>(workload)]; }
+
+#ifndef _WIN32
+    // While alive, Ctrl-C cancels the class's running statements instead of ending the program
+    class InterruptScope {
+    public:
+        explicit InterruptScope(WorkloadClass workload) {
+            interruptTarget = static_cast<int>(workload);
+            struct sigaction action;
+            std::memset(&action, 0, sizeof(action));
+            action.sa_handler = onInterrupt;
+            action.sa_flags = SA_RESTART;
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGINT, &action, &previous);
+        }
+        ~InterruptScope() { sigaction(SIGINT, &previous, nullptr); }
+        InterruptScope(const InterruptScope&) = delete;
+        InterruptScope& operator=(const InterruptScope&) = delete;
+
+    private:
+        static void onInterrupt(int) { getInstance().cancel(static_cast<WorkloadClass>(interruptTarget.load())); }
+        static inline std::atomic<int> interruptTarget{0};
+        struct sigaction previous;
+    };
+#endif
+
+private:
+    enum StopReason { STOP_NONE, STOP_DEADLINE, STOP_CANCELLED };
+
+    struct State {
+        WorkloadClass workload = WorkloadClass::UserRead;
+        sqlite3* connection = nullptr;
+        std::chrono::steady_clock::time_point deadline;
+        unsigned cancelGeneration = 0;
+        std::atomic<int> stopReason{STOP_NONE};
+    };
+
+    static constexpr int CLASS_COUNT = 2;
+    static constexpr ClassLimits LIMITS[CLASS_COUNT] = {
+        {"user-read", 4, 2000},
+        {"admin-report", 1, 30000},
+    };
+    // Virtual machine instructions between progress handler calls
+    static const int PROGRESS_OPS = 1000;
+
+    ConnectionPool() {}
+    ~ConnectionPool() {
+        for (auto& state : owned) {
+            if (state->connection) sqlite3_close(state->connection);
+        }
+    }
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    bool openReader(State& state) {
+        if (sqlite3_open_v2(DatabaseManager::databasePath(), &state.connection, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+            std::cerr << "Can't open read connection: " << sqlite3_errmsg(state.connection) << std::endl;
+            sqlite3_close(state.connection);
+            state.connection = nullptr;
+            return false;
+        }
+        sqlite3_busy_timeout(state.connection, 5000);
+        sqlite3_progress_handler(state.connection, PROGRESS_OPS, onProgress, &state);
+        return true;
+    }
+
+    void release(State* state) {
+        if (!state) return;
+        const int index = static_cast<int>(state->workload);
+        {
+            InstrumentedMutex::Guard guard(mutex);
+            active[index]--;
+            idle[index].push_back(state);
+        }
+        admission.notify_all();
+    }
+
+    // Returning non-zero makes the running statement fail with SQLITE_INTERRUPT
+    static int onProgress(void* context) {
+        State& state = *static_cast<State*>(context);
+        ConnectionPool& pool = getInstance();
+        const int index = static_cast<int>(state.workload);
+        if (pool.cancelGenerations[index].load() != state.cancelGeneration) {
+            state.stopReason = STOP_CANCELLED;
+            return 1;
+        }
+        if (std::chrono::steady_clock::now() >= state.deadline) {
+            state.stopReason = STOP_DEADLINE;
+            return 1;
+        }
+        return 0;
+    }
+
+    InstrumentedMutex mutex{"pool.admission"};
+    std::condition_variable_any admission;
+    int active[CLASS_COUNT] = {};
+    std::vector<State*> idle[CLASS_COUNT];
+    std::vector<std::unique_ptr<State>> owned;
+    std::atomic<unsigned> cancelGenerations[CLASS_COUNT] = {};
+};
+
+constexpr ConnectionPool::ClassLimits ConnectionPool::LIMITS[ConnectionPool::CLASS_COUNT];
+
+#if RAILWAY_HAS_COROUTINES
+// ===================================================================
+//  Task and Executor Classes
+//  Minimal C++20 coroutine runtime. A Task is lazy: it starts when it
+//  is awaited or spawned, and when it finishes it resumes whoever
+//  awaited it. An Executor runs coroutines on a fixed set of threads.
+//  Awaitables that complete on another thread use Executor::current()
+//  to send the coroutine back to the executor it was running on.
+// ===================================================================
+template <typename T>
+class Task;
+
+class TaskPromiseBase {
+public:
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> finished) noexcept {
+            auto continuation = finished.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { error = std::current_exception(); }
+
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+};
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase {
+public:
+    Task<T> get_return_object();
+    void return_value(T result) { value = std::move(result); }
+    std::optional<T> value;
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase {
+public:
+    Task<void> get_return_object();
+    void return_void() {}
+};
+
+template <typename T = void>
+class Task {
+public:
+    using promise_type = TaskPromise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() { if (handle) handle.destroy(); }
+
+    // Awaiting starts the task; the awaiting coroutine resumes when it returns
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+    T await_resume() {
+        if (handle.promise().error) std::rethrow_exception(handle.promise().error);
+        if constexpr (!std::is_void_v<T>) return std::move(*handle.promise().value);
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() { return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this)); }
+inline Task<void> TaskPromise<void>::get_return_object() { return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this)); }
+
+class Executor {
+public:
+    explicit Executor(int threads) {
+        for (int i = 0; i < threads; ++i) workers.emplace_back([this] { work(); });
+    }
+
+    ~Executor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    // The executor whose thread is running the caller, or null
+    static Executor*& current() {
+        thread_local Executor* executor = nullptr;
+        return executor;
+    }
+
+    // Notifies under the lock: once the last task finishes, wait() may return and the executor go away
+    void post(std::coroutine_handle<> coroutine) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.push_back(coroutine);
+        wake.notify_one();
+    }
+
+    // co_await executor.schedule() continues on one of the executor's threads
+    auto schedule() {
+        struct Hop {
+            Executor& executor;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> coroutine) { executor.post(coroutine); }
+            void await_resume() const noexcept {}
+        };
+        return Hop{*this};
+    }
+
+    // Runs a task to completion without anyone awaiting it
+    void spawn(Task<void> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            outstanding++;
+        }
+        detach(*this, std::move(task));
+    }
+
+    // Blocks until every spawned task has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return outstanding == 0; });
+    }
+
+private:
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    static Detached detach(Executor& executor, Task<void> task) {
+        co_await executor.schedule();
+        try {
+            co_await task;
+        } catch (const std::exception& e) {
+            std::cerr << "Task failed: " << e.what() << std::endl;
+        }
+        std::lock_guard<std::mutex> lock(executor.mutex);
+        if (--executor.outstanding == 0) executor.idle.notify_all();
+    }
+
+    void work() {
+        current() = this;
+        for (;;) {
+            std::coroutine_handle<> coroutine;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !ready.empty(); });
+                if (ready.empty()) return;
+                coroutine = ready.front();
+                ready.pop_front();
+            }
+            coroutine.resume();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake, idle;
+    std::deque<std::coroutine_handle<>> ready;
+    std::vector<std::thread> workers;
+    long outstanding = 0;
+    bool stopping = false;
+};
+
+// ===================================================================
+//  AsyncDatabase Class
+//  Awaitable database calls. Statements run on a pool of database
+//  threads, each with its own connection, so the calling thread is
+//  free while SQLite works:
+//      auto result = co_await db.query("SELECT ... WHERE id = ?", {id});
+//      bool ok = co_await db.transaction([&](AsyncDatabase::Connection& c) { ... });
+//  A transaction body runs on one database thread between BEGIN
+//  IMMEDIATE and COMMIT (ROLLBACK if it returns false). On completion
+//  the coroutine resumes on the executor it was suspended on.
+//  GCC 12 destroys some temporaries in a co_await operand twice
+//  (lambdas, braced parameter lists); bind those to locals first.
+// ===================================================================
+class AsyncDatabase {
+public:
+    struct QueryResult {
+        bool ok = false;
+        std::string error;
+        std::vector<std::vector<std::string>> rows;
+        int changes = 0; // rows modified by an INSERT, UPDATE or DELETE
+    };
+
+    // One database thread's connection; only used on that thread
+    class Connection {
+    public:
+        explicit Connection(sqlite3* db) : db(db) {}
+
+        QueryResult query(const std::string& sql, const std::vector<std::string>& params = {}) {
+            METRICS_SCOPE("async.query");
+            QueryResult result;
+            PreparedStatement stmt(db, sql);
+            if (!stmt.valid()) {
+                result.error = sqlite3_errmsg(db);
+                return result;
+            }
+            for (size_t i = 0; i < params.size(); ++i) stmt.bind(static_cast<int>(i) + 1, params[i]);
+            int rc;
+            while ((rc = stmt.step()) == SQLITE_ROW) {
+                std::vector<std::string> row;
+                for (int i = 0; i < stmt.columnCount(); ++i) row.push_back(stmt.columnText(i));
+                result.rows.push_back(std::move(row));
+            }
+            result.ok = rc == SQLITE_DONE;
+            if (!result.ok) result.error = sqlite3_errmsg(db);
+            result.changes = sqlite3_changes(db);
+            return result;
+        }
+
+    private:
+        sqlite3* db;
+    };
+
+    // Suspends the awaiting coroutine while 'work' runs on a database thread; fails at once
+    // without suspending if no database thread could open its connection
+    class Operation {
+    public:
+        Operation(AsyncDatabase& database, std::function<QueryResult(Connection&)> work)
+            : database(database), work(std::move(work)) {
+            if (database.threads() == 0) result.error = "no database connection";
+        }
+
+        bool await_ready() const noexcept { return database.threads() == 0; }
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            Executor* executor = Executor::current();
+            database.submit([this, coroutine, executor](Connection& connection) {
+                result = work(connection);
+                if (executor) executor->post(coroutine);
+                else coroutine.resume();
+            });
+        }
+        QueryResult await_resume() { return std::move(result); }
+
+    private:
+        AsyncDatabase& database;
+        std::function<QueryResult(Connection&)> work;
+        QueryResult result;
+    };
+
+    explicit AsyncDatabase(int threads) {
+        DatabaseManager::getInstance(); // schema and WAL mode are set up before any worker opens
+        for (int i = 0; i < threads; ++i) {
+            sqlite3* db = nullptr;
+            if (sqlite3_open(DatabaseManager::databasePath(), &db) != SQLITE_OK) {
+                std::cerr << "Can't open async database connection: " << sqlite3_errmsg(db) << std::endl;
+                sqlite3_close(db);
+                continue;
+            }
+            sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+            workers.emplace_back([this, db] { work(db); });
+        }
+    }
+
+    ~AsyncDatabase() {
+        {
+            InstrumentedMutex::Guard guard(queueMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    AsyncDatabase(const AsyncDatabase&) = delete;
+    AsyncDatabase& operator=(const AsyncDatabase&) = delete;
+
+    size_t threads() const { return workers.size(); }
+
+    Operation query(std::string sql, std::vector<std::string> params = {}) {
+        return Operation(*this, [sql = std::move(sql), params = std::move(params)](Connection& connection) {
+            return connection.query(sql, params);
+        });
+    }
+
+    // Runs 'body' inside one write transaction; ok is false if it returned false or COMMIT failed
+    Operation transaction(std::function<bool(Connection&)> body) {
+        return Operation(*this, [body = std::move(body)](Connection& connection) {
+            QueryResult result = connection.query("BEGIN IMMEDIATE TRANSACTION;");
+            if (!result.ok) return result;
+            if (!body(connection)) {
+                connection.query("ROLLBACK;");
+                result.ok = false;
+                result.error = "rolled back";
+                return result;
+            }
+            result = connection.query("COMMIT;");
+            if (!result.ok) connection.query("ROLLBACK;");
+            return result;
+        });
+    }
+
+private:
+    static const int BUSY_TIMEOUT_MS = 5000;
+
+    void submit(std::function<void(Connection&)> job) {
+        {
+            InstrumentedMutex::Guard guard(queueMutex);
+            jobs.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+
+    void work(sqlite3* db) {
+        Connection connection(db);
+        for (;;) {
+            std::function<void(Connection&)> job;
+            {
+                InstrumentedMutex::Guard guard(queueMutex);
+                wake.wait(queueMutex, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) break;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job(connection);
+        }
+        sqlite3_close(db);
+    }
+
+    InstrumentedMutex queueMutex{"async.queue"};
+    std::condition_variable_any wake;
+    std::deque<std::function<void(Connection&)>> jobs;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+};
+
+// ===================================================================
+//  AsyncBenchmark Class
+//  Spawns many simulated user requests at once on a small executor.
+//  Each request reads a departure's availability and the user's
+//  bookings; every tenth also runs a write transaction. Reports
+//  throughput, latency and how many requests were in flight at once.
+// ===================================================================
+class AsyncBenchmark {
+public:
+    struct Result {
+        int requests = 0, failed = 0, peakInFlight = 0;
+        double seconds = 0, meanMillis = 0, p99Millis = 0;
+    };
+
+    Result run(int requests, int executorThreads, int databaseThreads) {
+        auto& db = DatabaseManager::getInstance();
+        auto bounds = db.executeQuery("SELECT IFNULL((SELECT MAX(schedule_id) FROM schedules), 1), IFNULL((SELECT MAX(user_id) FROM users), 1);");
+        maxScheduleId = std::stoi(bounds[0][0]);
+        maxUserId = std::stoi(bounds[0][1]);
+        latencies.assign(requests, 0.0);
+
+        AsyncDatabase database(databaseThreads);
+        Executor executor(executorThreads);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < requests; ++i) executor.spawn(request(database, i));
+        executor.wait();
+
+        Result result;
+        result.requests = requests;
+        result.failed = failed;
+        result.peakInFlight = peakInFlight;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::sort(latencies.begin(), latencies.end());
+        for (double latency : latencies) result.meanMillis += latency / requests;
+        result.p99Millis = requests ? latencies[std::min(requests - 1, requests * 99 / 100)] : 0;
+        return result;
+    }
+
+    static void print(const Result& result, int executorThreads, int databaseThreads) {
+        std::cout << result.requests << " requests on " << executorThreads << " executor threads and " << databaseThreads
+                  << " database threads in " << std::fixed << std::setprecision(2) << result.seconds << " s ("
+                  << std::setprecision(0) << (result.seconds > 0 ? result.requests / result.seconds : 0) << " req/s).\n"
+                  << "Latency mean " << std::setprecision(2) << result.meanMillis << " ms, p99 " << result.p99Millis
+                  << " ms; peak " << result.peakInFlight << " in flight; " << result.failed << " failed.\n";
+    }
+
+private:
+    static constexpr const char* AVAILABILITY_SQL = "SELECT ac_seats_available, sleeper_seats_available FROM schedules WHERE schedule_id = ?;";
+    static constexpr const char* USER_BOOKINGS_SQL = "SELECT COUNT(*), IFNULL(SUM(num_seats), 0) FROM bookings WHERE user_id = ?;";
+    static constexpr const char* TOUCH_SQL = "UPDATE schedules SET ac_seats_available = ac_seats_available WHERE schedule_id = ?;";
+
+    Task<void> request(AsyncDatabase& database, int i) {
+        auto start = std::chrono::steady_clock::now();
+        int inFlight = ++active;
+        for (int peak = peakInFlight; inFlight > peak && !peakInFlight.compare_exchange_weak(peak, inFlight);) {}
+
+        std::mt19937 rng(i);
+        std::string scheduleId = std::to_string(1 + rng() % maxScheduleId);
+        std::string userId = std::to_string(1 + rng() % maxUserId);
+        std::vector<std::string> scheduleParams{scheduleId}, userParams{userId};
+        auto availability = co_await database.query(AVAILABILITY_SQL, scheduleParams);
+        auto bookings = co_await database.query(USER_BOOKINGS_SQL, userParams);
+        bool ok = availability.ok && bookings.ok;
+        if (i % 10 == 0) {
+            // Takes the write lock without changing any data
+            auto touch = [scheduleId](AsyncDatabase::Connection& connection) {
+                return connection.query(TOUCH_SQL, {scheduleId}).ok;
+            };
+            auto write = co_await database.transaction(touch);
+            ok = ok && write.ok;
+        }
+
+        if (!ok) failed++;
+        latencies[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        active--;
+    }
+
+    int maxScheduleId = 1, maxUserId = 1;
+    std::vector<double> latencies; // each request writes only its own slot
+    std::atomic<int> active{0}, peakInFlight{0}, failed{0};
+};
+#endif
+
+// ===================================================================
+//  Date/Time Utility Functions
+// ===================================================================
+namespace TimeUtil {
+    std::string calculateArrival(const std::string& departureDate, const std::string& departureTime, const std::string& duration) {
+        METRICS_SCOPE("time.calculateArrival");
+        std::tm start_tm = {};
+        std::stringstream ss_date(departureDate + " " + departureTime);
+        ss_date >> std::get_time(&start_tm, "%Y-%m-%d %H:%M");
+
+        int duration_hours = 0, duration_minutes = 0;
+        std::stringstream ss_duration(duration);
+        char colon;
+        ss_duration >> duration_hours >> colon >> duration_minutes;
+
+        auto start_time_point = std::chrono::system_clock::from_time_t(std::mktime(&start_tm));
+        auto end_time_point = start_time_point + std::chrono::hours(duration_hours) + std::chrono::minutes(duration_minutes);
+        
+        std::time_t end_time_t = std::chrono::system_clock::to_time_t(end_time_point);
+        std::tm* end_tm = std::localtime(&end_time_t);
+        
+        std::stringstream result;
+        result << std::put_time(end_tm, "%Y-%m-%d %H:%M");
+        return result.str();
+    }
+
+    // Days since 1970-01-01 for a proleptic Gregorian date (no time zone involved)
+    long daysFromCivil(int y, unsigned m, unsigned d) {
+        y -= m <= 2;
+        const long era = (y >= 0 ? y : y - 399) / 400;
+        const unsigned yoe = static_cast<unsigned>(y - era * 400);
+        const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<long>(doe) - 719468;
+    }
+
+    // Parses YYYY-MM-DD into a day number; returns false on malformed input
+    bool parseDate(const std::string& date, long& days) {
+        int y = 0, m = 0, d = 0;
+        if (std::sscanf(date.c_str(), "%4d-%2d-%2d", &y, &m, &d) != 3 || m < 1 || m > 12 || d < 1 || d > 31) return false;
+        days = daysFromCivil(y, static_cast<unsigned>(m), static_cast<unsigned>(d));
+        return true;
+    }
+
+    std::string formatDate(long days) {
+        days += 719468;
+        const long era = (days >= 0 ? days : days - 146096) / 146097;
+        const unsigned doe = static_cast<unsigned>(days - era * 146097);
+        const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const unsigned mp = (5 * doy + 2) / 153;
+        const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+        const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+        const long y = static_cast<long>(yoe) + era * 400 + (m <= 2);
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%04ld-%02u-%02u", y, m, d);
+        return buf;
+    }
+
+    // Parses "HH:MM" (also used for durations) into minutes
+    long parseClock(const std::string& clock) {
+        int hours = 0, minutes = 0;
+        std::sscanf(clock.c_str(), "%d:%d", &hours, &minutes);
+        return hours * 60L + minutes;
+    }
+
+    // Formats minutes since 1970-01-01 00:00 as "YYYY-MM-DD HH:MM"
+    std::string formatDateTime(long minutes) {
+        METRICS_SCOPE("time.formatDateTime");
+        long day = (minutes >= 0 ? minutes : minutes - 1439) / 1440;
+        long rest = minutes - day * 1440;
+        char clock[8];
+        std::snprintf(clock, sizeof(clock), "%02d:%02d", static_cast<int>(rest / 60), static_cast<int>(rest % 60));
+        return formatDate(day) + " " + clock;
+    }
+
+    // Today's day number in UTC, matching SQLite's date('now')
+    long today() {
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        return static_cast<long>(seconds / 86400);
+    }
+
+    // 0 = Monday ... 6 = Sunday
+    int weekday(long days) {
+        return static_cast<int>(((days % 7) + 7 + 3) % 7);
+    }
+}
+
+// ===================================================================
+//  SeatReconciler Class
+//  Compares the seat counters stored in schedules against the seats
+//  actually held by bookings and optionally repairs the counters.
+// ===================================================================
+class SeatReconciler {
+public:
+    struct Discrepancy {
+        int scheduleId;
+        std::string trainNumber, departureDate, seatClass;
+        int storedSeats;
+        int expectedSeats; // total seats minus booked seats
+        bool orphan;       // schedule whose train route no longer exists
+        bool corrected;
+    };
+
+    struct Report {
+        int schedulesChecked = 0;
+        int chunks = 0;
+        int corrected = 0;
+        std::vector<Discrepancy> discrepancies;
+    };
+
+    explicit SeatReconciler(int chunkSize = 500) : chunkSize(chunkSize) {}
+
+    // Scans schedules in schedule_id order, one chunk per read statement, so no
+    // lock is held across chunks. Corrections use one short write transaction each.
+    Report run(bool autoCorrect) {
+        auto& db = DatabaseManager::getInstance();
+        Report report;
+        long long lastId = 0;
+
+        while (true) {
+            auto schedules = db.executeQuery(
+                "SELECT s.schedule_id, IFNULL(t.train_number, '#' || s.train_id), s.departure_date, s.ac_seats_available, s.sleeper_seats_available, "
+                "t.total_ac_seats, t.total_sleeper_seats, " + rakeSeatsSql("AC", "s.schedule_id") + ", " + rakeSeatsSql("Sleeper", "s.schedule_id") +
+                " FROM schedules s LEFT JOIN trains t ON s.train_id = t.train_id "
+                "WHERE s.schedule_id > " + std::to_string(lastId) + " ORDER BY s.schedule_id LIMIT " + std::to_string(chunkSize) + ";");
+            if (schedules.empty()) break;
+
+            long long firstId = std::stoll(schedules.front()[0]);
+            lastId = std::stoll(schedules.back()[0]);
+            auto booked = bookedSeatsInRange(firstId, lastId);
+
+            for (const auto& row : schedules) {
+                int scheduleId = std::stoi(row[0]);
+                bool orphan = row[5] == "NULL";
+                // A departure running with its own rake has that rake's capacity, not the train's
+                bool ownRake = row[7] != "NULL";
+                checkClass(report, scheduleId, row, "AC", std::stoi(row[3]), ownRake ? std::stoi(row[7]) : orphan ? 0 : std::stoi(row[5]), booked, orphan);
+                checkClass(report, scheduleId, row, "Sleeper", std::stoi(row[4]), ownRake ? std::stoi(row[8]) : orphan ? 0 : std::stoi(row[6]), booked, orphan);
+            }
+            report.schedulesChecked += static_cast<int>(schedules.size());
+            report.chunks++;
+        }
+
+        if (autoCorrect) {
+            for (auto& d : report.discrepancies) {
+                if (!d.orphan && correct(d)) {
+                    d.corrected = true;
+                    report.corrected++;
+                }
+            }
+        }
+        return report;
+    }
+
+    static void printReport(const Report& report) {
+        std::cout << "Schedules checked: " << report.schedulesChecked << " (" << report.chunks << " chunks)\n";
+        if (report.discrepancies.empty()) {
+            std::cout << "All seat counters match the bookings.\n";
+            return;
+        }
+        const int W_ID = 8, W_NUM = 10, W_DATE = 12, W_CLASS = 8, W_STORED = 8, W_EXP = 9, W_NOTE = 14;
+        std::cout << std::string(W_ID + W_NUM + W_DATE + W_CLASS + W_STORED + W_EXP + W_NOTE + 22, '-') << std::endl;
+        std::cout << "| " << std::left << std::setw(W_ID) << "Sched." << "| " << std::setw(W_NUM) << "Train No."
+                  << "| " << std::setw(W_DATE) << "Date" << "| " << std::setw(W_CLASS) << "Class"
+                  << "| " << std::setw(W_STORED) << "Stored" << "| " << std::setw(W_EXP) << "Expected"
+                  << "| " << std::setw(W_NOTE) << "Status" << " |" << std::endl;
+        std::cout << std::string(W_ID + W_NUM + W_DATE + W_CLASS + W_STORED + W_EXP + W_NOTE + 22, '-') << std::endl;
+        for (const auto& d : report.discrepancies) {
+            std::string status = d.orphan ? "orphan" : (d.corrected ? "corrected" : (d.expectedSeats < 0 ? "overbooked" : "mismatch"));
+            std::cout << "| " << std::left << std::setw(W_ID) << d.scheduleId << "| " << std::setw(W_NUM) << d.trainNumber
+                      << "| " << std::setw(W_DATE) << d.departureDate << "| " << std::setw(W_CLASS) << d.seatClass
+                      << "| " << std::setw(W_STORED) << d.storedSeats << "| " << std::setw(W_EXP) << d.expectedSeats
+                      << "| " << std::setw(W_NOTE) << status << " |" << std::endl;
+        }
+        std::cout << std::string(W_ID + W_NUM + W_DATE + W_CLASS + W_STORED + W_EXP + W_NOTE + 22, '-') << std::endl;
+        std::cout << report.discrepancies.size() << " discrepancies, " << report.corrected << " corrected.\n";
+    }
+
+    // Seats of one class in a departure's own rake; NULL when the departure follows its train's rake
+    static std::string rakeSeatsSql(const std::string& seatClass, const std::string& scheduleId) {
+        return "(SELECT SUM(CASE WHEN ct.seat_class = '" + seatClass + "' THEN ct.berths ELSE 0 END) FROM schedule_coaches c "
+               "JOIN coach_types ct ON ct.code = c.coach_type WHERE c.schedule_id = " + scheduleId + ")";
+    }
+
+private:
+    int chunkSize;
+
+    // Keyed by schedule_id * 2 + (class == "AC" ? 0 : 1)
+    std::map<long long, int> bookedSeatsInRange(long long firstId, long long lastId) {
+        std::map<long long, int> booked;
+        auto rows = DatabaseManager::getInstance().executeQuery(
+            "SELECT schedule_id, class, SUM(num_seats) FROM bookings INDEXED BY idx_bookings_schedule_class "
+            "WHERE schedule_id BETWEEN " + std::to_string(firstId) + " AND " + std::to_string(lastId) +
+            " GROUP BY schedule_id, class;");
+        for (const auto& row : rows) {
+            booked[std::stoll(row[0]) * 2 + (row[1] == "AC" ? 0 : 1)] = std::stoi(row[2]);
+        }
+        return booked;
+    }
+
+    void checkClass(Report& report, int scheduleId, const std::vector<std::string>& row, const std::string& seatClass,
+                    int stored, int total, const std::map<long long, int>& booked, bool orphan) {
+        auto it = booked.find(static_cast<long long>(scheduleId) * 2 + (seatClass == "AC" ? 0 : 1));
+        int expected = total - (it == booked.end() ? 0 : it->second);
+        if (orphan || stored != expected) {
+            report.discrepancies.push_back({scheduleId, row[1], row[2], seatClass, stored, expected, orphan, false});
+        }
+    }
+
+    // Recomputes the counter inside a write transaction that touches only this schedule,
+    // so the writer lock is held for a single index range scan and one row update.
+    bool correct(Discrepancy& d) {
+        auto& db = DatabaseManager::getInstance();
+        std::string seatColumn = (d.seatClass == "AC") ? "ac_seats_available" : "sleeper_seats_available";
+        std::string totalColumn = (d.seatClass == "AC") ? "total_ac_seats" : "total_sleeper_seats";
+        std::string id = std::to_string(d.scheduleId);
+
+        if (!db.beginTransaction()) return false;
+        std::string updateSql =
+            "UPDATE schedules SET " + seatColumn + " = MAX(0, IFNULL(" + rakeSeatsSql(d.seatClass, id) + ", (SELECT " + totalColumn + " FROM trains WHERE train_id = schedules.train_id))"
+            " - (SELECT IFNULL(SUM(num_seats), 0) FROM bookings INDEXED BY idx_bookings_schedule_class WHERE schedule_id = " + id +
+            " AND class = '" + d.seatClass + "')) WHERE schedule_id = " + id + ";";
+        if (!db.executeUpdate(updateSql)) {
+            db.rollback();
+            return false;
+        }
+        return db.commit();
+    }
+};
+
+// ===================================================================
+//  ScheduleRollout Class
+//  Creates departures for a set of trains over a date range in one
+//  transaction, skipping (train_id, departure_date) pairs that
+//  are already scheduled.
+// ===================================================================
+class ScheduleRollout {
+public:
+    struct Result {
+        bool ok = false;
+        long requested = 0;
+        long inserted = 0;
+        std::string error;
+    };
+
+    // weekdayMask is seven '0'/'1' characters, Monday first ("1111100" = weekdays only).
+    // An empty trainNumbers list rolls out every train route.
+    Result run(const std::vector<std::string>& trainNumbers, const std::string& fromDate,
+               const std::string& toDate, const std::string& weekdayMask) {
+        Result result;
+        long first = 0, last = 0;
+        if (!TimeUtil::parseDate(fromDate, first) || !TimeUtil::parseDate(toDate, last) || last < first) {
+            result.error = "Invalid date range.";
+            return result;
+        }
+        if (weekdayMask.size() != 7 || weekdayMask.find_first_not_of("01") != std::string::npos) {
+            result.error = "Weekday mask must be 7 characters of 0/1, Monday first.";
+            return result;
+        }
+
+        std::vector<std::string> dateText;
+        for (long day = first; day <= last; ++day) {
+            if (weekdayMask[TimeUtil::weekday(day)] == '1') dateText.push_back(TimeUtil::formatDate(day));
+        }
+
+        auto& db = DatabaseManager::getInstance();
+        auto trains = db.executeQuery("SELECT train_number, total_ac_seats, total_sleeper_seats, train_id FROM trains;");
+        if (!trainNumbers.empty()) {
+            std::vector<std::vector<std::string>> selected;
+            for (const auto& number : trainNumbers) {
+                auto it = std::find_if(trains.begin(), trains.end(), [&](const std::vector<std::string>& row) { return row[0] == number; });
+                if (it == trains.end()) {
+                    result.error = "Train not found: " + number;
+                    return result;
+                }
+                selected.push_back(*it);
+            }
+            trains.swap(selected);
+        }
+
+        if (!db.beginTransaction()) {
+            result.error = "Could not start transaction.";
+            return result;
+        }
+        PreparedStatement batchInsert = db.prepare(insertSql(static_cast<int>(ROWS_PER_STATEMENT)));
+        if (!batchInsert.valid()) {
+            db.rollback();
+            result.error = "Could not prepare insert statement.";
+            return result;
+        }
+
+        // Rows are buffered as (train, date) index pairs and bound in blocks; the last
+        // partial block goes through a statement sized to the leftover rows.
+        std::vector<std::pair<size_t, size_t>> pending;
+        pending.reserve(ROWS_PER_STATEMENT);
+        auto flush = [&](PreparedStatement& stmt) {
+            for (size_t i = 0; i < pending.size(); ++i) {
+                const auto& train = trains[pending[i].first];
+                int base = static_cast<int>(i) * 4;
+                stmt.bind(base + 1, std::stoi(train[3]));
+                stmt.bind(base + 2, dateText[pending[i].second]);
+                stmt.bind(base + 3, std::stoi(train[1]));
+                stmt.bind(base + 4, std::stoi(train[2]));
+            }
+            if (!stmt.execute()) return false;
+            result.inserted += db.changes();
+            pending.clear();
+            return true;
+        };
+
+        bool ok = true;
+        for (size_t t = 0; t < trains.size() && ok; ++t) {
+            for (size_t d = 0; d < dateText.size() && ok; ++d) {
+                pending.emplace_back(t, d);
+                result.requested++;
+                if (pending.size() == ROWS_PER_STATEMENT) ok = flush(batchInsert);
+            }
+        }
+        if (ok && !pending.empty()) {
+            PreparedStatement tailInsert = db.prepare(insertSql(static_cast<int>(pending.size())));
+            ok = tailInsert.valid() && flush(tailInsert);
+        }
+        if (!ok) {
+            db.rollback();
+            result.error = "Insert failed.";
+            return result;
+        }
+
+        result.ok = db.commit();
+        return result;
+    }
+
+private:
+    static const size_t ROWS_PER_STATEMENT = 128;
+
+    static std::string insertSql(int rows) {
+        std::string sql = "INSERT OR IGNORE INTO schedules (train_id, departure_date, ac_seats_available, sleeper_seats_available) VALUES ";
+        for (int i = 0; i < rows; ++i) {
+            sql += (i == 0) ? "(?, ?, ?, ?)" : ", (?, ?, ?, ?)";
+        }
+        return sql + ";";
+    }
+};
+
+// ===================================================================
+//  RunningStatusBoard Class (Singleton)
+//  Holds live delays per departure and stop. Events update a single
+//  run and walk only the stops and guaranteed connections downstream
+//  of the event, so readers can look up an ETA without recomputing
+//  other trains.
+// ===================================================================
+class RunningStatusBoard {
+public:
+    enum class EventKind { Departed, Arrived, Delayed };
+
+    static RunningStatusBoard& getInstance() {
+        static RunningStatusBoard instance;
+        return instance;
+    }
+
+    // Loads the persisted delays and guaranteed connections of recent and future departures
+    void load() {
+        METRICS_SCOPE("runningStatus.load");
+        auto& db = DatabaseManager::getInstance();
+        applyRows(db.executeQuery(
+            "SELECT r.schedule_id, r.stop_seq, r.delay_minutes, r.observed, r.version FROM running_status r "
+            "JOIN schedules s ON r.schedule_id = s.schedule_id WHERE s.departure_date >= date('now', '-2 day');"));
+        auto connections = db.executeQuery(
+            "SELECT feeder_schedule_id, station, connecting_schedule_id, min_transfer_minutes FROM connections;");
+        for (const auto& row : connections) {
+            connectionsByFeeder.emplace(std::stoi(row[0]), Connection{row[1], std::stoi(row[2]), std::stoi(row[3])});
+        }
+        loaded = true;
+    }
+
+    // Minutes of delay expected at the final stop, 0 when the departure has no live data
+    int arrivalDelay(int scheduleId) const {
+        auto it = runs.find(scheduleId);
+        return (it == runs.end() || it->second.delay.empty()) ? 0 : it->second.delay.back();
+    }
+
+    // Applies one event and returns the number of (departure, stop) estimates that changed
+    int applyEvent(int scheduleId, const std::string& station, EventKind kind, int delayMinutes) {
+        Run* run = findOrLoadRun(scheduleId);
+        if (!run) return -1;
+        auto stop = std::find(run->stations.begin(), run->stations.end(), station);
+        if (stop == run->stations.end()) return -1;
+
+        int changed = 0;
+        std::vector<std::pair<int, size_t>> work;
+        size_t first = static_cast<size_t>(stop - run->stations.begin());
+        if (kind != EventKind::Delayed) {
+            run->observed[first] = true;
+            run->delay[first] = delayMinutes;
+            markDirty(scheduleId, first);
+            changed++;
+            work.emplace_back(scheduleId, first);
+            first++;
+        }
+        changed += propagate(scheduleId, *run, first, delayMinutes, work);
+
+        // Held connections: a late feeder delays the departure it guarantees. Each (departure, stop)
+        // is checked once per event, so a cycle of connections cannot keep the walk going.
+        std::set<std::pair<int, size_t>> visited;
+        while (!work.empty()) {
+            auto item = work.back();
+            work.pop_back();
+            if (!visited.insert(item).second) continue;
+            Run& feeder = runs[item.first];
+            auto range = connectionsByFeeder.equal_range(item.first);
+            for (auto it = range.first; it != range.second; ++it) {
+                auto at = std::find(feeder.stations.begin(), feeder.stations.end(), it->second.station);
+                if (at == feeder.stations.end() || static_cast<size_t>(at - feeder.stations.begin()) < item.second) continue;
+                size_t feederStop = static_cast<size_t>(at - feeder.stations.begin());
+                Run* next = findOrLoadRun(it->second.connectingScheduleId);
+                if (!next) continue;
+                auto depart = std::find(next->stations.begin(), next->stations.end(), it->second.station);
+                if (depart == next->stations.end()) continue;
+                size_t nextStop = static_cast<size_t>(depart - next->stations.begin());
+                long feederEta = feeder.scheduledArrival[feederStop] + feeder.delay[feederStop];
+                long required = feederEta + it->second.minTransferMinutes - next->scheduledDeparture[nextStop];
+                if (required > next->delay[nextStop]) {
+                    changed += propagate(it->second.connectingScheduleId, *next, nextStop, static_cast<int>(required), work);
+                }
+            }
+        }
+        return changed;
+    }
+
+    void addConnection(int feederScheduleId, const std::string& station, int connectingScheduleId, int minTransferMinutes) {
+        connectionsByFeeder.emplace(feederScheduleId, Connection{station, connectingScheduleId, minTransferMinutes});
+        PreparedStatement insert = DatabaseManager::getInstance().prepare(
+            "INSERT OR REPLACE INTO connections (feeder_schedule_id, station, connecting_schedule_id, min_transfer_minutes) VALUES (?, ?, ?, ?);");
+        insert.bind(1, feederScheduleId);
+        insert.bind(2, station);
+        insert.bind(3, connectingScheduleId);
+        insert.bind(4, minTransferMinutes);
+        insert.execute();
+    }
+
+    // Writes the estimates changed since the last flush in one transaction
+    bool flush() {
+        if (dirty.empty()) return true;
+        auto& db = DatabaseManager::getInstance();
+        if (!db.beginTransaction()) return false;
+        auto latest = db.executeQuery("SELECT IFNULL(MAX(version), 0) FROM running_status;");
+        const long long version = (latest.empty() ? 0 : std::stoll(latest[0][0])) + 1;
+        PreparedStatement upsert = db.prepare(
+            "INSERT OR REPLACE INTO running_status (schedule_id, stop_seq, delay_minutes, observed, version) VALUES (?, ?, ?, ?, ?);");
+        for (const auto& key : dirty) {
+            const Run& run = runs[key.first];
+            upsert.bind(1, key.first);
+            upsert.bind(2, static_cast<int>(key.second));
+            upsert.bind(3, run.delay[key.second]);
+            upsert.bind(4, run.observed[key.second] ? 1 : 0);
+            upsert.bind(5, version);
+            if (!upsert.execute()) {
+                db.rollback();
+                return false;
+            }
+        }
+        dirty.clear();
+        return db.commit();
+    }
+
+    bool isLoaded() const { return loaded; }
+
+    // Loads on first use, then reads only the estimates flushed since (by this or another process, e.g. --ingest-status)
+    void sync() {
+        if (!loaded) {
+            load();
+            return;
+        }
+        METRICS_SCOPE("runningStatus.sync");
+        applyRows(DatabaseManager::getInstance().executeQuery(
+            "SELECT schedule_id, stop_seq, delay_minutes, observed, version FROM running_status WHERE version > " +
+            std::to_string(seenVersion) + ";"));
+    }
+
+private:
+    struct Run {
+        std::vector<std::string> stations;
+        std::vector<long> scheduledArrival;   // minutes since 1970-01-01 00:00
+        std::vector<long> scheduledDeparture;
+        std::vector<int> delay;
+        std::vector<char> observed;
+    };
+
+    struct Connection {
+        std::string station;
+        int connectingScheduleId;
+        int minTransferMinutes;
+    };
+
+    std::unordered_map<int, Run> runs;
+    std::unordered_multimap<int, Connection> connectionsByFeeder;
+    std::set<std::pair<int, size_t>> dirty;
+    bool loaded = false;
+    long long seenVersion = 0; // highest running_status version applied
+
+    RunningStatusBoard() = default;
+
+    // Rows of (schedule_id, stop_seq, delay_minutes, observed, version)
+    void applyRows(const std::vector<std::vector<std::string>>& rows) {
+        for (const auto& row : rows) {
+            seenVersion = std::max(seenVersion, std::stoll(row[4]));
+            // Estimates of pending local changes are newer than anything on disk
+            if (dirty.count({std::stoi(row[0]), static_cast<size_t>(std::stoi(row[1]))})) continue;
+            Run* run = findOrLoadRun(std::stoi(row[0]));
+            size_t stop = static_cast<size_t>(std::stoi(row[1]));
+            if (run && stop < run->delay.size()) {
+                run->delay[stop] = std::stoi(row[2]);
+                run->observed[stop] = row[3] == "1";
+            }
+        }
+    }
+
+    void markDirty(int scheduleId, size_t stop) { dirty.emplace(scheduleId, stop); }
+
+    // Carries a delay forward from stop 'from' until an observed stop is reached.
+    // Queues the departure for connection checks if anything moved.
+    int propagate(int scheduleId, Run& run, size_t from, int delayMinutes, std::vector<std::pair<int, size_t>>& work) {
+        int changed = 0;
+        for (size_t i = from; i < run.delay.size() && !run.observed[i]; ++i) {
+            if (run.delay[i] == delayMinutes) continue;
+            run.delay[i] = delayMinutes;
+            markDirty(scheduleId, i);
+            changed++;
+        }
+        if (changed > 0) work.emplace_back(scheduleId, from > 0 ? from - 1 : 0);
+        return changed;
+    }
+
+    // Builds the stop list of a departure from train_stops, or from the route's
+    // source and destination when no intermediate stops are defined
+    Run* findOrLoadRun(int scheduleId) {
+        auto it = runs.find(scheduleId);
+        if (it != runs.end()) return &it->second;
+
+        auto& db = DatabaseManager::getInstance();
+        PreparedStatement info = db.prepare(
+            "SELECT s.departure_date, t.departure_time, t.journey_duration, t.source, t.destination, t.train_number "
+            "FROM schedules s JOIN trains t ON s.train_id = t.train_id WHERE s.schedule_id = ?;");
+        info.bind(1, scheduleId);
+        if (info.step() != SQLITE_ROW) return nullptr;
+        long day = 0;
+        if (!TimeUtil::parseDate(info.columnText(0), day)) return nullptr;
+        long start = day * 1440 + TimeUtil::parseClock(info.columnText(1));
+
+        Run run;
+        PreparedStatement stops = db.prepare(
+            "SELECT station, arrival_offset, departure_offset FROM train_stops WHERE train_number = ? ORDER BY stop_seq;");
+        stops.bind(1, info.columnText(5));
+        while (stops.step() == SQLITE_ROW) {
+            run.stations.push_back(stops.columnText(0));
+            run.scheduledArrival.push_back(start + stops.columnInt(1));
+            run.scheduledDeparture.push_back(start + stops.columnInt(2));
+        }
+        if (run.stations.empty()) {
+            long duration = TimeUtil::parseClock(info.columnText(2));
+            run.stations = {info.columnText(3), info.columnText(4)};
+            run.scheduledArrival = {start, start + duration};
+            run.scheduledDeparture = {start, start + duration};
+        }
+        run.delay.assign(run.stations.size(), 0);
+        run.observed.assign(run.stations.size(), 0);
+        return &runs.emplace(scheduleId, std::move(run)).first->second;
+    }
+};
+
+// ===================================================================
+//  RunningStatusFeed Class
+//  Reads running events line by line from a file, a FIFO or stdin
+//  (so a socket feed can be piped in, e.g. `nc host port | railway3
+//  --ingest-status -`). Line formats:
+//    DEPARTED|ARRIVED|DELAYED <train_no> <YYYY-MM-DD> <station> <delay_min>
+//    HOLD <feeder_train> <date> <station> <connecting_train> <date> <min_transfer>
+//  Station names containing spaces are written with '_' for ' '.
+// ===================================================================
+class RunningStatusFeed {
+public:
+    struct Stats {
+        int events = 0;
+        int rejected = 0;
+        int estimatesChanged = 0;
+    };
+
+    Stats ingest(std::istream& in) {
+        Stats stats;
+        auto& board = RunningStatusBoard::getInstance();
+        if (!board.isLoaded()) board.load();
+
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            int changed = applyLine(line);
+            if (changed < 0) {
+                std::cerr << "Rejected running event: " << line << std::endl;
+                stats.rejected++;
+            } else {
+                stats.events++;
+                stats.estimatesChanged += changed;
+            }
+            // Persist whenever the feed goes quiet so a live stream is never far behind
+            if (in.rdbuf()->in_avail() <= 0 || stats.events % 512 == 0) board.flush();
+        }
+        board.flush();
+        return stats;
+    }
+
+private:
+    std::unordered_map<std::string, int> scheduleIds; // "train|date" -> schedule_id
+
+    int scheduleIdFor(const std::string& trainNumber, const std::string& date) {
+        std::string key = trainNumber + "|" + date;
+        auto it = scheduleIds.find(key);
+        if (it != scheduleIds.end()) return it->second;
+        PreparedStatement stmt = DatabaseManager::getInstance().prepare(
+            "SELECT s.schedule_id FROM schedules s JOIN trains t ON s.train_id = t.train_id "
+            "WHERE t.train_number = ? AND s.departure_date = ?;");
+        stmt.bind(1, trainNumber);
+        stmt.bind(2, date);
+        int id = stmt.step() == SQLITE_ROW ? stmt.columnInt(0) : -1;
+        scheduleIds.emplace(key, id);
+        return id;
+    }
+
+    static std::string stationName(std::string token) {
+        std::replace(token.begin(), token.end(), '_', ' ');
+        return token;
+    }
+
+    int applyLine(const std::string& line) {
+        std::stringstream ss(line);
+        std::string kind, trainNumber, date, station;
+        ss >> kind >> trainNumber >> date >> station;
+        auto& board = RunningStatusBoard::getInstance();
+
+        if (kind == "HOLD") {
+            std::string connectingTrain, connectingDate;
+            int minTransfer = 0;
+            if (!(ss >> connectingTrain >> connectingDate >> minTransfer)) return -1;
+            int feeder = scheduleIdFor(trainNumber, date);
+            int connecting = scheduleIdFor(connectingTrain, connectingDate);
+            if (feeder < 0 || connecting < 0) return -1;
+            board.addConnection(feeder, stationName(station), connecting, minTransfer);
+            return 0;
+        }
+
+        int delay = 0;
+        if (!(ss >> delay)) return -1;
+        RunningStatusBoard::EventKind eventKind;
+        if (kind == "DEPARTED") eventKind = RunningStatusBoard::EventKind::Departed;
+        else if (kind == "ARRIVED") eventKind = RunningStatusBoard::EventKind::Arrived;
+        else if (kind == "DELAYED") eventKind = RunningStatusBoard::EventKind::Delayed;
+        else return -1;
+
+        int scheduleId = scheduleIdFor(trainNumber, date);
+        if (scheduleId < 0) return -1;
+        return board.applyEvent(scheduleId, stationName(station), eventKind, delay);
+    }
+};
+
+// ===================================================================
+//  JourneyPlanner Class
+//  Multi-criteria round-based search (McRAPTOR) over the scheduled
+//  departures around one date. Returns every journey that is not
+//  beaten on all of arrival time, fare and number of transfers.
+// ===================================================================
+class JourneyPlanner {
+public:
+    struct Leg {
+        int scheduleId;
+        std::string trainNumber, from, to;
+        int departure, arrival; // minutes after midnight of the query date
+        double fare;
+    };
+
+    struct Journey {
+        int arrival;
+        double fare;
+        int transfers;
+        std::vector<Leg> legs;
+    };
+
+    static const int MIN_TRANSFER_MINUTES = 10;
+    static const int MAX_ROUNDS = 4; // up to three transfers
+
+    // Loads departures from the day before to the day after 'date' into flat arrays
+    bool build(const std::string& date) {
+        METRICS_SCOPE("planner.build");
+        long day = 0;
+        if (!TimeUtil::parseDate(date, day)) return false;
+        *this = JourneyPlanner();
+        baseDate = date;
+        baseDay = day;
+
+        auto& db = DatabaseManager::getInstance();
+        auto stopRows = db.executeQuery("SELECT train_number, station, arrival_offset, departure_offset FROM train_stops ORDER BY train_number, stop_seq;");
+        std::unordered_map<std::string, std::vector<std::vector<std::string>>> stopsByTrain;
+        for (auto& row : stopRows) stopsByTrain[row[0]].push_back(row);
+
+        auto trips = db.executeQuery(
+            "SELECT s.schedule_id, t.train_number, s.departure_date, t.departure_time, t.journey_duration, t.source, t.destination, "
+            "MIN(t.ac_fare, t.sleeper_fare) FROM schedules s JOIN trains t ON s.train_id = t.train_id "
+            "WHERE s.departure_date BETWEEN '" + TimeUtil::formatDate(day - 1) + "' AND '" + TimeUtil::formatDate(day + 1) + "' "
+            "ORDER BY s.train_id, s.departure_date;");
+
+        // Every departure of a train shares its stop pattern, so a train is one route
+        std::string currentTrain;
+        for (const auto& trip : trips) {
+            if (trip[1] != currentTrain) {
+                currentTrain = trip[1];
+                Route route;
+                route.trainNumber = trip[1];
+                route.firstStop = static_cast<int>(routeStops.size());
+                route.firstTrip = static_cast<int>(tripSchedule.size());
+                route.firstStopTime = static_cast<int>(stopTimes.size());
+                auto stops = stopsByTrain.find(trip[1]);
+                std::vector<std::vector<std::string>> pattern;
+                if (stops != stopsByTrain.end()) {
+                    pattern = stops->second;
+                } else {
+                    std::string duration = std::to_string(TimeUtil::parseClock(trip[4]));
+                    pattern = {{trip[1], trip[5], "0", "0"}, {trip[1], trip[6], duration, duration}};
+                }
+                for (const auto& stop : pattern) {
+                    routeStops.push_back(stationId(stop[1]));
+                    routeOffsets.emplace_back(std::stoi(stop[2]), std::stoi(stop[3]));
+                }
+                route.numStops = static_cast<int>(pattern.size());
+                routes.push_back(route);
+            }
+            Route& route = routes.back();
+            long tripDay = 0;
+            TimeUtil::parseDate(trip[2], tripDay);
+            int start = static_cast<int>((tripDay - day) * 1440 + TimeUtil::parseClock(trip[3]));
+            for (int i = 0; i < route.numStops; ++i) {
+                const auto& offset = routeOffsets[route.firstStop + i];
+                stopTimes.emplace_back(start + offset.first, start + offset.second);
+            }
+            tripSchedule.push_back(std::stoi(trip[0]));
+            tripFare.push_back(std::stod(trip[7]));
+            route.numTrips++;
+        }
+
+        // Reverse index: routes serving each stop together with the stop's position in the route
+        std::vector<std::vector<std::pair<int, int>>> byStop(stationNames.size());
+        for (int r = 0; r < static_cast<int>(routes.size()); ++r) {
+            for (int i = 0; i < routes[r].numStops; ++i) byStop[routeStops[routes[r].firstStop + i]].emplace_back(r, i);
+        }
+        stopRouteStart.push_back(0);
+        for (const auto& list : byStop) {
+            stopRoutes.insert(stopRoutes.end(), list.begin(), list.end());
+            stopRouteStart.push_back(static_cast<int>(stopRoutes.size()));
+        }
+        return true;
+    }
+
+    const std::string& date() const { return baseDate; }
+
+    // Converts a planner time (minutes after midnight of the query date) to "YYYY-MM-DD HH:MM"
+    std::string formatTime(int minutes) const { return TimeUtil::formatDateTime(baseDay * 1440 + minutes); }
+
+    int stationCount() const { return static_cast<int>(stationNames.size()); }
+
+    // Pareto set over (arrival, fare, transfers) for journeys leaving 'origin' no earlier than 'earliest'
+    std::vector<Journey> search(const std::string& origin, const std::string& destination, int earliest) const {
+        return search(std::vector<std::string>{origin}, std::vector<std::string>{destination}, earliest);
+    }
+
+    // Same over several interchangeable origins and destinations (e.g. the stations of one city).
+    // Unknown station names are skipped, as are origins that are also destinations.
+    std::vector<Journey> search(const std::vector<std::string>& origins, const std::vector<std::string>& destinations, int earliest) const {
+        METRICS_SCOPE("planner.search");
+        std::vector<Journey> journeys;
+        const size_t numStops = stationNames.size();
+        std::vector<char> isTarget(numStops, 0);
+        std::vector<int> targets, sources;
+        for (const auto& name : destinations) {
+            auto to = stationIds.find(name);
+            if (to != stationIds.end() && !isTarget[to->second]) {
+                isTarget[to->second] = 1;
+                targets.push_back(to->second);
+            }
+        }
+        for (const auto& name : origins) {
+            auto from = stationIds.find(name);
+            if (from != stationIds.end() && !isTarget[from->second] &&
+                std::find(sources.begin(), sources.end(), from->second) == sources.end()) {
+                sources.push_back(from->second);
+            }
+        }
+        if (sources.empty() || targets.empty()) return journeys;
+
+        std::vector<LabelNode> pool;
+        std::vector<std::vector<Bag>> bags(MAX_ROUNDS + 1, std::vector<Bag>(numStops));
+        Bag targetBag; // best labels at any destination over all rounds, used for pruning
+        std::vector<uint64_t> marked((numStops + 63) / 64, 0), nextMarked(marked.size(), 0);
+        for (int source : sources) {
+            pool.push_back({earliest, 0.0, -1, -1, source, -1});
+            bags[0][source].push_back(static_cast<int>(pool.size()) - 1);
+            marked[source / 64] |= 1ULL << (source % 64);
+        }
+        std::vector<int> routeStartIndex(routes.size(), -1);
+        std::vector<int> queuedRoutes;
+
+        for (int k = 1; k <= MAX_ROUNDS; ++k) {
+            // Collect each route touched by a marked stop together with its earliest marked position
+            queuedRoutes.clear();
+            for (size_t w = 0; w < marked.size(); ++w) {
+                for (uint64_t bits = marked[w]; bits; bits &= bits - 1) {
+                    int stop = static_cast<int>(w * 64 + __builtin_ctzll(bits));
+                    for (int e = stopRouteStart[stop]; e < stopRouteStart[stop + 1]; ++e) {
+                        int r = stopRoutes[e].first, pos = stopRoutes[e].second;
+                        if (routeStartIndex[r] < 0) queuedRoutes.push_back(r);
+                        if (routeStartIndex[r] < 0 || pos < routeStartIndex[r]) routeStartIndex[r] = pos;
+                    }
+                }
+            }
+            std::fill(nextMarked.begin(), nextMarked.end(), 0);
+            auto& previous = bags[k - 1];
+            auto& current = bags[k];
+
+            for (int r : queuedRoutes) {
+                const Route& route = routes[r];
+                std::vector<RouteLabel> routeBag;
+                for (int i = routeStartIndex[r]; i < route.numStops; ++i) {
+                    int stop = routeStops[route.firstStop + i];
+                    // Alight: carry route labels to this stop
+                    for (const auto& rl : routeBag) {
+                        int arrival = timeAt(route, rl.trip, i).first;
+                        if (dominated(pool, targetBag, arrival, rl.fare)) continue;
+                        if (dominated(pool, current[stop], arrival, rl.fare)) continue;
+                        pool.push_back({arrival, rl.fare, rl.parent, route.firstTrip + rl.trip, stop, rl.boardIndex});
+                        int id = static_cast<int>(pool.size()) - 1;
+                        insert(pool, current[stop], id);
+                        if (isTarget[stop]) insert(pool, targetBag, id);
+                        nextMarked[stop / 64] |= 1ULL << (stop % 64);
+                    }
+                    // Board: labels from the previous round catch the earliest possible trip here
+                    if (i + 1 == route.numStops) break;
+                    for (int labelId : previous[stop]) {
+                        const LabelNode& label = pool[labelId];
+                        int ready = label.arrival + (k > 1 ? MIN_TRANSFER_MINUTES : 0);
+                        int trip = earliestTrip(route, i, ready);
+                        if (trip < 0) continue;
+                        RouteLabel candidate{trip, label.fare + tripFare[route.firstTrip + trip], labelId, i};
+                        bool beaten = false;
+                        for (const auto& rl : routeBag) {
+                            if (rl.trip <= candidate.trip && rl.fare <= candidate.fare) { beaten = true; break; }
+                        }
+                        if (beaten) continue;
+                        routeBag.erase(std::remove_if(routeBag.begin(), routeBag.end(), [&](const RouteLabel& rl) {
+                            return candidate.trip <= rl.trip && candidate.fare <= rl.fare;
+                        }), routeBag.end());
+                        routeBag.push_back(candidate);
+                    }
+                }
+                routeStartIndex[r] = -1;
+            }
+
+            // Journeys found in this round have k - 1 transfers
+            for (int target : targets) {
+                for (int id : current[target]) {
+                    if (std::find(targetBag.begin(), targetBag.end(), id) != targetBag.end()) journeys.push_back(reconstruct(pool, id, k - 1));
+                }
+            }
+            marked.swap(nextMarked);
+            if (std::all_of(marked.begin(), marked.end(), [](uint64_t w) { return w == 0; })) break;
+        }
+
+        // Drop journeys that a journey from a later round made obsolete
+        std::vector<Journey> pareto;
+        for (const auto& j : journeys) {
+            bool beaten = std::any_of(journeys.begin(), journeys.end(), [&](const Journey& o) {
+                return &o != &j && o.arrival <= j.arrival && o.fare <= j.fare && o.transfers <= j.transfers &&
+                       (o.arrival < j.arrival || o.fare < j.fare || o.transfers < j.transfers);
+            });
+            if (!beaten) pareto.push_back(j);
+        }
+        std::sort(pareto.begin(), pareto.end(), [](const Journey& a, const Journey& b) {
+            return a.arrival != b.arrival ? a.arrival < b.arrival : a.fare < b.fare;
+        });
+        return pareto;
+    }
+
+private:
+    struct Route {
+        std::string trainNumber;
+        int firstStop = 0, numStops = 0;
+        int firstTrip = 0, numTrips = 0;
+        int firstStopTime = 0; // stopTimes of trip t start at firstStopTime + t * numStops
+    };
+
+    // One label per (arrival, fare) reached; parent links rebuild the legs
+    struct LabelNode {
+        int arrival;
+        double fare;
+        int parent;     // label the leg was boarded from
+        int trip;       // global trip index of the leg, -1 for the origin label
+        int stop;
+        int boardIndex; // position in the route where the leg was boarded
+    };
+
+    struct RouteLabel {
+        int trip; // trip index within the route
+        double fare;
+        int parent;
+        int boardIndex;
+    };
+
+    using Bag = std::vector<int>;
+
+    std::string baseDate;
+    long baseDay = 0;
+    std::vector<Route> routes;
+    std::vector<int> routeStops;                       // station ids, routes[r].firstStop .. + numStops
+    std::vector<std::pair<int, int>> routeOffsets;     // (arrival, departure) offsets of each route stop
+    std::vector<std::pair<int, int>> stopTimes;        // (arrival, departure) per trip and stop, grouped by route
+    std::vector<int> tripSchedule;
+    std::vector<double> tripFare;
+    std::vector<std::pair<int, int>> stopRoutes;       // (route, position) grouped by station
+    std::vector<int> stopRouteStart;
+    std::vector<std::string> stationNames;
+    std::unordered_map<std::string, int> stationIds;
+
+    int stationId(const std::string& name) {
+        auto it = stationIds.find(name);
+        if (it != stationIds.end()) return it->second;
+        stationNames.push_back(name);
+        return stationIds[name] = static_cast<int>(stationNames.size()) - 1;
+    }
+
+    // (arrival, departure) of a route's trip (index within the route) at a position in the route
+    const std::pair<int, int>& timeAt(const Route& route, int trip, int position) const {
+        return stopTimes[route.firstStopTime + trip * route.numStops + position];
+    }
+
+    // Trips of a route are ordered by departure date, so departures at every stop are sorted
+    int earliestTrip(const Route& route, int position, int ready) const {
+        int lo = 0, hi = route.numTrips;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (timeAt(route, mid, position).second < ready) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo < route.numTrips ? lo : -1;
+    }
+
+    static bool dominated(const std::vector<LabelNode>& pool, const Bag& bag, int arrival, double fare) {
+        for (int id : bag) {
+            if (pool[id].arrival <= arrival && pool[id].fare <= fare) return true;
+        }
+        return false;
+    }
+
+    static void insert(const std::vector<LabelNode>& pool, Bag& bag, int id) {
+        const LabelNode& label = pool[id];
+        bag.erase(std::remove_if(bag.begin(), bag.end(), [&](int other) {
+            return label.arrival <= pool[other].arrival && label.fare <= pool[other].fare;
+        }), bag.end());
+        bag.push_back(id);
+    }
+
+    Journey reconstruct(const std::vector<LabelNode>& pool, int id, int transfers) const {
+        Journey journey{pool[id].arrival, pool[id].fare, transfers, {}};
+        for (int cur = id; pool[cur].trip >= 0; cur = pool[cur].parent) {
+            const LabelNode& label = pool[cur];
+            auto route = std::upper_bound(routes.begin(), routes.end(), label.trip, [](int trip, const Route& r) {
+                return trip < r.firstTrip;
+            }) - 1;
+            int boardStop = routeStops[route->firstStop + label.boardIndex];
+            int departure = timeAt(*route, label.trip - route->firstTrip, label.boardIndex).second;
+            journey.legs.push_back({tripSchedule[label.trip], route->trainNumber, stationNames[boardStop],
+                                    stationNames[label.stop], departure, label.arrival, tripFare[label.trip]});
+        }
+        std::reverse(journey.legs.begin(), journey.legs.end());
+        return journey;
+    }
+};
+
+// ===================================================================
+//  StationIndex Class (Singleton)
+//  Station coordinates in a uniform grid of CELL_DEGREES cells, so
+//  "stations within R km" and "k nearest stations" only look at the
+//  cells around the query point. Places can be station names or city
+//  names (the centre of the city's stations). Distances are great-
+//  circle kilometres; the grid does not wrap at the antimeridian.
+// ===================================================================
+class StationIndex {
+public:
+    struct Nearby {
+        std::string name, city;
+        double km;
+    };
+
+    static StationIndex& getInstance() {
+        static StationIndex instance;
+        return instance;
+    }
+
+    void invalidate() { loaded = false; }
+
+    void ensureLoaded() {
+        if (!loaded) load();
+    }
+
+    size_t size() const { return stations.size(); }
+
+    // Position of a station, or the centre of a city's stations; false if neither is known
+    bool locate(const std::string& place, double& latitude, double& longitude) {
+        ensureLoaded();
+        auto station = byName.find(place);
+        if (station != byName.end()) {
+            latitude = stations[station->second].latitude;
+            longitude = stations[station->second].longitude;
+            return true;
+        }
+        auto city = cities.find(place);
+        if (city == cities.end()) return false;
+        latitude = city->second.latitude;
+        longitude = city->second.longitude;
+        return true;
+    }
+
+    // Stations of a city, or an empty list for an unknown city
+    std::vector<std::string> cityStations(const std::string& city) {
+        ensureLoaded();
+        auto it = cities.find(city);
+        if (it == cities.end()) return {};
+        std::vector<std::string> names;
+        for (int i : it->second.stations) names.push_back(stations[i].name);
+        return names;
+    }
+
+    // Stations within 'km' of a point, nearest first
+    std::vector<Nearby> within(double latitude, double longitude, double km) {
+        METRICS_SCOPE("stations.within");
+        ensureLoaded();
+        std::vector<std::pair<double, int>> found;
+        const double dLat = km / KM_PER_DEGREE;
+        const double dLon = km / (KM_PER_DEGREE * std::max(0.01, std::cos(toRadians(std::min(89.0, std::fabs(latitude) + dLat)))));
+        const int rowFrom = std::max(minRow, cell(latitude - dLat)), rowTo = std::min(maxRow, cell(latitude + dLat));
+        const int colFrom = std::max(minCol, cell(longitude - dLon)), colTo = std::min(maxCol, cell(longitude + dLon));
+        for (int row = rowFrom; row <= rowTo; ++row) {
+            for (int col = colFrom; col <= colTo; ++col) {
+                auto bucket = cells.find(key(row, col));
+                if (bucket == cells.end()) continue;
+                for (int i : bucket->second) {
+                    double d = distanceKm(latitude, longitude, stations[i].latitude, stations[i].longitude);
+                    if (d <= km) found.emplace_back(d, i);
+                }
+            }
+        }
+        std::sort(found.begin(), found.end());
+        return describe(found, found.size());
+    }
+
+    // The k stations nearest to a point, nearest first. Rings of cells are
+    // searched outwards until no unvisited cell can hold anything closer.
+    std::vector<Nearby> nearest(double latitude, double longitude, size_t k) {
+        METRICS_SCOPE("stations.nearest");
+        ensureLoaded();
+        std::vector<std::pair<double, int>> found;
+        if (stations.empty() || k == 0) return {};
+        const int row0 = cell(latitude), col0 = cell(longitude);
+        const int maxRing = std::max({row0 - minRow, maxRow - row0, col0 - minCol, maxCol - col0});
+        for (int ring = 0; ring <= maxRing; ++ring) {
+            for (int row = row0 - ring; row <= row0 + ring; ++row) {
+                for (int col = col0 - ring; col <= col0 + ring; ++col) {
+                    if (std::abs(row - row0) != ring && std::abs(col - col0) != ring) continue; // inner rings are done
+                    auto bucket = cells.find(key(row, col));
+                    if (bucket == cells.end()) continue;
+                    for (int i : bucket->second) {
+                        found.emplace_back(distanceKm(latitude, longitude, stations[i].latitude, stations[i].longitude), i);
+                    }
+                }
+            }
+            if (found.size() >= k) {
+                std::nth_element(found.begin(), found.begin() + (k - 1), found.end());
+                // Anything outside this ring is at least 'ring' whole cells away in some direction
+                double widest = std::min(89.0, std::fabs(latitude) + (ring + 1) * CELL_DEGREES);
+                double reach = ring * CELL_DEGREES * KM_PER_DEGREE * std::cos(toRadians(widest));
+                if (found[k - 1].first <= reach) break;
+            }
+        }
+        std::sort(found.begin(), found.end());
+        return describe(found, std::min(k, found.size()));
+    }
+
+    // Upserts "name|city|latitude|longitude" lines in one transaction; '#' starts a comment line
+    bool import(std::istream& in, int& imported, std::string& error) {
+        auto& db = DatabaseManager::getInstance();
+        if (!db.beginTransaction()) {
+            error = "could not start transaction";
+            return false;
+        }
+        PreparedStatement upsert = db.prepare("INSERT OR REPLACE INTO stations (name, city, latitude, longitude) VALUES (?, ?, ?, ?);");
+        std::string line;
+        int lineNumber = 0;
+        imported = 0;
+        while (std::getline(in, line)) {
+            ++lineNumber;
+            if (line.empty() || line[0] == '#') continue;
+            std::vector<std::string> fields;
+            std::stringstream ss(line);
+            std::string field;
+            while (std::getline(ss, field, '|')) fields.push_back(field);
+            char* end = nullptr;
+            double latitude = fields.size() == 4 ? std::strtod(fields[2].c_str(), &end) : 0;
+            bool ok = fields.size() == 4 && !fields[0].empty() && !fields[1].empty() && *end == '\0' && std::fabs(latitude) <= 90;
+            double longitude = ok ? std::strtod(fields[3].c_str(), &end) : 0;
+            if (!ok || *end != '\0' || std::fabs(longitude) > 180) {
+                db.rollback();
+                error = "line " + std::to_string(lineNumber) + ": expected name|city|latitude|longitude";
+                return false;
+            }
+            upsert.bind(1, fields[0]);
+            upsert.bind(2, fields[1]);
+            upsert.bind(3, latitude);
+            upsert.bind(4, longitude);
+            if (!upsert.execute()) {
+                db.rollback();
+                error = "line " + std::to_string(lineNumber) + ": insert failed";
+                return false;
+            }
+            imported++;
+        }
+        if (!db.commit()) {
+            db.rollback();
+            error = "commit failed";
+            return false;
+        }
+        invalidate();
+        return true;
+    }
+
+    static double distanceKm(double lat1, double lon1, double lat2, double lon2) {
+        double dLat = toRadians(lat2 - lat1), dLon = toRadians(lon2 - lon1);
+        double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
+                   std::cos(toRadians(lat1)) * std::cos(toRadians(lat2)) * std::sin(dLon / 2) * std::sin(dLon / 2);
+        return 2 * EARTH_RADIUS_KM * std::asin(std::min(1.0, std::sqrt(a)));
+    }
+
+private:
+    static constexpr double CELL_DEGREES = 0.25; // about 28 km north to south
+    static constexpr double KM_PER_DEGREE = 111.195;
+    static constexpr double EARTH_RADIUS_KM = 6371.0;
+
+    struct City {
+        double latitude = 0, longitude = 0;
+        std::vector<int> stations;
+    };
+
+    bool loaded = false;
+    std::vector<Station> stations;
+    std::unordered_map<std::string, int> byName;
+    std::unordered_map<std::string, City> cities;
+    std::unordered_map<long long, std::vector<int>> cells;
+    int minRow = 0, maxRow = -1, minCol = 0, maxCol = -1;
+
+    StationIndex() = default;
+    StationIndex(const StationIndex&) = delete;
+    StationIndex& operator=(const StationIndex&) = delete;
+
+    static double toRadians(double degrees) { return degrees * 3.14159265358979323846 / 180.0; }
+    static int cell(double degrees) { return static_cast<int>(std::floor(degrees / CELL_DEGREES)); }
+    static long long key(int row, int col) { return (static_cast<long long>(row) << 32) ^ static_cast<uint32_t>(col); }
+
+    std::vector<Nearby> describe(const std::vector<std::pair<double, int>>& found, size_t count) const {
+        std::vector<Nearby> result;
+        for (size_t i = 0; i < count; ++i) {
+            const Station& station = stations[found[i].second];
+            result.push_back({station.name, station.city, found[i].first});
+        }
+        return result;
+    }
+
+    void load() {
+        METRICS_SCOPE("stations.load");
+        stations = DatabaseManager::getInstance().selectRows<Schema::Stations>();
+        byName.clear();
+        cities.clear();
+        cells.clear();
+        minRow = minCol = std::numeric_limits<int>::max();
+        maxRow = maxCol = std::numeric_limits<int>::min();
+        for (int i = 0; i < static_cast<int>(stations.size()); ++i) {
+            const Station& station = stations[i];
+            byName[station.name] = i;
+            City& city = cities[station.city];
+            city.stations.push_back(i);
+            city.latitude += station.latitude;
+            city.longitude += station.longitude;
+            int row = cell(station.latitude), col = cell(station.longitude);
+            cells[key(row, col)].push_back(i);
+            minRow = std::min(minRow, row);
+            maxRow = std::max(maxRow, row);
+            minCol = std::min(minCol, col);
+            maxCol = std::max(maxCol, col);
+        }
+        for (auto& city : cities) {
+            city.second.latitude /= city.second.stations.size();
+            city.second.longitude /= city.second.stations.size();
+        }
+        loaded = true;
+    }
+};
+
+// ===================================================================
+//  AvailabilityBoard Class (Singleton)
+//  Seat availability published in a POSIX shared-memory segment
+//  named by RAILWAY_BOARD, so other processes on the host can read it
+//  without touching the database. The publishing process (the first
+//  one to lock the segment) writes every departure from
+//  AvailabilityCache. Each entry has its own sequence lock: the
+//  writer makes the sequence odd, writes, then makes it even again.
+//  A reader retries until it sees the same even sequence before and
+//  after its read. After attaching, reading is plain loads: no locks
+//  and no system calls. The header's version grows with every write
+//  and each entry keeps the version of its own last write, so readers
+//  can find what changed. When the table must grow, the publisher
+//  retires the segment and creates a new one under the same name.
+//  Readers notice the retired flag and attach again. A publisher that
+//  takes over from one that died retires the segment left behind the
+//  same way and carries its version on.
+// ===================================================================
+class AvailabilityBoard {
+public:
+    struct Seats {
+        int scheduleId = 0;
+        long day = 0; // days since 1970-01-01
+        int acSeats = 0, sleeperSeats = 0;
+        bool present = false;          // false once the departure left the cache
+        unsigned long long version = 0; // board version of the last write
+    };
+
+    static AvailabilityBoard& getInstance() {
+        static AvailabilityBoard instance;
+        return instance;
+    }
+
+    // The publisher takes the segment with it, so readers never mistake stale counts for live ones
+    ~AvailabilityBoard() {
+#ifndef _WIN32
+        if (publisher && header) {
+            header->retired.store(1, std::memory_order_release);
+            shm_unlink(segmentName());
+        }
+#endif
+        detach();
+    }
+
+    bool publishing() const { return publisher; }
+
+    // Writes the full set of departures, creating the segment on first use. Departures missing from the set are marked gone.
+    void publishAll(const std::vector<Seats>& departures) {
+        if (!publisher && !becomePublisher(departures.size())) return;
+        size_t added = 0;
+        for (const auto& d : departures) added += find(d.scheduleId) ? 0 : 1;
+        if ((slotsUsed + added) * 2 > capacity && !createSegment(departures.size())) return;
+        std::unordered_set<int> current;
+        for (const auto& d : departures) {
+            current.insert(d.scheduleId);
+            write(d.scheduleId, d.day, d.acSeats, d.sleeperSeats, true);
+        }
+        for (unsigned i = 0; i < capacity; ++i) {
+            int id = entries[i].scheduleId.load(std::memory_order_relaxed);
+            if (id != 0 && !current.count(id) && entries[i].present.load(std::memory_order_relaxed)) write(id, 0, 0, 0, false);
+        }
+    }
+
+    void publish(int scheduleId, long day, int acSeats, int sleeperSeats) {
+        if (publisher) write(scheduleId, day, acSeats, sleeperSeats, true);
+    }
+
+    // Maps the segment read-only; false with 'error' set if it does not exist
+    bool attach(std::string& error) {
+        detach();
+        const char* name = segmentName();
+        if (!name) {
+            error = "RAILWAY_BOARD is not set";
+            return false;
+        }
+#ifndef _WIN32
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0) {
+            error = std::string("cannot open ") + name + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat st;
+        void* mapped = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header)) {
+            mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            error = std::string(name) + " is not an availability board";
+            return false;
+        }
+        map(mapped, static_cast<size_t>(st.st_size));
+        if (header->magic != MAGIC || mappedBytes < segmentBytes(header->capacity)) {
+            detach();
+            error = std::string(name) + " is not an availability board";
+            return false;
+        }
+        capacity = header->capacity;
+        return true;
+#else
+        error = "shared memory boards need a POSIX system";
+        return false;
+#endif
+    }
+
+    // Consistent copy of one departure's entry; false if the board has never held it
+    bool read(int scheduleId, Seats& seats) {
+        if (!refresh()) return false;
+        const Entry* entry = find(scheduleId);
+        if (!entry) return false;
+        load(*entry, seats);
+        return true;
+    }
+
+    unsigned long long version() {
+        return refresh() ? header->version.load(std::memory_order_acquire) : 0;
+    }
+
+    int publisherPid() { return refresh() ? header->publisherPid : 0; }
+
+    // False once the process that publishes the attached segment has gone without retiring it
+    bool publisherAlive() {
+        if (!refresh()) return false;
+#ifndef _WIN32
+        return kill(header->publisherPid, 0) == 0 || errno == EPERM;
+#else
+        return true;
+#endif
+    }
+
+    // Every entry written after board version 'since', in slot order
+    std::vector<Seats> changedSince(unsigned long long since) {
+        std::vector<Seats> changed;
+        if (!refresh()) return changed;
+        for (unsigned i = 0; i < capacity; ++i) {
+            if (entries[i].scheduleId.load(std::memory_order_relaxed) == 0) continue;
+            if (entries[i].version.load(std::memory_order_relaxed) <= since) continue;
+            Seats seats;
+            load(entries[i], seats);
+            if (seats.version > since) changed.push_back(seats);
+        }
+        return changed;
+    }
+
+    // Reads that had to start over because the publisher was writing the same entry
+    unsigned long long retries() const { return retryCount; }
+
+    static void printSeats(std::ostream& out, const std::vector<Seats>& rows) {
+        const int W_ID = 10, W_DATE = 12, W_SEATS = 9, W_VERSION = 10, W_STATE = 8;
+        const int width = W_ID + W_DATE + 2 * W_SEATS + W_VERSION + W_STATE + 3 * 6 + 1;
+        out << std::string(width, '-') << "\n";
+        out << "| " << std::left << std::setw(W_ID) << "Schedule" << " | " << std::setw(W_DATE) << "Date" << " | "
+            << std::setw(W_SEATS) << "AC" << " | " << std::setw(W_SEATS) << "Sleeper" << " | " << std::setw(W_VERSION) << "Version"
+            << " | " << std::setw(W_STATE) << "State" << " |\n";
+        out << std::string(width, '-') << "\n";
+        for (const auto& r : rows) {
+            out << "| " << std::left << std::setw(W_ID) << r.scheduleId << " | " << std::setw(W_DATE) << (r.present ? TimeUtil::formatDate(r.day) : "-")
+                << " | " << std::setw(W_SEATS) << r.acSeats << " | " << std::setw(W_SEATS) << r.sleeperSeats << " | "
+                << std::setw(W_VERSION) << r.version << " | " << std::setw(W_STATE) << (r.present ? "open" : "gone") << " |\n";
+        }
+        out << std::string(width, '-') << "\n";
+    }
+
+private:
+    static const unsigned long long MAGIC = 0x5241494c424f4152ULL; // "RAILBOAR"
+    static const unsigned MIN_CAPACITY = 1024;
+
+    struct Header {
+        unsigned long long magic;
+        unsigned capacity;
+        int publisherPid;
+        std::atomic<unsigned> retired;
+        std::atomic<unsigned long long> version;
+    };
+
+    // Fields are atomics so the racing reads a sequence lock allows are well defined; relaxed loads cost nothing extra
+    struct alignas(64) Entry {
+        std::atomic<unsigned> sequence;
+        std::atomic<int> scheduleId; // 0 = free slot; never changes once set
+        std::atomic<int> acSeats, sleeperSeats;
+        std::atomic<long> day;
+        std::atomic<int> present;
+        std::atomic<unsigned long long> version;
+    };
+
+    Header* header = nullptr;
+    Entry* entries = nullptr;
+    size_t mappedBytes = 0;
+    unsigned capacity = 0;
+    size_t slotsUsed = 0; // publisher only; slots of departures that have left stay taken
+    bool publisher = false;
+    bool publishFailed = false;
+    int lockFd = -1;
+    unsigned long long retryCount = 0;
+
+    static_assert(sizeof(Header) <= sizeof(Entry), "the header must fit in the first entry's cache line");
+
+    AvailabilityBoard() = default;
+
+    static const char* segmentName() {
+        const char* name = std::getenv("RAILWAY_BOARD");
+        return name && *name ? name : nullptr;
+    }
+
+    static size_t segmentBytes(unsigned slots) { return sizeof(Entry) + static_cast<size_t>(slots) * sizeof(Entry); }
+
+    void map(void* mapped, size_t bytes) {
+        header = static_cast<Header*>(mapped);
+        entries = reinterpret_cast<Entry*>(static_cast<char*>(mapped) + sizeof(Entry)); // header padded to one line
+        mappedBytes = bytes;
+    }
+
+    void detach() {
+#ifndef _WIN32
+        if (header) munmap(header, mappedBytes);
+        if (lockFd >= 0) ::close(lockFd);
+#endif
+        header = nullptr;
+        entries = nullptr;
+        mappedBytes = 0;
+        capacity = 0;
+        lockFd = -1;
+    }
+
+    // Readers move to the new segment once the publisher retires theirs
+    bool refresh() {
+        if (header && !header->retired.load(std::memory_order_acquire)) return true;
+        if (publisher) return header != nullptr;
+        std::string error;
+        return attach(error);
+    }
+
+    const Entry* find(int scheduleId) const {
+        for (unsigned i = slotOf(scheduleId), probes = 0; probes < capacity; i = (i + 1) & (capacity - 1), ++probes) {
+            int id = entries[i].scheduleId.load(std::memory_order_acquire);
+            if (id == scheduleId) return &entries[i];
+            if (id == 0) return nullptr;
+        }
+        return nullptr;
+    }
+
+    unsigned slotOf(int scheduleId) const {
+        return static_cast<unsigned>((static_cast<unsigned long long>(scheduleId) * 0x9E3779B97F4A7C15ULL) >> 32) & (capacity - 1);
+    }
+
+    void load(const Entry& entry, Seats& seats) {
+        for (int spins = 0;; ++spins) {
+            // A publisher preempted mid-write would otherwise keep this core spinning for its whole time slice
+            if (spins > 64) std::this_thread::yield();
+            unsigned before = entry.sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                retryCount++;
+                continue;
+            }
+            seats.scheduleId = entry.scheduleId.load(std::memory_order_relaxed);
+            seats.acSeats = entry.acSeats.load(std::memory_order_relaxed);
+            seats.sleeperSeats = entry.sleeperSeats.load(std::memory_order_relaxed);
+            seats.day = entry.day.load(std::memory_order_relaxed);
+            seats.present = entry.present.load(std::memory_order_relaxed) != 0;
+            seats.version = entry.version.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (entry.sequence.load(std::memory_order_relaxed) == before) return;
+            retryCount++;
+        }
+    }
+
+    // Only the publisher writes, from one thread at a time (AvailabilityCache is not shared between threads)
+    void write(int scheduleId, long day, int acSeats, int sleeperSeats, bool present) {
+        Entry* entry = const_cast<Entry*>(find(scheduleId));
+        if (entry && entry->present.load(std::memory_order_relaxed) == (present ? 1 : 0) &&
+            entry->acSeats.load(std::memory_order_relaxed) == acSeats && entry->sleeperSeats.load(std::memory_order_relaxed) == sleeperSeats &&
+            (!present || entry->day.load(std::memory_order_relaxed) == day)) {
+            return; // unchanged: readers watching the version are not woken
+        }
+        if (!entry) {
+            if (!present) return;
+            unsigned i = slotOf(scheduleId);
+            while (entries[i].scheduleId.load(std::memory_order_relaxed) != 0) i = (i + 1) & (capacity - 1);
+            entry = &entries[i];
+            slotsUsed++;
+        }
+        unsigned long long version = header->version.load(std::memory_order_relaxed) + 1;
+        unsigned sequence = entry->sequence.load(std::memory_order_relaxed);
+        entry->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        entry->acSeats.store(acSeats, std::memory_order_relaxed);
+        entry->sleeperSeats.store(sleeperSeats, std::memory_order_relaxed);
+        if (present) entry->day.store(day, std::memory_order_relaxed);
+        entry->present.store(present ? 1 : 0, std::memory_order_relaxed);
+        entry->version.store(version, std::memory_order_relaxed);
+        entry->sequence.store(sequence + 2, std::memory_order_release);
+        // Published last so a new slot is only found once its first write is complete
+        entry->scheduleId.store(scheduleId, std::memory_order_release);
+        header->version.store(version, std::memory_order_release);
+    }
+
+    // The first process to lock <name> publishes; the others only read
+    bool becomePublisher(size_t departures) {
+        const char* name = segmentName();
+        if (!name || publishFailed) return false;
+#ifndef _WIN32
+        int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+        if (fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) == 0) {
+            lockFd = fd; // held for the life of the process, and handed over to each new segment
+            adoptAbandoned(fd);
+            if (createSegment(departures)) return true;
+        } else {
+            std::cerr << "Availability board " << name << (fd < 0 ? std::string(": ") + std::strerror(errno) : std::string(" already has a publisher"))
+                      << "; not publishing." << std::endl;
+            if (fd >= 0) ::close(fd);
+        }
+#endif
+        publishFailed = true;
+        return false;
+    }
+
+#ifndef _WIN32
+    // Maps the segment a crashed publisher left under the name, so that createSegment()
+    // retires it for the readers still attached and continues its version
+    void adoptAbandoned(int fd) {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < segmentBytes(0)) return; // created just now
+        void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) return;
+        map(mapped, static_cast<size_t>(st.st_size));
+        if (header->magic == MAGIC) return;
+        munmap(mapped, mappedBytes);
+        header = nullptr;
+        entries = nullptr;
+        mappedBytes = 0;
+    }
+#endif
+
+    // Replaces the segment with an empty one twice the size of 'departures'; the old one is retired
+    bool createSegment(size_t departures) {
+#ifndef _WIN32
+        const char* name = segmentName();
+        unsigned slots = MIN_CAPACITY;
+        while (slots < departures * 2) slots <<= 1;
+        shm_unlink(name);
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0 || flock(fd, LOCK_EX | LOCK_NB) != 0 || ftruncate(fd, static_cast<off_t>(segmentBytes(slots))) != 0) {
+            std::cerr << "Cannot create availability board " << name << ": " << std::strerror(errno) << std::endl;
+            if (fd >= 0) ::close(fd);
+            if (header) header->retired.store(1, std::memory_order_release); // unlinked: readers must not stay on it
+            return false;
+        }
+        void* mapped = mmap(nullptr, segmentBytes(slots), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            if (header) header->retired.store(1, std::memory_order_release);
+            return false;
+        }
+        unsigned long long version = header ? header->version.load(std::memory_order_relaxed) : 0;
+        Header* old = header;
+        size_t oldBytes = mappedBytes;
+        int oldFd = lockFd;
+        map(mapped, segmentBytes(slots)); // ftruncate zeroed it: every slot is free
+        header->capacity = capacity = slots;
+        slotsUsed = 0;
+        header->publisherPid = static_cast<int>(getpid());
+        header->version.store(version, std::memory_order_relaxed);
+        header->magic = MAGIC;
+        lockFd = fd;
+        publisher = true;
+        if (old) {
+            old->retired.store(1, std::memory_order_release);
+            munmap(old, oldBytes);
+        }
+        if (oldFd >= 0) ::close(oldFd);
+        return true;
+#else
+        (void)departures;
+        return false;
+#endif
+    }
+};
+
+// ===================================================================
+//  AvailabilityCache Class (Singleton)
+//  In-memory copy of seat availability for current and future
+//  departures, indexed by schedule, by train and by route. Kept in
+//  step with bookings and cancellations made by this process and
+//  reloaded after timetable changes.
+// ===================================================================
+class AvailabilityCache {
+public:
+    struct TrainInfo {
+        std::string number, name, source, destination;
+        double acFare, sleeperFare;
+    };
+
+    struct Departure {
+        int scheduleId;
+        int train;   // index into trains()
+        long day;    // days since 1970-01-01
+        int acSeats, sleeperSeats;
+
+        int seats(bool ac) const { return ac ? acSeats : sleeperSeats; }
+    };
+
+    static AvailabilityCache& getInstance() {
+        static AvailabilityCache instance;
+        return instance;
+    }
+
+    void load() {
+        METRICS_SCOPE("availability.load");
+        departures.clear();
+        trainList.clear();
+        bySchedule.clear();
+        byTrain.clear();
+        byRoute.clear();
+
+        auto rows = DatabaseManager::getInstance().executeQuery(
+            "SELECT s.schedule_id, t.train_number, s.departure_date, s.ac_seats_available, s.sleeper_seats_available, "
+            "t.train_name, t.source, t.destination, t.ac_fare, t.sleeper_fare FROM schedules s "
+            "JOIN trains t ON s.train_id = t.train_id WHERE s.departure_date >= date('now') "
+            "ORDER BY s.train_id, s.departure_date;");
+        departures.reserve(rows.size());
+        for (const auto& row : rows) {
+            if (trainList.empty() || trainList.back().number != row[1]) {
+                trainList.push_back({row[1], row[5], row[6], row[7], std::stod(row[8]), std::stod(row[9])});
+                byTrain.emplace_back();
+                byRoute[trainList.back().source + "|" + trainList.back().destination].push_back(static_cast<int>(trainList.size()) - 1);
+            }
+            long day = 0;
+            TimeUtil::parseDate(row[2], day);
+            int index = static_cast<int>(departures.size());
+            departures.push_back({std::stoi(row[0]), static_cast<int>(trainList.size()) - 1, day, std::stoi(row[3]), std::stoi(row[4])});
+            bySchedule[departures.back().scheduleId] = index;
+            byTrain.back().push_back(index); // already in date order
+        }
+        loaded = true;
+        publishBoard();
+    }
+
+    void ensureLoaded() { if (!loaded) load(); }
+
+    // Timetable changed behind the cache's back; reload on next use, or now if other processes read the board
+    void invalidate() {
+        loaded = false;
+        if (AvailabilityBoard::getInstance().publishing()) load();
+    }
+
+    // Applies a committed booking (negative delta) or cancellation (positive delta)
+    void adjust(int scheduleId, bool ac, int delta) {
+        auto it = bySchedule.find(scheduleId);
+        if (it == bySchedule.end()) return;
+        Departure& d = departures[it->second];
+        (ac ? d.acSeats : d.sleeperSeats) += delta;
+        AvailabilityBoard::getInstance().publish(d.scheduleId, d.day, d.acSeats, d.sleeperSeats);
+    }
+
+    const Departure* find(int scheduleId) const {
+        auto it = bySchedule.find(scheduleId);
+        return it == bySchedule.end() ? nullptr : &departures[it->second];
+    }
+
+    const std::vector<TrainInfo>& trains() const { return trainList; }
+    const std::vector<Departure>& allDepartures() const { return departures; }
+
+    // Departure indexes of one train, in date order
+    const std::vector<int>& departuresOfTrain(int train) const { return byTrain[train]; }
+
+    const std::vector<int>* trainsOnRoute(const std::string& source, const std::string& destination) const {
+        auto it = byRoute.find(source + "|" + destination);
+        return it == byRoute.end() ? nullptr : &it->second;
+    }
+
+private:
+    std::vector<Departure> departures;
+    std::vector<TrainInfo> trainList;
+    std::unordered_map<int, int> bySchedule;
+    std::vector<std::vector<int>> byTrain;
+    std::unordered_map<std::string, std::vector<int>> byRoute;
+    bool loaded = false;
+
+    AvailabilityCache() = default;
+
+    void publishBoard() {
+        if (!std::getenv("RAILWAY_BOARD")) return;
+        std::vector<AvailabilityBoard::Seats> seats(departures.size());
+        for (size_t i = 0; i < departures.size(); ++i) {
+            seats[i].scheduleId = departures[i].scheduleId;
+            seats[i].day = departures[i].day;
+            seats[i].acSeats = departures[i].acSeats;
+            seats[i].sleeperSeats = departures[i].sleeperSeats;
+        }
+        AvailabilityBoard::getInstance().publishAll(seats);
+    }
+};
+
+// ===================================================================
+//  AlternativesEngine Class
+//  Suggests bookable alternatives when a request cannot be met:
+//  the other class of the same departure, the same train on nearby
+//  dates and other trains on the same route around the same date.
+// ===================================================================
+class AlternativesEngine {
+public:
+    struct Suggestion {
+        int scheduleId;
+        std::string trainNumber, trainName, date, seatClass;
+        int seatsAvailable;
+        double farePerSeat;
+        std::string reason;
+    };
+
+    static const int DATE_WINDOW_DAYS = 7;
+    static const size_t MAX_SUGGESTIONS = 8;
+
+    std::vector<Suggestion> suggest(int scheduleId, bool ac, int seats) const {
+        METRICS_SCOPE("alternatives.suggest");
+        std::vector<Suggestion> out;
+        auto& cache = AvailabilityCache::getInstance();
+        const auto* wanted = cache.find(scheduleId);
+        if (!wanted) return out;
+        const auto& train = cache.trains()[wanted->train];
+
+        if (wanted->seats(!ac) >= seats) out.push_back(make(*wanted, !ac, "other class"));
+
+        // Same train, nearest dates first
+        std::vector<std::pair<long, const AvailabilityCache::Departure*>> nearby;
+        for (int index : cache.departuresOfTrain(wanted->train)) {
+            const auto& d = cache.allDepartures()[index];
+            long distance = std::labs(d.day - wanted->day);
+            if (d.scheduleId != scheduleId && distance <= DATE_WINDOW_DAYS && d.seats(ac) >= seats) nearby.emplace_back(distance, &d);
+        }
+        std::sort(nearby.begin(), nearby.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (size_t i = 0; i < nearby.size() && i < 3; ++i) out.push_back(make(*nearby[i].second, ac, "nearby date"));
+
+        // Other trains on the same route, nearest dates first
+        nearby.clear();
+        if (const auto* trains = cache.trainsOnRoute(train.source, train.destination)) {
+            for (int other : *trains) {
+                if (other == wanted->train) continue;
+                for (int index : cache.departuresOfTrain(other)) {
+                    const auto& d = cache.allDepartures()[index];
+                    long distance = std::labs(d.day - wanted->day);
+                    if (distance <= DATE_WINDOW_DAYS && d.seats(ac) >= seats) nearby.emplace_back(distance, &d);
+                }
+            }
+        }
+        std::sort(nearby.begin(), nearby.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (size_t i = 0; i < nearby.size() && out.size() < MAX_SUGGESTIONS; ++i) out.push_back(make(*nearby[i].second, ac, "same route"));
+
+        if (out.size() > MAX_SUGGESTIONS) out.resize(MAX_SUGGESTIONS);
+        return out;
+    }
+
+    static void print(const std::vector<Suggestion>& suggestions) {
+        if (suggestions.empty()) {
+            std::cout << "No alternatives with enough seats were found.\n";
+            return;
+        }
+        std::cout << "\n--- Available Alternatives ---\n";
+        const int W_ID = 5, W_NUM = 10, W_NAME = 25, W_DATE = 12, W_CLASS = 8, W_SEATS = 6, W_FARE = 10, W_WHY = 12;
+        std::cout << std::string(W_ID + W_NUM + W_NAME + W_DATE + W_CLASS + W_SEATS + W_FARE + W_WHY + 25, '-') << std::endl;
+        std::cout << "| " << std::left << std::setw(W_ID) << "ID" << "| " << std::setw(W_NUM) << "Train No."
+                  << "| " << std::setw(W_NAME) << "Train Name" << "| " << std::setw(W_DATE) << "Date"
+                  << "| " << std::setw(W_CLASS) << "Class" << "| " << std::setw(W_SEATS) << "Seats"
+                  << "| " << std::setw(W_FARE) << "Fare" << "| " << std::setw(W_WHY) << "Why" << " |" << std::endl;
+        std::cout << std::string(W_ID + W_NUM + W_NAME + W_DATE + W_CLASS + W_SEATS + W_FARE + W_WHY + 25, '-') << std::endl;
+        for (const auto& s : suggestions) {
+            std::cout << "| " << std::left << std::setw(W_ID) << s.scheduleId << "| " << std::setw(W_NUM) << s.trainNumber
+                      << "| " << std::setw(W_NAME) << s.trainName.substr(0, W_NAME) << "| " << std::setw(W_DATE) << s.date
+                      << "| " << std::setw(W_CLASS) << s.seatClass << "| " << std::setw(W_SEATS) << s.seatsAvailable
+                      << "| " << std::setw(W_FARE) << std::fixed << std::setprecision(2) << s.farePerSeat
+                      << "| " << std::setw(W_WHY) << s.reason << " |" << std::endl;
+        }
+        std::cout << std::string(W_ID + W_NUM + W_NAME + W_DATE + W_CLASS + W_SEATS + W_FARE + W_WHY + 25, '-') << std::endl;
+    }
+
+private:
+    static Suggestion make(const AvailabilityCache::Departure& d, bool ac, const std::string& reason) {
+        const auto& train = AvailabilityCache::getInstance().trains()[d.train];
+        return {d.scheduleId, train.number, train.name, TimeUtil::formatDate(d.day), ac ? "AC" : "Sleeper",
+                d.seats(ac), ac ? train.acFare : train.sleeperFare, reason};
+    }
+};
+
+// ===================================================================
+//  ConcessionEngine Class (Singleton)
+//  Turns the active concession rules into a flat decision table with
+//  one cell per (promo code, passenger category, class). A cell holds
+//  the best percentage and the best flat discount among the rules
+//  that apply to it, so pricing a passenger is an array lookup and a
+//  comparison. Tables are compiled on a background thread when rules
+//  change or the date moves on; quotes keep using the previous table
+//  until the new one is published, and a compile that cannot read the
+//  rules is retried rather than published. Discounts never stack:
+//  each passenger gets the single largest reduction.
+// ===================================================================
+class ConcessionEngine {
+public:
+    enum class Category { Adult, Child, Student, Senior };
+    static constexpr int CATEGORY_COUNT = 4;
+    static constexpr const char* CATEGORY_NAMES[CATEGORY_COUNT] = {"Adult", "Child", "Student", "Senior"};
+
+    struct Quote {
+        double fare = 0.0;
+        double discount = 0.0;
+        std::string rule; // name of the applied rule, empty for full fare
+    };
+
+    class Table {
+    public:
+        long version = 0;
+        long compiledForDay = 0;
+        size_t activeRules = 0;
+
+        // Slot of a promo code for quote(); unknown or empty codes get slot 0 (no code)
+        int promoSlot(const std::string& code) const {
+            auto it = promoSlots.find(code);
+            return it == promoSlots.end() ? 0 : it->second;
+        }
+
+        bool knownPromo(const std::string& code) const { return promoSlots.count(code) > 0; }
+
+        Quote quote(Category category, bool ac, int promo, double baseFare) const {
+            const Cell& cell = cells[(promo * CATEGORY_COUNT + static_cast<int>(category)) * 2 + (ac ? 0 : 1)];
+            double byPercent = baseFare * cell.percent / 100.0;
+            Quote q;
+            q.discount = std::min(baseFare, std::max(byPercent, cell.flat));
+            q.fare = baseFare - q.discount;
+            if (q.discount > 0) q.rule = ruleNames[byPercent >= cell.flat ? cell.percentRule : cell.flatRule];
+            return q;
+        }
+
+    private:
+        friend class ConcessionEngine;
+        struct Cell {
+            double percent = 0.0, flat = 0.0;
+            int percentRule = 0, flatRule = 0; // indexes into ruleNames
+        };
+        std::unordered_map<std::string, int> promoSlots;
+        std::vector<Cell> cells;
+        std::vector<std::string> ruleNames{""};
+    };
+
+    static ConcessionEngine& getInstance() {
+        static ConcessionEngine instance;
+        return instance;
+    }
+
+    static bool parseCategory(const std::string& name, Category& category) {
+        for (int i = 0; i < CATEGORY_COUNT; ++i) {
+            if (name == CATEGORY_NAMES[i]) {
+                category = static_cast<Category>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The table to price with. Compiles synchronously only if there is none yet; if that
+    // fails, quotes are at full fare until the background compiler gets the rules.
+    std::shared_ptr<const Table> current() {
+        std::shared_ptr<const Table> table;
+        {
+            InstrumentedMutex::Guard guard(mutex);
+            table = published;
+        }
+        if (!table) {
+            if (generation.load() == 0) {
+                const long today = TimeUtil::today();
+                auto compiled = compile(today);
+                if (compiled) {
+                    publish(compiled, 0);
+                    return compiled;
+                }
+                invalidate();
+            }
+            return std::make_shared<Table>(build({}, 0));
+        }
+        // Rules with date limits may have started or ended; refresh once per new day
+        const long today = TimeUtil::today();
+        if (table->compiledForDay != today && refreshingDay.exchange(today) != today) invalidate();
+        return table;
+    }
+
+    // Rules changed: the compiler thread builds a new table. Never waits, so quotes may call it.
+    void invalidate() {
+        {
+            InstrumentedMutex::Guard guard(mutex);
+            ++generation;
+            if (!compiler.joinable()) compiler = std::thread([this] { compileLoop(); });
+        }
+        wake.notify_one();
+    }
+
+    // Why the latest compile could not read the rules, or empty once one has succeeded
+    std::string compileFailure() {
+        InstrumentedMutex::Guard guard(mutex);
+        return failure;
+    }
+
+private:
+    static constexpr std::chrono::seconds RETRY_DELAY{1};
+
+    ConcessionEngine() = default;
+    ~ConcessionEngine() {
+        {
+            InstrumentedMutex::Guard guard(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (compiler.joinable()) compiler.join();
+    }
+    ConcessionEngine(const ConcessionEngine&) = delete;
+    ConcessionEngine& operator=(const ConcessionEngine&) = delete;
+
+    // Compiles the latest generation; a failed compile is retried after RETRY_DELAY or as
+    // soon as the rules change again, and the published table stays in use meanwhile
+    void compileLoop() {
+        long done = 0;
+        for (;;) {
+            long wanted = 0;
+            {
+                InstrumentedMutex::Guard guard(mutex);
+                wake.wait(mutex, [&] { return stopping || generation.load() != done; });
+                if (stopping) return;
+                wanted = generation.load();
+            }
+            auto table = compile(TimeUtil::today());
+            if (table) {
+                publish(table, wanted);
+                done = wanted;
+                continue;
+            }
+            InstrumentedMutex::Guard guard(mutex);
+            wake.wait_for(mutex, RETRY_DELAY, [&] { return stopping || generation.load() != wanted; });
+        }
+    }
+
+    // Null if the rules could not be read; the reason is kept for compileFailure()
+    std::shared_ptr<Table> compile(long day) {
+        METRICS_SCOPE("concessions.compile");
+        const std::string today = TimeUtil::formatDate(day);
+
+        // Read on a pooled connection: compiling runs off the menu thread
+        std::vector<ConcessionRule> rules;
+        auto lease = ConnectionPool::getInstance().acquire(WorkloadClass::UserRead);
+        int rc = SQLITE_ERROR;
+        if (lease.valid()) {
+            PreparedStatement stmt(lease.connection(), Schema::selectSql<Schema::ConcessionRules>() +
+                " WHERE active = 1 AND (valid_from = '' OR valid_from <= ?) AND (valid_to = '' OR valid_to >= ?);");
+            stmt.bind(1, today);
+            stmt.bind(2, today);
+            while ((rc = stmt.step()) == SQLITE_ROW) rules.push_back(Schema::readRow<Schema::ConcessionRules>(stmt));
+        }
+        if (rc != SQLITE_DONE) {
+            std::string reason = lease.interruption();
+            if (reason.empty()) reason = sqlite3_errmsg(lease.connection());
+            InstrumentedMutex::Guard guard(mutex);
+            failure = reason;
+            return nullptr;
+        }
+        return std::make_shared<Table>(build(rules, day));
+    }
+
+    static Table build(const std::vector<ConcessionRule>& rules, long day) {
+        Table table;
+        table.compiledForDay = day;
+        table.promoSlots[""] = 0;
+        for (const auto& rule : rules) {
+            if (!rule.promoCode.empty()) table.promoSlots.emplace(rule.promoCode, static_cast<int>(table.promoSlots.size()));
+        }
+        table.cells.resize(table.promoSlots.size() * CATEGORY_COUNT * 2);
+
+        for (const auto& rule : rules) {
+            Category category = Category::Adult;
+            const bool anyCategory = rule.category == "*";
+            if (!anyCategory && !parseCategory(rule.category, category)) continue;
+            const int ruleIndex = static_cast<int>(table.ruleNames.size());
+            table.ruleNames.push_back(rule.name);
+            table.activeRules++;
+
+            // Rules without a promo code apply to every slot, rules with one only to its own
+            for (const auto& slot : table.promoSlots) {
+                if (!rule.promoCode.empty() && slot.first != rule.promoCode) continue;
+                for (int c = 0; c < CATEGORY_COUNT; ++c) {
+                    if (!anyCategory && c != static_cast<int>(category)) continue;
+                    for (int k = 0; k < 2; ++k) {
+                        if (rule.seatClass != "*" && rule.seatClass != (k == 0 ? "AC" : "Sleeper")) continue;
+                        Table::Cell& cell = table.cells[(slot.second * CATEGORY_COUNT + c) * 2 + k];
+                        if (rule.percentOff > cell.percent) {
+                            cell.percent = rule.percentOff;
+                            cell.percentRule = ruleIndex;
+                        }
+                        if (rule.flatOff > cell.flat) {
+                            cell.flat = rule.flatOff;
+                            cell.flatRule = ruleIndex;
+                        }
+                    }
+                }
+            }
+        }
+        return table;
+    }
+
+    // Publishes unless a newer invalidation has started its own compile
+    void publish(const std::shared_ptr<Table>& table, long compiledGeneration) {
+        InstrumentedMutex::Guard guard(mutex);
+        failure.clear();
+        if (compiledGeneration < generation.load() && published) return;
+        table->version = ++publishedVersion;
+        published = table;
+    }
+
+    InstrumentedMutex mutex{"concessions.table"};
+    std::condition_variable_any wake;
+    std::shared_ptr<const Table> published;
+    std::atomic<long> generation{0};
+    std::atomic<long> refreshingDay{0};
+    long publishedVersion = 0;
+    std::string failure;
+    bool stopping = false;
+    std::thread compiler; // started by the first invalidate(), runs until exit
+};
+
+// ===================================================================
+//  TimetableCatalog Class (Singleton)
+//  Immutable snapshots of the timetable (trains and their stops).
+//  Readers take a shared_ptr to the current snapshot and keep using
+//  it for as long as they need; a reload builds a new snapshot and
+//  swaps the pointer, so nobody ever sees a half-applied timetable.
+// ===================================================================
+class TimetableCatalog {
+public:
+    struct Stop {
+        int seq;
+        std::string station;
+        int arrivalOffset, departureOffset;
+
+        bool operator==(const Stop& other) const {
+            return seq == other.seq && station == other.station && arrivalOffset == other.arrivalOffset &&
+                   departureOffset == other.departureOffset;
+        }
+    };
+
+    struct Snapshot {
+        unsigned long version = 0;
+        std::vector<Train> trains;                       // ordered by train number
+        std::unordered_map<std::string, int> byNumber;   // train number -> index into trains
+        std::unordered_map<std::string, std::vector<Stop>> stops;
+
+        const Train* find(const std::string& number) const {
+            auto it = byNumber.find(number);
+            return it == byNumber.end() ? nullptr : &trains[it->second];
+        }
+    };
+
+    static TimetableCatalog& getInstance() {
+        static TimetableCatalog instance;
+        return instance;
+    }
+
+    // Current snapshot, loaded from the database on first use
+    std::shared_ptr<const Snapshot> current() {
+        {
+            InstrumentedMutex::Guard guard(mutex);
+            if (snapshot) return snapshot;
+        }
+        publish(loadFromDatabase());
+        InstrumentedMutex::Guard guard(mutex);
+        return snapshot;
+    }
+
+    // Reads trains and stops as committed in the database (or as seen by the open transaction)
+    std::shared_ptr<Snapshot> loadFromDatabase() {
+        auto& db = DatabaseManager::getInstance();
+        auto next = std::make_shared<Snapshot>();
+        next->trains = db.selectRows<Schema::Trains>("ORDER BY train_number");
+        for (size_t i = 0; i < next->trains.size(); ++i) next->byNumber[next->trains[i].number] = static_cast<int>(i);
+        PreparedStatement stops = db.prepare(
+            "SELECT train_number, stop_seq, station, arrival_offset, departure_offset FROM train_stops ORDER BY train_number, stop_seq;");
+        while (stops.step() == SQLITE_ROW) {
+            next->stops[stops.columnText(0)].push_back({stops.columnInt(1), stops.columnText(2), stops.columnInt(3), stops.columnInt(4)});
+        }
+        return next;
+    }
+
+    // Timetable edited outside a reload; the next current() loads a new snapshot
+    void invalidate() {
+        InstrumentedMutex::Guard guard(mutex);
+        snapshot.reset();
+    }
+
+    // Swaps in a new snapshot; holders of the old one keep it until they let go
+    void publish(std::shared_ptr<Snapshot> next) {
+        InstrumentedMutex::Guard guard(mutex);
+        next->version = ++versions;
+        snapshot = std::move(next);
+    }
+
+    static bool sameTrain(const Train& a, const Train& b) {
+        return a.name == b.name && a.source == b.source && a.destination == b.destination && a.departureTime == b.departureTime &&
+               a.journeyDuration == b.journeyDuration && a.totalAcSeats == b.totalAcSeats &&
+               a.totalSleeperSeats == b.totalSleeperSeats && a.acFare == b.acFare && a.sleeperFare == b.sleeperFare;
+    }
+
+private:
+    TimetableCatalog() {}
+    TimetableCatalog(const TimetableCatalog&) = delete;
+    TimetableCatalog& operator=(const TimetableCatalog&) = delete;
+
+    InstrumentedMutex mutex{"catalog.snapshot"};
+    std::shared_ptr<const Snapshot> snapshot;
+    unsigned long versions = 0;
+};
+
+// ===================================================================
+//  TimetableReload Class
+//  Applies a timetable delta file without stopping the system. The
+//  file is diffed against the catalog, the diff is written in one
+//  transaction and the new catalog is published afterwards. Lines:
+//    TRAIN|<number>|<name>|<source>|<destination>|<HH:MM>|<HH:MM duration>|
+//          <ac seats>|<sleeper seats>|<ac fare>|<sleeper fare>
+//    STOP|<number>|<seq>|<station>|<arrival offset>|<departure offset>
+//    REMOVE|<number>
+//  A train's STOP lines replace its whole stop list. Blank lines and
+//  lines starting with '#' are ignored.
+// ===================================================================
+class TimetableReload {
+public:
+    struct Result {
+        bool ok = false;
+        std::string error;
+        int added = 0, changed = 0, removed = 0, unchanged = 0, stopListsReplaced = 0;
+    };
+
+    // Deletes a train with its stops, rake and departures, inside the caller's transaction. Refused while any of its
+    // departures has bookings: those passengers still need the train, and a removed train's departures would be orphans.
+    static bool removeTrain(int trainId, const std::string& trainNumber, std::string& error) {
+        auto& db = DatabaseManager::getInstance();
+        PreparedStatement booked = db.prepare(
+            "SELECT COUNT(*) FROM bookings b JOIN schedules s ON b.schedule_id = s.schedule_id WHERE s.train_id = ?;");
+        if (!booked.valid()) {
+            error = "could not check the bookings of " + trainNumber;
+            return false;
+        }
+        booked.bind(1, trainId);
+        int bookings = booked.step() == SQLITE_ROW ? booked.columnInt(0) : -1;
+        if (bookings != 0) {
+            error = bookings < 0 ? "could not check the bookings of " + trainNumber
+                                 : "train " + trainNumber + " has " + std::to_string(bookings) + " booking(s); cancel them first";
+            return false;
+        }
+        const char* byDeparture[] = {"DELETE FROM schedule_coaches WHERE schedule_id IN (SELECT schedule_id FROM schedules WHERE train_id = ?);",
+                                     "DELETE FROM running_status WHERE schedule_id IN (SELECT schedule_id FROM schedules WHERE train_id = ?);",
+                                     "DELETE FROM connections WHERE feeder_schedule_id IN (SELECT schedule_id FROM schedules WHERE train_id = ?) "
+                                     "OR connecting_schedule_id IN (SELECT schedule_id FROM schedules WHERE train_id = ?);",
+                                     "DELETE FROM schedules WHERE train_id = ?;",
+                                     "DELETE FROM trains WHERE train_id = ?;"};
+        const char* byNumber[] = {"DELETE FROM train_stops WHERE train_number = ?;", "DELETE FROM train_coaches WHERE train_number = ?;"};
+        bool ok = true;
+        for (const char* sql : byDeparture) {
+            PreparedStatement stmt = db.prepare(sql);
+            if (!(ok = stmt.valid())) break;
+            stmt.bind(1, trainId);
+            if (std::strstr(sql, "connecting_schedule_id")) stmt.bind(2, trainId);
+            if (!(ok = stmt.execute())) break;
+        }
+        for (const char* sql : byNumber) {
+            if (!ok) break;
+            PreparedStatement stmt = db.prepare(sql);
+            if (!(ok = stmt.valid())) break;
+            stmt.bind(1, trainNumber);
+            if (!(ok = stmt.execute())) break;
+        }
+        if (!ok) error = "could not remove train " + trainNumber;
+        return ok;
+    }
+
+    Result run(std::istream& in) {
+        Result result;
+        Delta delta;
+        if (!parse(in, delta, result.error)) return result;
+
+        auto& db = DatabaseManager::getInstance();
+        if (!db.beginTransaction()) {
+            result.error = "could not start transaction";
+            return result;
+        }
+        // Diff against the catalog as committed now that the write lock is held
+        auto before = TimetableCatalog::getInstance().loadFromDatabase();
+        if (!apply(*before, delta, result)) {
+            db.rollback();
+            return result;
+        }
+        if (!db.commit()) {
+            result.error = "commit failed";
+            return result;
+        }
+
+        TimetableCatalog::getInstance().publish(TimetableCatalog::getInstance().loadFromDatabase());
+        AvailabilityCache::getInstance().invalidate();
+        result.ok = true;
+        return result;
+    }
+
+private:
+    struct Delta {
+        std::vector<Train> trains;   // file order
+        std::map<std::string, std::vector<TimetableCatalog::Stop>> stops;
+        std::vector<std::string> removals;
+    };
+
+    static std::vector<std::string> split(const std::string& line) {
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, '|')) fields.push_back(field);
+        return fields;
+    }
+
+    bool parse(std::istream& in, Delta& delta, std::string& error) {
+        std::string line;
+        std::set<std::string> seen;
+        for (int lineNo = 1; std::getline(in, line); ++lineNo) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty() || line[0] == '#') continue;
+            auto fields = split(line);
+            try {
+                if (fields[0] == "TRAIN" && fields.size() == 11) {
+                    Train t;
+                    t.number = fields[1];
+                    t.name = fields[2];
+                    t.source = fields[3];
+                    t.destination = fields[4];
+                    t.departureTime = fields[5];
+                    t.journeyDuration = fields[6];
+                    t.totalAcSeats = std::stoi(fields[7]);
+                    t.totalSleeperSeats = std::stoi(fields[8]);
+                    t.acFare = std::stod(fields[9]);
+                    t.sleeperFare = std::stod(fields[10]);
+                    if (!seen.insert(t.number).second) {
+                        error = "line " + std::to_string(lineNo) + ": train " + t.number + " listed twice";
+                        return false;
+                    }
+                    delta.trains.push_back(t);
+                } else if (fields[0] == "STOP" && fields.size() == 6) {
+                    delta.stops[fields[1]].push_back({std::stoi(fields[2]), fields[3], std::stoi(fields[4]), std::stoi(fields[5])});
+                } else if (fields[0] == "REMOVE" && fields.size() == 2) {
+                    delta.removals.push_back(fields[1]);
+                } else {
+                    error = "line " + std::to_string(lineNo) + ": unrecognised record";
+                    return false;
+                }
+            } catch (const std::exception&) {
+                error = "line " + std::to_string(lineNo) + ": bad number";
+                return false;
+            }
+        }
+        for (const auto& entry : delta.stops) {
+            if (!seen.count(entry.first)) {
+                error = "stops for " + entry.first + " need a TRAIN line in the same file";
+                return false;
+            }
+        }
+        for (const auto& number : delta.removals) {
+            if (seen.count(number)) {
+                error = "train " + number + " is both defined and removed";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool apply(const TimetableCatalog::Snapshot& before, const Delta& delta, Result& result) {
+        auto& db = DatabaseManager::getInstance();
+        PreparedStatement update = db.prepare(
+            "UPDATE trains SET train_name = ?, source = ?, destination = ?, departure_time = ?, journey_duration = ?, "
+            "total_ac_seats = ?, total_sleeper_seats = ?, ac_fare = ?, sleeper_fare = ? WHERE train_number = ?;");
+        // Departures that have not left keep their booked seats when a train's capacity changes, so
+        // a smaller train is refused while any of them has sold more than the new total; those running
+        // with their own rake keep that rake's capacity
+        const std::string following = " WHERE train_id = ? AND departure_date >= date('now') "
+            "AND NOT EXISTS (SELECT 1 FROM schedule_coaches c WHERE c.schedule_id = schedules.schedule_id)";
+        PreparedStatement oversold = db.prepare(
+            "SELECT schedule_id, departure_date FROM schedules" + following +
+            " AND (ac_seats_available + ? < 0 OR sleeper_seats_available + ? < 0) ORDER BY departure_date;");
+        PreparedStatement resize = db.prepare(
+            "UPDATE schedules SET ac_seats_available = ac_seats_available + ?, "
+            "sleeper_seats_available = sleeper_seats_available + ?" + following + ";");
+        // A train with a coach composition takes its seat totals from the coaches
+        PreparedStatement hasRake = db.prepare("SELECT 1 FROM train_coaches WHERE train_number = ? LIMIT 1;");
+        PreparedStatement clearStops = db.prepare("DELETE FROM train_stops WHERE train_number = ?;");
+        PreparedStatement insertStop = db.prepare(
+            "INSERT INTO train_stops (train_number, stop_seq, station, arrival_offset, departure_offset) VALUES (?, ?, ?, ?, ?);");
+        if (!update.valid() || !oversold.valid() || !resize.valid() || !hasRake.valid() || !clearStops.valid() || !insertStop.valid()) {
+            result.error = "could not prepare statements";
+            return false;
+        }
+
+        for (const auto& train : delta.trains) {
+            const Train* existing = before.find(train.number);
+            if (!existing) {
+                if (!db.insertRow<Schema::Trains>(train)) {
+                    result.error = "could not add train " + train.number;
+                    return false;
+                }
+                result.added++;
+            } else if (!TimetableCatalog::sameTrain(*existing, train)) {
+                bool resized = train.totalAcSeats != existing->totalAcSeats || train.totalSleeperSeats != existing->totalSleeperSeats;
+                hasRake.bind(1, train.number);
+                bool composed = hasRake.step() == SQLITE_ROW;
+                hasRake.reset();
+                if (resized && composed) {
+                    result.error = "seat totals of " + train.number + " come from its coach composition";
+                    return false;
+                }
+                const int acDelta = train.totalAcSeats - existing->totalAcSeats;
+                const int sleeperDelta = train.totalSleeperSeats - existing->totalSleeperSeats;
+                if (resized) {
+                    oversold.bind(1, existing->id);
+                    oversold.bind(2, acDelta);
+                    oversold.bind(3, sleeperDelta);
+                    std::string departures;
+                    while (oversold.step() == SQLITE_ROW) {
+                        departures += (departures.empty() ? "" : ", ") + std::to_string(oversold.columnInt(0)) + " on " + oversold.columnText(1);
+                    }
+                    oversold.reset();
+                    if (!departures.empty()) {
+                        result.error = "train " + train.number + " has sold more seats than its new totals on departure(s) " + departures;
+                        return false;
+                    }
+                }
+                update.bind(1, train.name);
+                update.bind(2, train.source);
+                update.bind(3, train.destination);
+                update.bind(4, train.departureTime);
+                update.bind(5, train.journeyDuration);
+                update.bind(6, train.totalAcSeats);
+                update.bind(7, train.totalSleeperSeats);
+                update.bind(8, train.acFare);
+                update.bind(9, train.sleeperFare);
+                update.bind(10, train.number);
+                if (!update.execute()) {
+                    result.error = "could not update train " + train.number;
+                    return false;
+                }
+                if (resized) {
+                    resize.bind(1, acDelta);
+                    resize.bind(2, sleeperDelta);
+                    resize.bind(3, existing->id);
+                    if (!resize.execute()) {
+                        result.error = "could not resize departures of " + train.number;
+                        return false;
+                    }
+                }
+                result.changed++;
+            } else {
+                result.unchanged++;
+            }
+
+            auto newStops = delta.stops.find(train.number);
+            if (newStops == delta.stops.end()) continue;
+            auto oldStops = before.stops.find(train.number);
+            if (oldStops != before.stops.end() && oldStops->second == newStops->second) continue;
+            clearStops.bind(1, train.number);
+            bool ok = clearStops.execute();
+            for (const auto& stop : newStops->second) {
+                insertStop.bind(1, train.number);
+                insertStop.bind(2, stop.seq);
+                insertStop.bind(3, stop.station);
+                insertStop.bind(4, stop.arrivalOffset);
+                insertStop.bind(5, stop.departureOffset);
+                ok = ok && insertStop.execute();
+            }
+            if (!ok) {
+                result.error = "could not replace stops of " + train.number;
+                return false;
+            }
+            result.stopListsReplaced++;
+        }
+
+        for (const auto& number : delta.removals) {
+            const Train* existing = before.find(number);
+            if (!existing) continue;
+            if (!removeTrain(existing->id, number, result.error)) return false;
+            result.removed++;
+        }
+        return true;
+    }
+};
+
+// ===================================================================
+//  CoachComposition Class
+//  Coach types and rakes. A train's standard rake (its coaches in
+//  order) sets the train's seat totals, which every new departure
+//  starts from. Before a departure gains or loses a coach it gets its
+//  own copy of the rake; the change then moves that departure's seat
+//  counter by the coach's berths and leaves its bookings alone.
+//  Bookings draw on the class as a whole, so per-coach occupancy is
+//  shown by filling the coaches in rake order.
+// ===================================================================
+class CoachComposition {
+public:
+    struct Coach {
+        int position = 0;
+        std::string label;
+        CoachType type;
+    };
+
+    struct Departure {
+        int scheduleId = 0, trainId = 0;
+        std::string trainNumber, date;
+        int acAvailable = 0, sleeperAvailable = 0;
+        int acSeats = 0, sleeperSeats = 0; // the rake's berths, or the train's totals when it has no rake
+        bool ownRake = false;
+        std::vector<Coach> coaches;
+    };
+
+    std::map<std::string, CoachType> types() {
+        std::map<std::string, CoachType> byCode;
+        for (auto& type : DatabaseManager::getInstance().selectRows<Schema::CoachTypes>("ORDER BY code")) byCode[type.code] = type;
+        return byCode;
+    }
+
+    bool addType(const CoachType& type, std::string& error) {
+        if (type.code.empty() || (type.seatClass != "AC" && type.seatClass != "Sleeper") || type.berths <= 0 ||
+            type.labelPrefix.empty() || berthTypes(type).empty()) {
+            error = "a coach type needs a code, class AC or Sleeper, berths, a label prefix and a bay layout";
+            return false;
+        }
+        if (types().count(type.code)) {
+            error = "coach type " + type.code + " already exists";
+            return false;
+        }
+        if (!DatabaseManager::getInstance().insertRow<Schema::CoachTypes>(type)) {
+            error = "could not add coach type " + type.code;
+            return false;
+        }
+        return true;
+    }
+
+    // "1A,2A*2,3A*4,SL*10" -> one type code per coach, in rake order
+    static bool parseRake(const std::string& spec, std::vector<std::string>& codes, std::string& error) {
+        std::stringstream ss(spec);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            size_t star = item.find('*');
+            std::string code = item.substr(0, star);
+            int count = 1;
+            if (star != std::string::npos) {
+                char* end = nullptr;
+                count = static_cast<int>(std::strtol(item.c_str() + star + 1, &end, 10));
+                if (*end != '\0') count = 0;
+            }
+            if (code.empty() || count < 1 || count > 99) {
+                error = "bad rake entry '" + item + "'; expected TYPE or TYPE*COUNT";
+                return false;
+            }
+            codes.insert(codes.end(), count, code);
+        }
+        if (codes.empty()) error = "the rake has no coaches";
+        return !codes.empty();
+    }
+
+    // Replaces a train's standard rake and sets its seat totals to the rake's berths.
+    // Departures that have not left and follow the standard rake move their counters by
+    // the difference; a smaller rake is refused if any of them has sold the seats it drops.
+    bool setTrainRake(const std::string& trainNumber, const std::vector<std::string>& codes, std::string& error) {
+        auto known = types();
+        std::vector<TrainCoach> rake;
+        std::map<std::string, int> perPrefix;
+        int acSeats = 0, sleeperSeats = 0;
+        for (const auto& code : codes) {
+            auto type = known.find(code);
+            if (type == known.end()) {
+                error = "unknown coach type " + code;
+                return false;
+            }
+            (type->second.seatClass == "AC" ? acSeats : sleeperSeats) += type->second.berths;
+            std::string label = type->second.labelPrefix + std::to_string(++perPrefix[type->second.labelPrefix]);
+            rake.push_back({trainNumber, static_cast<int>(rake.size()) + 1, label, code});
+        }
+
+        auto& db = DatabaseManager::getInstance();
+        if (!db.beginTransaction()) {
+            error = "could not start transaction";
+            return false;
+        }
+        PreparedStatement train = db.prepare("SELECT train_id, total_ac_seats, total_sleeper_seats FROM trains WHERE train_number = ?;");
+        train.bind(1, trainNumber);
+        if (train.step() != SQLITE_ROW) {
+            db.rollback();
+            error = "train " + trainNumber + " not found";
+            return false;
+        }
+        int trainId = train.columnInt(0), acDelta = acSeats - train.columnInt(1), sleeperDelta = sleeperSeats - train.columnInt(2);
+        train.reset();
+
+        const std::string following = " WHERE train_id = ? AND departure_date >= ? "
+            "AND NOT EXISTS (SELECT 1 FROM schedule_coaches c WHERE c.schedule_id = schedules.schedule_id)";
+        const std::string today = TimeUtil::formatDate(TimeUtil::today());
+        PreparedStatement oversold = db.prepare(
+            "SELECT schedule_id, departure_date, ac_seats_available, sleeper_seats_available FROM schedules" + following +
+            " AND (ac_seats_available + ? < 0 OR sleeper_seats_available + ? < 0) ORDER BY departure_date LIMIT 1;");
+        oversold.bind(1, trainId);
+        oversold.bind(2, today);
+        oversold.bind(3, acDelta);
+        oversold.bind(4, sleeperDelta);
+        if (oversold.step() == SQLITE_ROW) {
+            bool ac = oversold.columnInt(2) + acDelta < 0;
+            int unsold = oversold.columnInt(ac ? 2 : 3), removed = -(ac ? acDelta : sleeperDelta);
+            error = "departure " + std::to_string(oversold.columnInt(0)) + " on " + oversold.columnText(1) + " has only " +
+                    std::to_string(unsold) + " " + (ac ? "AC" : "Sleeper") + " seats unsold but the new rake has " +
+                    std::to_string(removed) + " fewer";
+            oversold.reset();
+            db.rollback();
+            return false;
+        }
+        oversold.reset();
+
+        PreparedStatement clear = db.prepare("DELETE FROM train_coaches WHERE train_number = ?;");
+        PreparedStatement totals = db.prepare("UPDATE trains SET total_ac_seats = ?, total_sleeper_seats = ? WHERE train_id = ?;");
+        PreparedStatement resize = db.prepare(
+            "UPDATE schedules SET ac_seats_available = ac_seats_available + ?, "
+            "sleeper_seats_available = sleeper_seats_available + ?" + following + ";");
+        clear.bind(1, trainNumber);
+        totals.bind(1, acSeats);
+        totals.bind(2, sleeperSeats);
+        totals.bind(3, trainId);
+        resize.bind(1, acDelta);
+        resize.bind(2, sleeperDelta);
+        resize.bind(3, trainId);
+        resize.bind(4, today);
+        bool ok = clear.valid() && totals.valid() && resize.valid() && clear.execute();
+        for (size_t i = 0; i < rake.size() && ok; ++i) ok = db.insertRow<Schema::TrainCoaches>(rake[i]);
+        if (!ok || !totals.execute() || !resize.execute() || !db.commit()) {
+            db.rollback();
+            error = "could not store the rake of " + trainNumber;
+            return false;
+        }
+        AvailabilityCache::getInstance().invalidate();
+        TimetableCatalog::getInstance().invalidate();
+        return true;
+    }
+
+    // A departure with its capacity and the rake it runs with (its own, else its train's)
+    bool loadDeparture(int scheduleId, Departure& departure, std::string& error) {
+        auto& db = DatabaseManager::getInstance();
+        PreparedStatement schedule = db.prepare(
+            "SELECT s.train_id, t.train_number, s.departure_date, s.ac_seats_available, s.sleeper_seats_available, "
+            "t.total_ac_seats, t.total_sleeper_seats FROM schedules s JOIN trains t ON t.train_id = s.train_id WHERE s.schedule_id = ?;");
+        schedule.bind(1, scheduleId);
+        if (schedule.step() != SQLITE_ROW) {
+            error = "no departure with schedule ID " + std::to_string(scheduleId);
+            return false;
+        }
+        departure = Departure();
+        departure.scheduleId = scheduleId;
+        departure.trainId = schedule.columnInt(0);
+        departure.trainNumber = schedule.columnText(1);
+        departure.date = schedule.columnText(2);
+        departure.acAvailable = schedule.columnInt(3);
+        departure.sleeperAvailable = schedule.columnInt(4);
+        departure.acSeats = schedule.columnInt(5);
+        departure.sleeperSeats = schedule.columnInt(6);
+
+        auto known = types();
+        auto own = db.selectRows<Schema::ScheduleCoaches>("WHERE schedule_id = ? ORDER BY position", {std::to_string(scheduleId)});
+        departure.ownRake = !own.empty();
+        if (departure.ownRake) {
+            for (const auto& coach : own) departure.coaches.push_back({coach.position, coach.label, known[coach.coachType]});
+        } else {
+            for (const auto& coach : db.selectRows<Schema::TrainCoaches>("WHERE train_number = ? ORDER BY position", {departure.trainNumber})) {
+                departure.coaches.push_back({coach.position, coach.label, known[coach.coachType]});
+            }
+        }
+        if (!departure.coaches.empty()) {
+            departure.acSeats = departure.sleeperSeats = 0;
+            for (const auto& coach : departure.coaches) (coach.type.seatClass == "AC" ? departure.acSeats : departure.sleeperSeats) += coach.type.berths;
+        }
+        return true;
+    }
+
+    // Appends a coach to one departure; 'label' receives the new coach's label
+    bool addCoach(int scheduleId, const std::string& typeCode, std::string& label, std::string& error) {
+        auto known = types();
+        auto type = known.find(typeCode);
+        if (type == known.end()) {
+            error = "unknown coach type " + typeCode;
+            return false;
+        }
+        auto& db = DatabaseManager::getInstance();
+        if (!db.beginTransaction()) {
+            error = "could not start transaction";
+            return false;
+        }
+        Departure departure;
+        if (!loadChangeable(scheduleId, departure, error) || !ensureOwnRake(departure, error)) {
+            db.rollback();
+            return false;
+        }
+        label = nextLabel(departure, type->second.labelPrefix);
+        ScheduleCoach coach{scheduleId, departure.coaches.back().position + 1, label, typeCode};
+        bool ac = type->second.seatClass == "AC";
+        std::string column = ac ? "ac_seats_available" : "sleeper_seats_available";
+        if (!db.insertRow<Schema::ScheduleCoaches>(coach) ||
+            !db.executeUpdate("UPDATE schedules SET " + column + " = " + column + " + " + std::to_string(type->second.berths) +
+                              " WHERE schedule_id = " + std::to_string(scheduleId) + ";") ||
+            !db.commit()) {
+            db.rollback();
+            error = "could not add the coach";
+            return false;
+        }
+        AvailabilityCache::getInstance().adjust(scheduleId, ac, type->second.berths);
+        return true;
+    }
+
+    // Takes a coach off one departure, provided its class has that many unsold seats
+    bool removeCoach(int scheduleId, const std::string& label, std::string& error) {
+        auto& db = DatabaseManager::getInstance();
+        if (!db.beginTransaction()) {
+            error = "could not start transaction";
+            return false;
+        }
+        Departure departure;
+        if (!loadChangeable(scheduleId, departure, error)) {
+            db.rollback();
+            return false;
+        }
+        auto coach = std::find_if(departure.coaches.begin(), departure.coaches.end(), [&](const Coach& c) { return c.label == label; });
+        if (coach == departure.coaches.end() || departure.coaches.size() == 1) {
+            db.rollback();
+            error = coach == departure.coaches.end() ? "no coach " + label + " on this departure" : "a departure keeps at least one coach";
+            return false;
+        }
+        bool ac = coach->type.seatClass == "AC";
+        int berths = coach->type.berths, unsold = ac ? departure.acAvailable : departure.sleeperAvailable;
+        if (unsold < berths) {
+            db.rollback();
+            error = "coach " + label + " has " + std::to_string(berths) + " berths but only " + std::to_string(unsold) + " " +
+                    coach->type.seatClass + " seats are unsold";
+            return false;
+        }
+        int position = coach->position;
+        std::string column = ac ? "ac_seats_available" : "sleeper_seats_available";
+        if (!ensureOwnRake(departure, error) ||
+            !db.executeUpdate("DELETE FROM schedule_coaches WHERE schedule_id = " + std::to_string(scheduleId) +
+                              " AND position = " + std::to_string(position) + ";") ||
+            !db.executeUpdate("UPDATE schedules SET " + column + " = " + column + " - " + std::to_string(berths) +
+                              " WHERE schedule_id = " + std::to_string(scheduleId) + ";") ||
+            !db.commit()) {
+            db.rollback();
+            if (error.empty()) error = "could not remove the coach";
+            return false;
+        }
+        AvailabilityCache::getInstance().adjust(scheduleId, ac, -berths);
+        return true;
+    }
+
+    // Berth type of each berth: the bay layout repeated along the coach
+    static std::vector<std::string> berthTypes(const CoachType& type) {
+        std::vector<std::string> bay, berths;
+        std::stringstream ss(type.layout);
+        std::string token;
+        while (ss >> token) bay.push_back(token);
+        for (int i = 0; i < type.berths && !bay.empty(); ++i) berths.push_back(bay[i % bay.size()]);
+        return berths;
+    }
+
+    static void printDeparture(const Departure& departure) {
+        std::cout << "Departure " << departure.scheduleId << ": " << departure.trainNumber << " on " << departure.date;
+        if (departure.coaches.empty()) {
+            std::cout << " has no coach composition; " << departure.acSeats << " AC and " << departure.sleeperSeats
+                      << " Sleeper seats are counted per class only.\n";
+            return;
+        }
+        std::cout << (departure.ownRake ? ", own rake" : ", standard rake") << " of " << departure.coaches.size() << " coaches\n";
+        const int W_POS = 4, W_LABEL = 6, W_TYPE = 5, W_CLASS = 8, W_BERTHS = 7, W_SOLD = 6, W_FREE = 6, W_MIX = 30;
+        const int width = W_POS + W_LABEL + W_TYPE + W_CLASS + W_BERTHS + W_SOLD + W_FREE + W_MIX + 25;
+        std::cout << std::string(width, '-') << "\n";
+        std::cout << "| " << std::left << std::setw(W_POS) << "Pos" << "| " << std::setw(W_LABEL) << "Coach" << "| " << std::setw(W_TYPE) << "Type"
+                  << "| " << std::setw(W_CLASS) << "Class" << "| " << std::setw(W_BERTHS) << "Berths" << "| " << std::setw(W_SOLD) << "Sold"
+                  << "| " << std::setw(W_FREE) << "Free" << "| " << std::setw(W_MIX) << "Berth types" << " |\n";
+        std::cout << std::string(width, '-') << "\n";
+        int acSold = departure.acSeats - departure.acAvailable, sleeperSold = departure.sleeperSeats - departure.sleeperAvailable;
+        for (const auto& coach : departure.coaches) {
+            int& classSold = coach.type.seatClass == "AC" ? acSold : sleeperSold;
+            int sold = std::max(0, std::min(coach.type.berths, classSold));
+            classSold -= sold;
+            std::vector<std::pair<std::string, int>> mix;
+            for (const auto& berth : berthTypes(coach.type)) {
+                auto it = std::find_if(mix.begin(), mix.end(), [&](const std::pair<std::string, int>& m) { return m.first == berth; });
+                if (it == mix.end()) mix.emplace_back(berth, 1); else it->second++;
+            }
+            std::string mixText;
+            for (const auto& m : mix) mixText += (mixText.empty() ? "" : " ") + m.first + " " + std::to_string(m.second);
+            std::cout << "| " << std::left << std::setw(W_POS) << coach.position << "| " << std::setw(W_LABEL) << coach.label
+                      << "| " << std::setw(W_TYPE) << coach.type.code << "| " << std::setw(W_CLASS) << coach.type.seatClass
+                      << "| " << std::setw(W_BERTHS) << coach.type.berths << "| " << std::setw(W_SOLD) << sold
+                      << "| " << std::setw(W_FREE) << coach.type.berths - sold << "| " << std::setw(W_MIX) << mixText.substr(0, W_MIX) << " |\n";
+        }
+        std::cout << std::string(width, '-') << "\n";
+        std::cout << "AC " << departure.acAvailable << "/" << departure.acSeats << " free, Sleeper "
+                  << departure.sleeperAvailable << "/" << departure.sleeperSeats << " free.\n";
+    }
+
+private:
+    // Loads a departure that has not left yet and runs with a rake
+    bool loadChangeable(int scheduleId, Departure& departure, std::string& error) {
+        if (!loadDeparture(scheduleId, departure, error)) return false;
+        long day = 0;
+        if (!TimeUtil::parseDate(departure.date, day) || day < TimeUtil::today()) {
+            error = "departure " + std::to_string(scheduleId) + " has already left";
+            return false;
+        }
+        if (departure.coaches.empty()) {
+            error = "train " + departure.trainNumber + " has no coach composition; set its standard rake first";
+            return false;
+        }
+        return true;
+    }
+
+    // Copies the train's standard rake to the departure before its first change
+    bool ensureOwnRake(Departure& departure, std::string& error) {
+        if (departure.ownRake) return true;
+        auto& db = DatabaseManager::getInstance();
+        for (const auto& coach : departure.coaches) {
+            if (!db.insertRow<Schema::ScheduleCoaches>({departure.scheduleId, coach.position, coach.label, coach.type.code})) {
+                error = "could not copy the standard rake";
+                return false;
+            }
+        }
+        departure.ownRake = true;
+        return true;
+    }
+
+    // Prefix plus one more than the highest number already used with that prefix
+    static std::string nextLabel(const Departure& departure, const std::string& prefix) {
+        int highest = 0;
+        for (const auto& coach : departure.coaches) {
+            const std::string& label = coach.label;
+            if (label.size() > prefix.size() && label.compare(0, prefix.size(), prefix) == 0 &&
+                label.find_first_not_of("0123456789", prefix.size()) == std::string::npos) {
+                highest = std::max(highest, std::stoi(label.substr(prefix.size())));
+            }
+        }
+        return prefix + std::to_string(highest + 1);
+    }
+};
+
+// ===================================================================
+//  StorageBackend Interface
+//  The booking operations the menus need, independent of where the
+//  data lives. SqliteStorage is the production path; MemoryStorage
+//  keeps everything in hash maps and arrays for benchmarks and
+//  simulations, and as a baseline for the cost of the storage layer.
+// ===================================================================
+class StorageBackend {
+public:
+    enum class ScheduleStatus { Scheduled, NoSuchTrain, AlreadyScheduled, Failed };
+    enum class ReserveStatus { Reserved, NotEnoughSeats, NoSuchSchedule, Failed };
+    enum class ReleaseStatus { Released, NoSuchBooking, Failed };
+
+    // One booking with the train and departure it belongs to
+    struct BookingView {
+        Booking booking;
+        Train train;
+        std::string departureDate;
+    };
+
+    virtual ~StorageBackend() = default;
+
+    virtual const char* name() const = 0;
+    virtual bool addTrain(const Train& train) = 0;
+    virtual ScheduleStatus scheduleTrain(const std::string& trainNumber, const std::string& date) = 0;
+    // Departures on or after 'fromDate' (YYYY-MM-DD) with their trains
+    virtual std::vector<std::pair<Schedule, Train>> findSchedules(const std::string& fromDate) = 0;
+    // Takes booking.numSeats seats of booking.seatClass ("AC" or "Sleeper") and records the booking
+    virtual ReserveStatus reserveSeats(const Booking& booking) = 0;
+    // Deletes the user's booking with this ticket and returns its seats
+    virtual ReleaseStatus releaseSeats(long long ticket, int userId, Booking& released) = 0;
+    // False if the bookings could not be read; 'reason' says why when known
+    virtual bool listBookingsForUser(int userId, std::vector<BookingView>& bookings, std::string& reason) = 0;
+};
+
+// ===================================================================
+//  SqliteStorage Class
+//  StorageBackend over DatabaseManager. Also keeps the in-memory
+//  availability cache and timetable catalog in step with its writes.
+// ===================================================================
+class SqliteStorage : public StorageBackend {
+public:
+    const char* name() const override { return "sqlite"; }
+
+    bool addTrain(const Train& train) override {
+        if (!DatabaseManager::getInstance().insertRow<Schema::Trains>(train)) return false;
+        TimetableCatalog::getInstance().invalidate();
+        return true;
+    }
+
+    ScheduleStatus scheduleTrain(const std::string& trainNumber, const std::string& date) override {
+        auto& db = DatabaseManager::getInstance();
+        auto trains = db.selectRows<Schema::Trains>("WHERE train_number = ?", {trainNumber});
+        if (trains.empty()) return ScheduleStatus::NoSuchTrain;
+        Schedule schedule;
+        schedule.trainId = trains[0].id;
+        schedule.departureDate = date;
+        schedule.acSeatsAvailable = trains[0].totalAcSeats;
+        schedule.sleeperSeatsAvailable = trains[0].totalSleeperSeats;
+        if (!db.insertRow<Schema::Schedules>(schedule)) return ScheduleStatus::AlreadyScheduled;
+        AvailabilityCache::getInstance().invalidate();
+        return ScheduleStatus::Scheduled;
+    }
+
+    // Schedule columns followed by train columns, both in descriptor order
+    static std::string departuresSql() {
+        return "SELECT " + Schema::columnList<Schema::Schedules>("s") + ", " + Schema::columnList<Schema::Trains>("t") +
+               " FROM schedules s JOIN trains t ON s.train_id = t.train_id WHERE s.departure_date >= ?;";
+    }
+
+    // Booking columns, train columns, then the departure date
+    static std::string userBookingsSql() {
+        return "SELECT " + Schema::columnList<Schema::Bookings>("b") + ", " + Schema::columnList<Schema::Trains>("t") +
+               ", s.departure_date FROM bookings b JOIN schedules s ON b.schedule_id = s.schedule_id "
+               "JOIN trains t ON s.train_id = t.train_id WHERE b.user_id = ?;";
+    }
+
+    std::vector<std::pair<Schedule, Train>> findSchedules(const std::string& fromDate) override {
+        PreparedStatement listing = DatabaseManager::getInstance().prepare(departuresSql());
+        std::vector<std::pair<Schedule, Train>> results;
+        listing.bind(1, fromDate);
+        while (listing.step() == SQLITE_ROW) {
+            results.emplace_back(Schema::readRow<Schema::Schedules>(listing),
+                                 Schema::readRow<Schema::Trains>(listing, Schema::columnCount<Schema::Schedules>()));
+        }
+        return results;
+    }
+
+    ReserveStatus reserveSeats(const Booking& booking) override {
+        auto& db = DatabaseManager::getInstance();
+        const bool ac = booking.seatClass == "AC";
+        const std::string seatColumn = ac ? "ac_seats_available" : "sleeper_seats_available";
+        if (!db.beginTransaction()) return ReserveStatus::Failed;
+
+        auto current = db.executeQuery("SELECT " + seatColumn + " FROM schedules WHERE schedule_id=" + std::to_string(booking.scheduleId) + ";");
+        if (current.empty() || std::stoi(current[0][0]) < booking.numSeats) {
+            db.rollback();
+            // The cache lagged behind another writer; reload it before it is used for suggestions
+            AvailabilityCache::getInstance().invalidate();
+            return current.empty() ? ReserveStatus::NoSuchSchedule : ReserveStatus::NotEnoughSeats;
+        }
+
+        std::string updateSql = "UPDATE schedules SET " + seatColumn + " = " + std::to_string(std::stoi(current[0][0]) - booking.numSeats) +
+                                " WHERE schedule_id=" + std::to_string(booking.scheduleId) + ";";
+        if (db.insertRow<Schema::Bookings>(booking) && db.executeUpdate(updateSql) && db.commit()) {
+            AvailabilityCache::getInstance().adjust(booking.scheduleId, ac, -booking.numSeats);
+            return ReserveStatus::Reserved;
+        }
+        db.rollback();
+        return ReserveStatus::Failed;
+    }
+
+    ReleaseStatus releaseSeats(long long ticket, int userId, Booking& released) override {
+        auto& db = DatabaseManager::getInstance();
+        if (!db.beginTransaction()) return ReleaseStatus::Failed;
+
+        auto rows = db.selectRows<Schema::Bookings>("WHERE ticket = ? AND user_id = ?", {std::to_string(ticket), std::to_string(userId)});
+        if (rows.empty()) {
+            db.rollback();
+            return ReleaseStatus::NoSuchBooking;
+        }
+        released = rows[0];
+        std::string seatColumn = released.seatClass == "AC" ? "ac_seats_available" : "sleeper_seats_available";
+        std::string deleteSql = "DELETE FROM bookings WHERE schedule_id=" + std::to_string(released.scheduleId) + " AND ticket=" + std::to_string(ticket) + ";";
+        std::string updateSql = "UPDATE schedules SET " + seatColumn + " = " + seatColumn + " + " + std::to_string(released.numSeats) +
+                                " WHERE schedule_id=" + std::to_string(released.scheduleId) + ";";
+        if (db.executeUpdate(deleteSql) && db.executeUpdate(updateSql) && db.commit()) {
+            AvailabilityCache::getInstance().adjust(released.scheduleId, released.seatClass == "AC", released.numSeats);
+            return ReleaseStatus::Released;
+        }
+        db.rollback();
+        return ReleaseStatus::Failed;
+    }
+
+    bool listBookingsForUser(int userId, std::vector<BookingView>& bookings, std::string& reason) override {
+        auto lease = ConnectionPool::getInstance().acquire(WorkloadClass::UserRead);
+        if (!lease.valid()) {
+            reason = lease.interruption();
+            return false;
+        }
+        PreparedStatement stmt(lease.connection(), userBookingsSql());
+        if (!stmt.valid()) return false;
+        stmt.bind(1, userId);
+        const int trainOffset = Schema::columnCount<Schema::Bookings>();
+        const int dateColumn = trainOffset + Schema::columnCount<Schema::Trains>();
+        int rc;
+        while ((rc = stmt.step()) == SQLITE_ROW) {
+            bookings.push_back({Schema::readRow<Schema::Bookings>(stmt), Schema::readRow<Schema::Trains>(stmt, trainOffset),
+                                stmt.columnText(dateColumn)});
+        }
+        if (rc != SQLITE_DONE) reason = lease.interruption();
+        return rc == SQLITE_DONE;
+    }
+};
+
+// ===================================================================
+//  EscrowCounter Class
+//  A seat counter split into per-thread slices, each on its own cache
+//  line, so threads selling the same departure do not contend on one
+//  counter. A thread sells from its own slice with a compare-and-swap.
+//  When the slice cannot cover a request, the thread takes a share of
+//  the central pool under the rebalance lock. If the pool is short
+//  too, it drains every slice back into the pool first. Seats only
+//  move between pool and slices under that lock, so the count is
+//  exact: a request fails only when fewer seats remain in total.
+// ===================================================================
+class EscrowCounter {
+public:
+    EscrowCounter(int seats, int sliceCount)
+        : slices(new Slice[std::max(1, sliceCount)]), sliceCount(std::max(1, sliceCount)), pool(seats) {}
+
+    bool take(int seats) {
+        Slice& mine = slices[sliceIndex()];
+        int have = mine.seats.load(std::memory_order_relaxed);
+        while (have >= seats) {
+            if (mine.seats.compare_exchange_weak(have, have - seats, std::memory_order_acq_rel)) return true;
+        }
+        return refill(mine, seats);
+    }
+
+    // Returned seats go to the caller's slice
+    void give(int seats) { slices[sliceIndex()].seats.fetch_add(seats, std::memory_order_acq_rel); }
+
+    // Exact when no take or give is running
+    int available() {
+        InstrumentedMutex::Guard guard(rebalanceMutex);
+        int total = pool;
+        for (int i = 0; i < sliceCount; ++i) total += slices[i].seats.load(std::memory_order_acquire);
+        return total;
+    }
+
+    unsigned long long rebalances() const { return rebalanceCount.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Slice {
+        std::atomic<int> seats{0};
+    };
+
+    std::unique_ptr<Slice[]> slices;
+    const int sliceCount;
+    InstrumentedMutex rebalanceMutex{"escrow.rebalance"};
+    int pool; // seats in no slice, guarded by rebalanceMutex
+    std::atomic<unsigned long long> rebalanceCount{0};
+
+    // Threads are numbered in order of first use and share slices round-robin
+    int sliceIndex() const {
+        static std::atomic<int> nextThread{0};
+        thread_local int thread = nextThread++;
+        return thread % sliceCount;
+    }
+
+    bool refill(Slice& mine, int seats) {
+        InstrumentedMutex::Guard guard(rebalanceMutex);
+        rebalanceCount.fetch_add(1, std::memory_order_relaxed);
+        if (pool < seats) {
+            for (int i = 0; i < sliceCount; ++i) pool += slices[i].seats.exchange(0, std::memory_order_acq_rel);
+        }
+        if (pool < seats) return false;
+        // This request plus an even share of what is left, so slices drain at about the same time
+        int share = seats + (pool - seats) / sliceCount;
+        pool -= share;
+        mine.seats.fetch_add(share - seats, std::memory_order_acq_rel);
+        return true;
+    }
+};
+
+// ===================================================================
+//  MemoryStorage Class
+//  StorageBackend kept entirely in process memory. Trains and
+//  departures live in arrays indexed by id - 1, bookings in hash maps
+//  sharded by ticket and by user. Nothing is persisted. Reservations,
+//  cancellations and listings may run on many threads at once; adding
+//  trains, scheduling and markHot are setup calls and must not run
+//  concurrently with anything. Seat counters share one lock, except
+//  hot (departure, class) pairs, whose seats are held in an
+//  EscrowCounter.
+// ===================================================================
+class MemoryStorage : public StorageBackend {
+public:
+    const char* name() const override { return "memory"; }
+
+    bool addTrain(const Train& train) override {
+        if (trainByNumber.count(train.number)) return false;
+        trains.push_back(train);
+        trains.back().id = static_cast<int>(trains.size());
+        trainByNumber[train.number] = trains.back().id;
+        return true;
+    }
+
+    ScheduleStatus scheduleTrain(const std::string& trainNumber, const std::string& date) override {
+        auto train = trainByNumber.find(trainNumber);
+        if (train == trainByNumber.end()) return ScheduleStatus::NoSuchTrain;
+        if (!departureKeys.insert(trainNumber + "|" + date).second) return ScheduleStatus::AlreadyScheduled;
+        const Train& t = trains[train->second - 1];
+        Schedule schedule;
+        schedule.scheduleId = static_cast<int>(schedules.size()) + 1;
+        schedule.trainId = t.id;
+        schedule.departureDate = date;
+        schedule.acSeatsAvailable = t.totalAcSeats;
+        schedule.sleeperSeatsAvailable = t.totalSleeperSeats;
+        schedules.push_back(schedule);
+        return ScheduleStatus::Scheduled;
+    }
+
+    // Moves a departure class's seats into an escrow counter with one slice per selling thread
+    bool markHot(int scheduleId, const std::string& seatClass, int slices) {
+        if (scheduleId < 1 || scheduleId > static_cast<int>(schedules.size())) return false;
+        auto& counter = hot[hotKey(scheduleId, seatClass == "AC")];
+        if (counter) return true;
+        int& seats = seatCounter(scheduleId, seatClass == "AC");
+        counter = std::make_unique<EscrowCounter>(seats, slices);
+        seats = 0;
+        return true;
+    }
+
+    // Rebalances of a hot pair's escrow counter; 0 for pairs that are not hot
+    unsigned long long rebalances(int scheduleId, const std::string& seatClass) const {
+        auto it = hot.find(hotKey(scheduleId, seatClass == "AC"));
+        return it == hot.end() ? 0 : it->second->rebalances();
+    }
+
+    std::vector<std::pair<Schedule, Train>> findSchedules(const std::string& fromDate) override {
+        std::vector<std::pair<Schedule, Train>> results;
+        {
+            std::lock_guard<std::mutex> guard(seatsMutex);
+            for (const auto& schedule : schedules) {
+                if (schedule.departureDate >= fromDate) results.emplace_back(schedule, trains[schedule.trainId - 1]);
+            }
+        }
+        for (auto& row : results) {
+            for (bool ac : {true, false}) {
+                auto it = hot.find(hotKey(row.first.scheduleId, ac));
+                if (it != hot.end()) (ac ? row.first.acSeatsAvailable : row.first.sleeperSeatsAvailable) = it->second->available();
+            }
+        }
+        return results;
+    }
+
+    ReserveStatus reserveSeats(const Booking& booking) override {
+        if (booking.scheduleId < 1 || booking.scheduleId > static_cast<int>(schedules.size())) return ReserveStatus::NoSuchSchedule;
+        const bool ac = booking.seatClass == "AC";
+        if (!takeSeats(booking.scheduleId, ac, booking.numSeats)) return ReserveStatus::NotEnoughSeats;
+        {
+            TicketShard& shard = ticketShard(booking.ticket);
+            std::lock_guard<std::mutex> guard(shard.mutex);
+            if (!shard.bookings.emplace(booking.ticket, booking).second) {
+                returnSeats(booking.scheduleId, ac, booking.numSeats);
+                return ReserveStatus::Failed;
+            }
+        }
+        UserShard& shard = userShard(booking.userId);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        shard.tickets[booking.userId].push_back(booking.ticket);
+        return ReserveStatus::Reserved;
+    }
+
+    ReleaseStatus releaseSeats(long long ticket, int userId, Booking& released) override {
+        {
+            TicketShard& shard = ticketShard(ticket);
+            std::lock_guard<std::mutex> guard(shard.mutex);
+            auto it = shard.bookings.find(ticket);
+            if (it == shard.bookings.end() || it->second.userId != userId) return ReleaseStatus::NoSuchBooking;
+            released = it->second;
+            shard.bookings.erase(it);
+        }
+        returnSeats(released.scheduleId, released.seatClass == "AC", released.numSeats);
+        UserShard& shard = userShard(userId);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        auto& tickets = shard.tickets[userId];
+        tickets.erase(std::find(tickets.begin(), tickets.end(), ticket));
+        return ReleaseStatus::Released;
+    }
+
+    bool listBookingsForUser(int userId, std::vector<BookingView>& bookings, std::string&) override {
+        std::vector<long long> tickets;
+        {
+            UserShard& shard = userShard(userId);
+            std::lock_guard<std::mutex> guard(shard.mutex);
+            auto user = shard.tickets.find(userId);
+            if (user == shard.tickets.end()) return true;
+            tickets = user->second;
+        }
+        for (long long ticket : tickets) {
+            TicketShard& shard = ticketShard(ticket);
+            std::lock_guard<std::mutex> guard(shard.mutex);
+            auto it = shard.bookings.find(ticket);
+            if (it == shard.bookings.end()) continue; // cancelled meanwhile
+            const Schedule& schedule = schedules[it->second.scheduleId - 1];
+            bookings.push_back({it->second, trains[schedule.trainId - 1], schedule.departureDate});
+        }
+        return true;
+    }
+
+private:
+    static const int SHARDS = 64;
+
+    struct TicketShard {
+        std::mutex mutex;
+        std::unordered_map<long long, Booking> bookings;
+    };
+
+    struct UserShard {
+        std::mutex mutex;
+        std::unordered_map<int, std::vector<long long>> tickets;
+    };
+
+    std::vector<Train> trains;
+    std::unordered_map<std::string, int> trainByNumber;
+    std::vector<Schedule> schedules;
+    std::set<std::string> departureKeys; // "train|date" pairs already scheduled
+    std::mutex seatsMutex;               // guards the seat counters in schedules
+    std::unordered_map<long long, std::unique_ptr<EscrowCounter>> hot; // by hotKey; fixed after setup
+    TicketShard ticketShards[SHARDS];
+    UserShard userShards[SHARDS];
+
+    static long long hotKey(int scheduleId, bool ac) { return static_cast<long long>(scheduleId) * 2 + (ac ? 0 : 1); }
+
+    TicketShard& ticketShard(long long ticket) { return ticketShards[static_cast<unsigned long long>(ticket) % SHARDS]; }
+    UserShard& userShard(int userId) { return userShards[static_cast<unsigned>(userId) % SHARDS]; }
+
+    int& seatCounter(int scheduleId, bool ac) {
+        Schedule& schedule = schedules[scheduleId - 1];
+        return ac ? schedule.acSeatsAvailable : schedule.sleeperSeatsAvailable;
+    }
+
+    bool takeSeats(int scheduleId, bool ac, int seats) {
+        auto it = hot.find(hotKey(scheduleId, ac));
+        if (it != hot.end()) return it->second->take(seats);
+        std::lock_guard<std::mutex> guard(seatsMutex);
+        int& counter = seatCounter(scheduleId, ac);
+        if (counter < seats) return false;
+        counter -= seats;
+        return true;
+    }
+
+    void returnSeats(int scheduleId, bool ac, int seats) {
+        auto it = hot.find(hotKey(scheduleId, ac));
+        if (it != hot.end()) {
+            it->second->give(seats);
+            return;
+        }
+        std::lock_guard<std::mutex> guard(seatsMutex);
+        seatCounter(scheduleId, ac) += seats;
+    }
+};
+
+// ===================================================================
+//  SpscQueue Class
+//  Bounded ring buffer for exactly one producer thread and one
+//  consumer thread. Each side owns its index and only reads the
+//  other's, so push and pop are a load, a store and no lock. Each
+//  side caches the other's index and rereads it only when the ring
+//  looks full or empty.
+// ===================================================================
+template <typename T>
+class SpscQueue {
+public:
+    // Capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        ring.resize(size);
+        mask = size - 1;
+    }
+
+    bool push(const T& item) {
+        size_t tail = producer.index.load(std::memory_order_relaxed);
+        if (tail - producer.cachedOther > mask) {
+            producer.cachedOther = consumer.index.load(std::memory_order_acquire);
+            if (tail - producer.cachedOther > mask) return false;
+        }
+        ring[tail & mask] = item;
+        producer.index.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t head = consumer.index.load(std::memory_order_relaxed);
+        if (head == consumer.cachedOther) {
+            consumer.cachedOther = producer.index.load(std::memory_order_acquire);
+            if (head == consumer.cachedOther) return false;
+        }
+        item = ring[head & mask];
+        consumer.index.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct alignas(64) Side {
+        std::atomic<size_t> index{0};
+        size_t cachedOther = 0; // the other side's index when last read
+    };
+
+    std::vector<T> ring;
+    size_t mask = 0;
+    Side producer, consumer;
+};
+
+// ===================================================================
+//  PartitionedInventory Class
+//  Shared-nothing seat inventory. Every departure belongs to one
+//  worker, chosen by hashing its id, and only that worker touches its
+//  counters and the ticket legs held on it. Each worker is pinned to a
+//  core when the platform allows. Client threads send messages through
+//  one SPSC queue per (client, worker) pair and wait for the reply, so
+//  nothing in the data path is locked or shared. A booking over several
+//  departures takes seats leg by leg from each owner. If any leg is
+//  refused, the legs already taken are returned, so a booking holds
+//  all its legs or none. Departures are added before start(), and
+//  each client index must be used by one thread at a time.
+// ===================================================================
+class PartitionedInventory {
+public:
+    struct Leg {
+        int scheduleId = 0;
+        bool ac = false;
+        int seats = 0;
+    };
+
+    PartitionedInventory(int workerCount, int clientCount)
+        : workers(static_cast<size_t>(std::max(1, workerCount))), clients(std::max(1, clientCount)) {
+        for (auto& worker : workers) {
+            for (int c = 0; c < clients; ++c) worker.inbox.push_back(std::make_unique<SpscQueue<Message>>(QUEUE_CAPACITY));
+        }
+    }
+
+    ~PartitionedInventory() { stop(); }
+
+    int workerCount() const { return static_cast<int>(workers.size()); }
+
+    int owner(int scheduleId) const {
+        unsigned long long h = static_cast<unsigned long long>(scheduleId) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<int>((h >> 32) % workers.size());
+    }
+
+    void addDeparture(int scheduleId, int acSeats, int sleeperSeats) {
+        workers[owner(scheduleId)].departures[scheduleId] = {acSeats, sleeperSeats};
+    }
+
+    void start() {
+        stopping = false;
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t w = 0; w < workers.size(); ++w) {
+            threads.emplace_back([this, w] { workerLoop(workers[w]); });
+            pin(threads.back(), static_cast<unsigned>(w % cores));
+        }
+    }
+
+    // Workers finish the messages already queued, then exit
+    void stop() {
+        stopping = true;
+        for (auto& thread : threads) thread.join();
+        threads.clear();
+    }
+
+    bool book(int client, long long ticket, const std::vector<Leg>& legs) {
+        std::vector<Reply> replies(legs.size());
+        for (size_t i = 0; i < legs.size(); ++i) send(client, {Op::Take, ticket, legs[i], &replies[i]});
+        bool all = true;
+        for (auto& reply : replies) all = wait(reply) && all;
+        if (all) return true;
+        for (size_t i = 0; i < legs.size(); ++i) {
+            if (replies[i].state.load(std::memory_order_relaxed) == Reply::DONE) returnLeg(client, ticket, legs[i]);
+        }
+        return false;
+    }
+
+    // Returns the ticket's seats on every leg; false if some leg held nothing for it
+    bool cancel(int client, long long ticket, const std::vector<Leg>& legs) {
+        std::vector<Reply> replies(legs.size());
+        for (size_t i = 0; i < legs.size(); ++i) send(client, {Op::Return, ticket, legs[i], &replies[i]});
+        bool all = true;
+        for (auto& reply : replies) all = wait(reply) && all;
+        return all;
+    }
+
+    // Asks the owner; -1 for an unknown departure
+    int available(int client, int scheduleId, bool ac) {
+        Reply reply;
+        Leg leg;
+        leg.scheduleId = scheduleId;
+        leg.ac = ac;
+        send(client, {Op::Query, 0, leg, &reply});
+        return wait(reply) ? reply.value : -1;
+    }
+
+    // Messages each worker has handled, for checking how evenly the departures are spread
+    std::vector<unsigned long long> handled() const {
+        std::vector<unsigned long long> counts;
+        for (const auto& worker : workers) counts.push_back(worker.handled.load(std::memory_order_relaxed));
+        return counts;
+    }
+
+private:
+    static const size_t QUEUE_CAPACITY = 256;
+
+    enum class Op { Take, Return, Query };
+
+    struct Reply {
+        static const int PENDING = 0, DONE = 1, REFUSED = 2;
+        std::atomic<int> state{PENDING};
+        int value = 0;
+    };
+
+    struct Message {
+        Op op = Op::Query;
+        long long ticket = 0;
+        Leg leg;
+        Reply* reply = nullptr;
+    };
+
+    struct Seats {
+        int ac = 0, sleeper = 0;
+    };
+
+    // Everything but the message counter is touched only by the worker's own thread after start()
+    struct Worker {
+        std::vector<std::unique_ptr<SpscQueue<Message>>> inbox; // one per client
+        std::unordered_map<int, Seats> departures;
+        std::unordered_map<long long, std::vector<Leg>> held; // ticket -> legs taken here
+        std::atomic<unsigned long long> handled{0};
+    };
+
+    std::vector<Worker> workers;
+    const int clients;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping{false};
+
+    static void pin(std::thread& thread, unsigned core) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+        (void)thread;
+        (void)core;
+#endif
+    }
+
+    void send(int client, const Message& message) {
+        SpscQueue<Message>& queue = *workers[owner(message.leg.scheduleId)].inbox[client];
+        while (!queue.push(message)) std::this_thread::yield();
+    }
+
+    static bool wait(Reply& reply) {
+        int state;
+        for (int spins = 0; (state = reply.state.load(std::memory_order_acquire)) == Reply::PENDING; ++spins) {
+            if (spins > 64) std::this_thread::yield();
+        }
+        return state == Reply::DONE;
+    }
+
+    void returnLeg(int client, long long ticket, const Leg& leg) {
+        Reply reply;
+        send(client, {Op::Return, ticket, leg, &reply});
+        wait(reply);
+    }
+
+    void workerLoop(Worker& worker) {
+        int idle = 0;
+        while (true) {
+            bool any = false;
+            Message message;
+            for (auto& queue : worker.inbox) {
+                while (queue->pop(message)) {
+                    handle(worker, message);
+                    any = true;
+                }
+            }
+            if (any) {
+                idle = 0;
+            } else if (stopping.load(std::memory_order_acquire)) {
+                return;
+            } else if (++idle > 64) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    static void handle(Worker& worker, const Message& message) {
+        worker.handled.fetch_add(1, std::memory_order_relaxed);
+        auto departure = worker.departures.find(message.leg.scheduleId);
+        if (departure == worker.departures.end()) {
+            message.reply->state.store(Reply::REFUSED, std::memory_order_release);
+            return;
+        }
+        int& seats = message.leg.ac ? departure->second.ac : departure->second.sleeper;
+        bool done = true;
+        switch (message.op) {
+        case Op::Take:
+            done = seats >= message.leg.seats;
+            if (done) {
+                seats -= message.leg.seats;
+                worker.held[message.ticket].push_back(message.leg);
+            }
+            break;
+        case Op::Return: {
+            done = false;
+            auto ticket = worker.held.find(message.ticket);
+            if (ticket == worker.held.end()) break;
+            auto& legs = ticket->second;
+            for (auto leg = legs.begin(); leg != legs.end(); ++leg) {
+                if (leg->scheduleId == message.leg.scheduleId && leg->ac == message.leg.ac) {
+                    seats += leg->seats;
+                    legs.erase(leg);
+                    done = true;
+                    break;
+                }
+            }
+            if (legs.empty()) worker.held.erase(ticket);
+            break;
+        }
+        case Op::Query:
+            message.reply->value = seats;
+            break;
+        }
+        message.reply->state.store(done ? Reply::DONE : Reply::REFUSED, std::memory_order_release);
+    }
+};
+
+#ifndef _WIN32
+// ===================================================================
+//  LogStorage Class
+//  Booking ledger kept as an append-only log cut into segments of up
+//  to SEGMENT_BYTES. A hash index maps every live ticket to the
+//  segment and offset of its record, and per-schedule posting lists
+//  hold each departure's tickets. Cancelling appends a tombstone;
+//  once more than half of the sealed segments' bytes are dead they
+//  are compacted into one, and a manifest lets a restart finish a
+//  compaction that a crash interrupted. Checkpoints write the index
+//  to a snapshot together with the log position it covers, so a
+//  restart replays only what was appended after it. A torn record at
+//  the end of the log is cut off during replay; damage to a sealed
+//  segment keeps the log from opening.
+//  Trains and departures stay in SQLite. Seats held by the log are
+//  subtracted from the SQLite counters, so a database should take
+//  bookings through one engine at a time.
+// ===================================================================
+class LogStorage : public StorageBackend {
+public:
+    // 'durable' syncs every append to disk, as SQLite does for every commit
+    explicit LogStorage(const std::string& directory, bool durable = true)
+        : directory(directory), durable(durable) {
+        open();
+    }
+
+    ~LogStorage() override {
+        if (!segments.empty()) checkpoint();
+        for (auto& segment : segments) ::close(segment.second.fd);
+    }
+
+    LogStorage(const LogStorage&) = delete;
+    LogStorage& operator=(const LogStorage&) = delete;
+
+    const char* name() const override { return "log"; }
+
+    // False when the directory or a segment could not be opened, or the log is damaged
+    bool isOpen() const { return !segments.empty(); }
+
+    bool addTrain(const Train& train) override { return catalog.addTrain(train); }
+
+    ScheduleStatus scheduleTrain(const std::string& trainNumber, const std::string& date) override {
+        return catalog.scheduleTrain(trainNumber, date);
+    }
+
+    std::vector<std::pair<Schedule, Train>> findSchedules(const std::string& fromDate) override {
+        auto rows = catalog.findSchedules(fromDate);
+        for (auto& row : rows) {
+            departures[row.first.scheduleId] = row;
+            const auto& seats = held[row.first.scheduleId];
+            row.first.acSeatsAvailable -= seats.first;
+            row.first.sleeperSeatsAvailable -= seats.second;
+        }
+        return rows;
+    }
+
+    ReserveStatus reserveSeats(const Booking& booking) override {
+        METRICS_SCOPE("log.reserveSeats");
+        if (segments.empty() || index.count(booking.ticket)) return ReserveStatus::Failed;
+        const auto* dep = departure(booking.scheduleId);
+        if (!dep) return ReserveStatus::NoSuchSchedule;
+        const bool ac = booking.seatClass == "AC";
+        const auto& seats = held[booking.scheduleId];
+        int available = ac ? dep->first.acSeatsAvailable - seats.first : dep->first.sleeperSeatsAvailable - seats.second;
+        if (available < booking.numSeats) return ReserveStatus::NotEnoughSeats;
+
+        Booking stored = booking;
+        if (stored.dateOfBooking.empty()) stored.dateOfBooking = currentTimestamp();
+        std::string record = encodePut(stored);
+        Entry entry;
+        if (!append(record, entry)) return ReserveStatus::Failed;
+        entry.scheduleId = stored.scheduleId;
+        entry.userId = stored.userId;
+        entry.numSeats = stored.numSeats;
+        entry.ac = ac;
+        insert(stored.ticket, entry);
+        if (++appendsSinceCheckpoint >= CHECKPOINT_INTERVAL) checkpoint();
+        return ReserveStatus::Reserved;
+    }
+
+    ReleaseStatus releaseSeats(long long ticket, int userId, Booking& released) override {
+        METRICS_SCOPE("log.releaseSeats");
+        auto it = index.find(ticket);
+        if (it == index.end() || it->second.userId != userId) return ReleaseStatus::NoSuchBooking;
+        Entry tombstone;
+        if (!read(it->second, released) || !append(encodeDelete(ticket), tombstone)) return ReleaseStatus::Failed;
+        erase(ticket);
+        if (++appendsSinceCheckpoint >= CHECKPOINT_INTERVAL) checkpoint();
+        maybeCompact();
+        return ReleaseStatus::Released;
+    }
+
+    bool listBookingsForUser(int userId, std::vector<BookingView>& bookings, std::string& reason) override {
+        METRICS_SCOPE("log.listBookingsForUser");
+        auto user = ticketsByUser.find(userId);
+        if (user == ticketsByUser.end()) return true;
+        for (long long ticket : user->second) {
+            Booking booking;
+            const auto* dep = departure(index[ticket].scheduleId);
+            if (!read(index[ticket], booking) || !dep) {
+                reason = "booking log unreadable";
+                return false;
+            }
+            bookings.push_back({booking, dep->second, dep->first.departureDate});
+        }
+        return true;
+    }
+
+    // Tickets of one departure, in booking order except where cancellations moved the last one up
+    const std::vector<long long>& ticketsForSchedule(int scheduleId) { return postings[scheduleId]; }
+
+    // Rewrites the live records of all sealed segments into one segment
+    bool compact() {
+        METRICS_SCOPE("log.compact");
+        if (segments.size() < 2) return true;
+        const uint32_t target = std::prev(segments.end(), 2)->first; // newest sealed segment keeps its id
+        const std::string temp = segmentPath(target) + ".compact";
+        int fd = ::open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "Log compaction: cannot create " << temp << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        // Live records keep their relative order (the index is unordered, so sort by position);
+        // the new offsets apply once the rename is durable
+        std::vector<std::pair<long long, Entry>> live, moved;
+        for (const auto& item : index) {
+            if (item.second.segment <= target) live.push_back(item);
+        }
+        std::sort(live.begin(), live.end(), [](const std::pair<long long, Entry>& a, const std::pair<long long, Entry>& b) {
+            return std::tie(a.second.segment, a.second.offset) < std::tie(b.second.segment, b.second.offset);
+        });
+        uint64_t size = 0;
+        std::string record;
+        for (const auto& item : live) {
+            const Entry& entry = item.second;
+            if (!readRaw(entry, record) || ::pwrite(fd, record.data(), record.size(), static_cast<off_t>(size)) != static_cast<ssize_t>(record.size())) {
+                ::close(fd);
+                std::remove(temp.c_str());
+                return false;
+            }
+            Entry relocated = entry;
+            relocated.segment = target;
+            relocated.offset = size;
+            moved.emplace_back(item.first, relocated);
+            size += record.size();
+        }
+        sync(fd);
+
+        // The copy holds no tombstones, so the older segments must not outlive the rename: the
+        // manifest lets open() finish deleting them, or drop the copy if the rename never happened
+        std::string manifest(MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+        putValue(manifest, target);
+        putValue(manifest, static_cast<uint64_t>(std::distance(segments.begin(), segments.find(target))));
+        for (auto it = segments.begin(); it->first != target; ++it) putValue(manifest, it->first);
+        if (!writeFile(manifestPath(), manifest)) {
+            ::close(fd);
+            std::remove(temp.c_str());
+            return false;
+        }
+
+        // Offsets in the snapshot are about to go stale; without one, restart replays the log
+        std::remove(snapshotPath().c_str());
+        syncDirectory();
+        if (std::rename(temp.c_str(), segmentPath(target).c_str()) != 0) {
+            ::close(fd);
+            std::remove(temp.c_str());
+            std::remove(manifestPath().c_str());
+            return false;
+        }
+        for (auto it = segments.begin(); it != segments.end() && it->first <= target;) {
+            ::close(it->second.fd);
+            if (it->first != target) std::remove(segmentPath(it->first).c_str());
+            it = segments.erase(it);
+        }
+        syncDirectory();
+        std::remove(manifestPath().c_str());
+        segments[target] = {fd, size, size};
+        for (const auto& item : moved) index[item.first] = item.second;
+        compactions++;
+        checkpoint();
+        return true;
+    }
+
+    // Writes the index and the log position it covers, replacing the previous snapshot
+    bool checkpoint() {
+        METRICS_SCOPE("log.checkpoint");
+        std::string data(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        const auto& active = *segments.rbegin();
+        putValue(data, active.first);
+        putValue(data, active.second.size);
+        putValue(data, static_cast<uint64_t>(index.size()));
+        for (const auto& item : index) {
+            putValue(data, item.first);
+            putValue(data, item.second);
+        }
+        bool ok = writeFile(snapshotPath(), data);
+        appendsSinceCheckpoint = 0;
+        return ok;
+    }
+
+    struct Stats {
+        size_t liveBookings;
+        size_t segments;
+        uint64_t totalBytes, liveBytes;
+        long recordsReplayed, compactions;
+        bool fromSnapshot;
+    };
+
+    Stats stats() const {
+        Stats s{index.size(), segments.size(), 0, 0, recordsReplayed, compactions, fromSnapshot};
+        for (const auto& segment : segments) {
+            s.totalBytes += segment.second.size;
+            s.liveBytes += segment.second.liveBytes;
+        }
+        return s;
+    }
+
+private:
+    static constexpr uint64_t SEGMENT_BYTES = 4 << 20;
+    static constexpr int CHECKPOINT_INTERVAL = 10000; // appends between automatic checkpoints
+    static constexpr char SNAPSHOT_MAGIC[8] = {'R', 'W', 'L', 'O', 'G', 'I', 'X', '1'};
+    static constexpr char MANIFEST_MAGIC[8] = {'R', 'W', 'L', 'O', 'G', 'C', 'M', '1'};
+    static constexpr uint8_t RECORD_PUT = 1, RECORD_DELETE = 2;
+    static constexpr size_t HEADER_BYTES = 8; // uint32 payload length + uint32 checksum
+
+    struct Segment {
+        int fd;
+        uint64_t size;
+        uint64_t liveBytes; // bytes of records the index still points at
+    };
+
+    // Fixed layout, written to the snapshot as is
+    struct Entry {
+        uint32_t segment = 0;
+        uint32_t length = 0;
+        uint64_t offset = 0;
+        int scheduleId = 0, userId = 0, numSeats = 0;
+        bool ac = false;
+    };
+
+    std::string directory;
+    bool durable;
+    SqliteStorage catalog;
+    std::map<uint32_t, Segment> segments; // the last one takes appends
+    std::unordered_map<long long, Entry> index;
+    std::unordered_map<int, std::vector<long long>> postings;
+    std::unordered_map<int, std::vector<long long>> ticketsByUser;
+    std::unordered_map<int, std::pair<int, int>> held; // schedule -> (AC, Sleeper) seats booked in the log
+    std::unordered_map<int, std::pair<Schedule, Train>> departures; // SQLite rows, counters without log bookings
+    int appendsSinceCheckpoint = 0;
+    long recordsReplayed = 0, compactions = 0;
+    bool fromSnapshot = false;
+
+    std::string segmentPath(uint32_t id) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/segment-%06u.log", id);
+        return directory + name;
+    }
+
+    std::string snapshotPath() const { return directory + "/index.snapshot"; }
+
+    std::string manifestPath() const { return directory + "/compaction.manifest"; }
+
+    static uint32_t checksum(const char* data, size_t size) {
+        uint32_t hash = 2166136261u; // FNV-1a
+        for (size_t i = 0; i < size; ++i) hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+        return hash;
+    }
+
+    template <typename T>
+    static void putValue(std::string& out, const T& value) { out.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+
+    template <typename T>
+    static bool getValue(const std::string& in, size_t& pos, T& value) {
+        if (pos + sizeof(T) > in.size()) return false;
+        std::memcpy(&value, in.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    static std::string frame(const std::string& payload) {
+        std::string record;
+        putValue(record, static_cast<uint32_t>(payload.size()));
+        putValue(record, checksum(payload.data(), payload.size()));
+        return record + payload;
+    }
+
+    static std::string encodePut(const Booking& booking) {
+        std::string payload;
+        putValue(payload, RECORD_PUT);
+        putValue(payload, booking.ticket);
+        putValue(payload, booking.scheduleId);
+        putValue(payload, booking.userId);
+        putValue(payload, booking.numSeats);
+        putValue(payload, static_cast<uint8_t>(booking.seatClass == "AC"));
+        putValue(payload, booking.totalFare);
+        putValue(payload, static_cast<uint16_t>(booking.dateOfBooking.size()));
+        payload += booking.dateOfBooking;
+        return frame(payload);
+    }
+
+    static std::string encodeDelete(long long ticket) {
+        std::string payload;
+        putValue(payload, RECORD_DELETE);
+        putValue(payload, ticket);
+        return frame(payload);
+    }
+
+    // Decodes a payload; 'type' tells a booking from a tombstone (which sets only the ticket)
+    static bool decode(const std::string& payload, uint8_t& type, Booking& booking) {
+        size_t pos = 0;
+        if (!getValue(payload, pos, type) || !getValue(payload, pos, booking.ticket)) return false;
+        if (type == RECORD_DELETE) return pos == payload.size();
+        uint8_t ac = 0;
+        uint16_t dateLength = 0;
+        if (type != RECORD_PUT || !getValue(payload, pos, booking.scheduleId) || !getValue(payload, pos, booking.userId) ||
+            !getValue(payload, pos, booking.numSeats) || !getValue(payload, pos, ac) || !getValue(payload, pos, booking.totalFare) ||
+            !getValue(payload, pos, dateLength) || pos + dateLength != payload.size()) {
+            return false;
+        }
+        booking.seatClass = ac ? "AC" : "Sleeper";
+        booking.dateOfBooking = payload.substr(pos);
+        return true;
+    }
+
+    static std::string currentTimestamp() {
+        std::time_t now = std::time(nullptr);
+        char buf[32];
+        std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", std::gmtime(&now)); // as CURRENT_TIMESTAMP
+        return buf;
+    }
+
+    void sync(int fd) const {
+        if (!durable) return;
+#ifdef __linux__
+        ::fdatasync(fd);
+#else
+        ::fsync(fd);
+#endif
+    }
+
+    void syncDirectory() const {
+        if (!durable) return;
+        int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0) return;
+        ::fsync(fd);
+        ::close(fd);
+    }
+
+    // Replaces 'path' with 'data' plus a checksum, through a temporary file and a rename
+    bool writeFile(const std::string& path, std::string data) const {
+        putValue(data, checksum(data.data(), data.size()));
+        const std::string temp = path + ".tmp";
+        int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool ok = fd >= 0 && ::write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+        if (fd >= 0) {
+            sync(fd);
+            ::close(fd);
+        }
+        ok = ok && std::rename(temp.c_str(), path.c_str()) == 0;
+        if (!ok) {
+            std::cerr << "Cannot write " << path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        syncDirectory();
+        return true;
+    }
+
+    // Reads a file written by writeFile(); false if it is missing, torn or of another kind
+    static bool readFile(const std::string& path, const char (&magic)[8], std::string& data) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        uint32_t sum = 0;
+        size_t pos = data.size() < sizeof(sum) ? 0 : data.size() - sizeof(sum);
+        if (pos < sizeof(magic) || !getValue(data, pos, sum) || sum != checksum(data.data(), data.size() - sizeof(sum)) ||
+            data.compare(0, sizeof(magic), magic, sizeof(magic)) != 0) {
+            return false;
+        }
+        data.resize(data.size() - sizeof(sum));
+        return true;
+    }
+
+    bool openSegment(uint32_t id) {
+        int fd = ::open(segmentPath(id).c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            std::cerr << "Cannot open " << segmentPath(id) << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        off_t size = ::lseek(fd, 0, SEEK_END);
+        segments[id] = {fd, static_cast<uint64_t>(size < 0 ? 0 : size), 0};
+        return true;
+    }
+
+    // Appends a framed record to the active segment, rolling to a new one when it is full
+    bool append(const std::string& record, Entry& entry) {
+        if (segments.rbegin()->second.size + record.size() > SEGMENT_BYTES && segments.rbegin()->second.size > 0) {
+            if (!openSegment(segments.rbegin()->first + 1)) return false;
+        }
+        auto& active = *segments.rbegin();
+        if (::pwrite(active.second.fd, record.data(), record.size(), static_cast<off_t>(active.second.size)) != static_cast<ssize_t>(record.size())) {
+            std::cerr << "Booking log write failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        sync(active.second.fd);
+        entry.segment = active.first;
+        entry.offset = active.second.size;
+        entry.length = static_cast<uint32_t>(record.size());
+        active.second.size += record.size();
+        return true;
+    }
+
+    bool readRaw(const Entry& entry, std::string& record) const {
+        auto segment = segments.find(entry.segment);
+        if (segment == segments.end()) return false;
+        record.resize(entry.length);
+        return ::pread(segment->second.fd, &record[0], entry.length, static_cast<off_t>(entry.offset)) == static_cast<ssize_t>(entry.length);
+    }
+
+    bool read(const Entry& entry, Booking& booking) const {
+        std::string record;
+        uint32_t length = 0, sum = 0;
+        uint8_t type = 0;
+        size_t pos = 0;
+        if (!readRaw(entry, record) || !getValue(record, pos, length) || !getValue(record, pos, sum)) return false;
+        std::string payload = record.substr(HEADER_BYTES);
+        return length == payload.size() && sum == checksum(payload.data(), payload.size()) &&
+               decode(payload, type, booking) && type == RECORD_PUT;
+    }
+
+    void insert(long long ticket, const Entry& entry) {
+        if (index.count(ticket)) erase(ticket); // replaying a record that compaction already copied
+        index[ticket] = entry;
+        segments[entry.segment].liveBytes += entry.length;
+        postings[entry.scheduleId].push_back(ticket);
+        ticketsByUser[entry.userId].push_back(ticket);
+        auto& seats = held[entry.scheduleId];
+        (entry.ac ? seats.first : seats.second) += entry.numSeats;
+    }
+
+    static void removeTicket(std::vector<long long>& tickets, long long ticket) {
+        auto it = std::find(tickets.begin(), tickets.end(), ticket);
+        if (it == tickets.end()) return;
+        *it = tickets.back();
+        tickets.pop_back();
+    }
+
+    void erase(long long ticket) {
+        auto it = index.find(ticket);
+        if (it == index.end()) return;
+        const Entry& entry = it->second;
+        auto segment = segments.find(entry.segment);
+        if (segment != segments.end()) segment->second.liveBytes -= entry.length;
+        removeTicket(postings[entry.scheduleId], ticket);
+        removeTicket(ticketsByUser[entry.userId], ticket);
+        auto& seats = held[entry.scheduleId];
+        (entry.ac ? seats.first : seats.second) -= entry.numSeats;
+        index.erase(it);
+    }
+
+    // The SQLite row of a departure, fetched once
+    const std::pair<Schedule, Train>* departure(int scheduleId) {
+        auto it = departures.find(scheduleId);
+        if (it != departures.end()) return &it->second;
+        PreparedStatement stmt = DatabaseManager::getInstance().prepare(
+            "SELECT " + Schema::columnList<Schema::Schedules>("s") + ", " + Schema::columnList<Schema::Trains>("t") +
+            " FROM schedules s JOIN trains t ON s.train_id = t.train_id WHERE s.schedule_id = ?;");
+        stmt.bind(1, scheduleId);
+        if (stmt.step() != SQLITE_ROW) return nullptr;
+        auto& row = departures[scheduleId];
+        row = {Schema::readRow<Schema::Schedules>(stmt), Schema::readRow<Schema::Trains>(stmt, Schema::columnCount<Schema::Schedules>())};
+        return &row;
+    }
+
+    void maybeCompact() {
+        uint64_t sealed = 0, live = 0;
+        for (auto it = segments.begin(); it != std::prev(segments.end()); ++it) {
+            sealed += it->second.size;
+            live += it->second.liveBytes;
+        }
+        if (sealed >= SEGMENT_BYTES / 2 && live * 2 < sealed) compact();
+    }
+
+    bool loadSnapshot(uint32_t& segment, uint64_t& offset) {
+        std::string data;
+        if (!readFile(snapshotPath(), SNAPSHOT_MAGIC, data)) return false;
+        size_t pos = sizeof(SNAPSHOT_MAGIC);
+        uint64_t count = 0;
+        if (!getValue(data, pos, segment) || !getValue(data, pos, offset) || !getValue(data, pos, count)) return false;
+        auto covered = segments.find(segment);
+        if (covered == segments.end() || covered->second.size < offset) return false;
+        for (uint64_t i = 0; i < count; ++i) {
+            long long ticket = 0;
+            Entry entry;
+            if (!getValue(data, pos, ticket) || !getValue(data, pos, entry) || !segments.count(entry.segment)) return false;
+            insert(ticket, entry);
+        }
+        return true;
+    }
+
+    // Applies the records from 'offset' in 'segment' onwards and cuts off a torn tail of the
+    // active segment; false if a sealed segment is damaged, as its records were once complete
+    bool replay(uint32_t fromSegment, uint64_t fromOffset) {
+        for (auto& item : segments) {
+            if (item.first < fromSegment) continue;
+            Segment& segment = item.second;
+            uint64_t offset = item.first == fromSegment ? fromOffset : 0;
+            while (offset + HEADER_BYTES <= segment.size) {
+                char header[HEADER_BYTES];
+                uint32_t length = 0, sum = 0;
+                if (::pread(segment.fd, header, HEADER_BYTES, static_cast<off_t>(offset)) != static_cast<ssize_t>(HEADER_BYTES)) break;
+                std::memcpy(&length, header, sizeof(length));
+                std::memcpy(&sum, header + sizeof(length), sizeof(sum));
+                if (offset + HEADER_BYTES + length > segment.size) break;
+                std::string payload(length, '\0');
+                uint8_t type = 0;
+                Booking booking;
+                if (::pread(segment.fd, &payload[0], length, static_cast<off_t>(offset + HEADER_BYTES)) != static_cast<ssize_t>(length) ||
+                    sum != checksum(payload.data(), length) || !decode(payload, type, booking)) {
+                    break;
+                }
+                if (type == RECORD_PUT) {
+                    Entry entry;
+                    entry.segment = item.first;
+                    entry.offset = offset;
+                    entry.length = static_cast<uint32_t>(HEADER_BYTES + length);
+                    entry.scheduleId = booking.scheduleId;
+                    entry.userId = booking.userId;
+                    entry.numSeats = booking.numSeats;
+                    entry.ac = booking.seatClass == "AC";
+                    insert(booking.ticket, entry);
+                } else {
+                    erase(booking.ticket);
+                }
+                offset += HEADER_BYTES + length;
+                recordsReplayed++;
+            }
+            if (offset < segment.size && item.first != segments.rbegin()->first) {
+                std::cerr << "Booking log: " << segmentPath(item.first) << " is damaged at offset " << offset
+                          << "; not opening the log" << std::endl;
+                return false;
+            }
+            if (offset < segment.size) {
+                std::cerr << "Booking log: discarding " << (segment.size - offset) << " unreadable bytes at the end of "
+                          << segmentPath(item.first) << std::endl;
+                if (::ftruncate(segment.fd, static_cast<off_t>(offset)) == 0) segment.size = offset;
+            }
+        }
+        return true;
+    }
+
+    // Completes a compaction a crash interrupted: deletes the segments it replaced once the copy
+    // has been renamed over the target, or drops the copy if it has not
+    bool recoverCompaction() {
+        if (::access(manifestPath().c_str(), F_OK) != 0) return true;
+        std::string data;
+        size_t pos = sizeof(MANIFEST_MAGIC);
+        uint32_t target = 0;
+        uint64_t count = 0;
+        std::vector<uint32_t> replaced;
+        bool ok = readFile(manifestPath(), MANIFEST_MAGIC, data) && getValue(data, pos, target) && getValue(data, pos, count);
+        for (uint64_t i = 0; ok && i < count; ++i) {
+            uint32_t id = 0;
+            ok = getValue(data, pos, id);
+            replaced.push_back(id);
+        }
+        if (!ok) {
+            std::cerr << "Booking log: " << manifestPath() << " is unreadable; not opening the log" << std::endl;
+            return false;
+        }
+        const std::string temp = segmentPath(target) + ".compact";
+        if (::access(temp.c_str(), F_OK) == 0) {
+            std::remove(temp.c_str());
+        } else {
+            for (uint32_t id : replaced) std::remove(segmentPath(id).c_str());
+        }
+        syncDirectory();
+        std::remove(manifestPath().c_str());
+        return true;
+    }
+
+    void open() {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (!recoverCompaction()) return;
+        std::vector<uint32_t> ids;
+        for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+            unsigned id = 0;
+            char tail = 0;
+            if (std::sscanf(file.path().filename().c_str(), "segment-%u.lo%c", &id, &tail) == 2 && tail == 'g' &&
+                file.path().extension() == ".log") {
+                ids.push_back(id);
+            }
+        }
+        if (error) {
+            std::cerr << "Cannot use booking log directory " << directory << ": " << error.message() << std::endl;
+            return;
+        }
+        if (ids.empty()) ids.push_back(1);
+        for (uint32_t id : ids) {
+            if (!openSegment(id)) {
+                for (auto& segment : segments) ::close(segment.second.fd);
+                segments.clear();
+                return;
+            }
+        }
+
+        uint32_t segment = segments.begin()->first;
+        uint64_t offset = 0;
+        fromSnapshot = loadSnapshot(segment, offset);
+        if (!fromSnapshot) {
+            index.clear();
+            postings.clear();
+            ticketsByUser.clear();
+            held.clear();
+            for (auto& item : segments) item.second.liveBytes = 0;
+            segment = segments.begin()->first;
+            offset = 0;
+        }
+        if (!replay(segment, offset)) {
+            for (auto& item : segments) ::close(item.second.fd);
+            segments.clear();
+            index.clear();
+            postings.clear();
+            ticketsByUser.clear();
+            held.clear();
+        }
+    }
+};
+#endif
+
+// Backend by name ("sqlite", "memory" or "log"); null for an unknown name.
+// The log engine keeps its segments in a directory next to the database.
+std::unique_ptr<StorageBackend> createStorage(const std::string& name) {
+    if (name == "sqlite") return std::make_unique<SqliteStorage>();
+    if (name == "memory") return std::make_unique<MemoryStorage>();
+#ifndef _WIN32
+    if (name == "log") return std::make_unique<LogStorage>(std::string(DatabaseManager::databasePath()) + ".bookings");
+#endif
+    return nullptr;
+}
+
+// ===================================================================
+//  StorageBenchmark Class
+//  Drives a backend with a seeded booking workload (departure
+//  listings, reservations, per-user listings and cancellations) and
+//  reports the mean latency of each operation.
+// ===================================================================
+class StorageBenchmark {
+public:
+    struct Timing {
+        const char* operation;
+        long count = 0;
+        double totalMicros = 0;
+    };
+
+    std::vector<Timing> run(StorageBackend& storage, int bookings, unsigned seed = 42) {
+        std::vector<Timing> timings = {{"addTrain"}, {"scheduleTrain"}, {"findSchedules"}, {"reserveSeats"},
+                                       {"listBookingsForUser"}, {"releaseSeats"}};
+        std::mt19937 rng(seed);
+        const std::string prefix = "BENCH" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count() % 100000) + "-";
+        const long today = TimeUtil::today();
+
+        std::vector<std::string> trainNumbers;
+        for (int i = 0; i < TRAINS; ++i) {
+            Train t;
+            t.number = prefix + std::to_string(i);
+            t.name = "Benchmark Express " + std::to_string(i);
+            t.source = "Bench " + std::to_string(i % 10);
+            t.destination = "Bench " + std::to_string(10 + i % 10);
+            t.departureTime = "08:00";
+            t.journeyDuration = "06:00";
+            t.totalAcSeats = 200;
+            t.totalSleeperSeats = 600;
+            t.acFare = 1500;
+            t.sleeperFare = 500;
+            timed(timings[0], [&] { storage.addTrain(t); });
+            trainNumbers.push_back(t.number);
+        }
+        for (int day = 1; day <= DAYS; ++day) {
+            for (const auto& number : trainNumbers) {
+                timed(timings[1], [&] { storage.scheduleTrain(number, TimeUtil::formatDate(today + day)); });
+            }
+        }
+
+        std::vector<int> departures;
+        timed(timings[2], [&] {
+            for (const auto& row : storage.findSchedules(TimeUtil::formatDate(today + 1))) {
+                if (row.second.number.compare(0, prefix.size(), prefix) == 0) departures.push_back(row.first.scheduleId);
+            }
+        });
+        if (departures.empty()) return timings;
+
+        std::vector<std::pair<long long, int>> made; // (ticket, user)
+        long long nextTicket = 900000000000LL + rng() % 1000000 * 1000;
+        for (int i = 0; i < bookings; ++i) {
+            Booking booking;
+            booking.scheduleId = departures[rng() % departures.size()];
+            booking.ticket = nextTicket++;
+            booking.userId = 1000000 + static_cast<int>(rng() % USERS);
+            booking.seatClass = rng() % 4 == 0 ? "AC" : "Sleeper";
+            booking.numSeats = 1 + static_cast<int>(rng() % 4);
+            booking.totalFare = booking.numSeats * (booking.seatClass == "AC" ? 1500.0 : 500.0);
+            StorageBackend::ReserveStatus status;
+            timed(timings[3], [&] { status = storage.reserveSeats(booking); });
+            if (status == StorageBackend::ReserveStatus::Reserved) made.emplace_back(booking.ticket, booking.userId);
+        }
+
+        std::vector<StorageBackend::BookingView> views;
+        std::string reason;
+        for (int i = 0; i < USERS; ++i) {
+            views.clear();
+            timed(timings[4], [&] { storage.listBookingsForUser(1000000 + i, views, reason); });
+        }
+
+        std::shuffle(made.begin(), made.end(), rng);
+        Booking released;
+        for (const auto& booking : made) {
+            timed(timings[5], [&] { storage.releaseSeats(booking.first, booking.second, released); });
+        }
+        return timings;
+    }
+
+    static void print(const char* backend, const std::vector<Timing>& timings) {
+        const int W_OP = 22, W_COUNT = 10, W_MEAN = 14;
+        std::cout << "Backend: " << backend << "\n";
+        std::cout << std::left << std::setw(W_OP) << "Operation" << std::right << std::setw(W_COUNT) << "Calls"
+                  << std::setw(W_MEAN) << "Mean us" << "\n";
+        std::cout << std::string(W_OP + W_COUNT + W_MEAN, '-') << "\n";
+        for (const auto& t : timings) {
+            std::cout << std::left << std::setw(W_OP) << t.operation << std::right << std::setw(W_COUNT) << t.count
+                      << std::setw(W_MEAN) << std::fixed << std::setprecision(2) << (t.count ? t.totalMicros / t.count : 0.0) << "\n";
+        }
+    }
+
+private:
+    static const int TRAINS = 50;
+    static const int DAYS = 30;
+    static const int USERS = 500;
+
+    template <typename Operation>
+    static void timed(Timing& timing, Operation operation) {
+        auto start = std::chrono::steady_clock::now();
+        operation();
+        timing.totalMicros += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        timing.count++;
+    }
+};
+
+// ===================================================================
+//  EscrowBenchmark Class
+//  Sells out one large departure (a festival special) from several
+//  threads through MemoryStorage, once with the plain shared counter
+//  and once with the departure marked hot. It then cancels every
+//  tenth booking and sells the returned seats again. Each run checks
+//  that exactly the train's seats were sold.
+// ===================================================================
+class EscrowBenchmark {
+public:
+    struct Result {
+        const char* mode;
+        long long bookings = 0, seatsSold = 0, leftOver = 0;
+        unsigned long long rebalances = 0;
+        double seconds = 0;
+        bool exact = false;
+    };
+
+    Result run(bool escrow, int seats, int threads) {
+        Result result;
+        result.mode = escrow ? "escrow" : "shared";
+        MemoryStorage storage;
+        Train special;
+        special.number = "FEST-1";
+        special.name = "Festival Special";
+        special.source = "Festival Junction";
+        special.destination = "Festival Grounds";
+        special.departureTime = "06:00";
+        special.journeyDuration = "04:00";
+        special.totalSleeperSeats = seats;
+        special.sleeperFare = 300;
+        storage.addTrain(special);
+        storage.scheduleTrain(special.number, TimeUtil::formatDate(TimeUtil::today() + 1));
+        if (escrow) storage.markHot(1, "Sleeper", threads);
+
+        std::vector<std::vector<Booking>> sold(threads);
+        auto started = std::chrono::steady_clock::now();
+        sellOut(storage, threads, sold, 0);
+
+        // Every tenth booking is cancelled on the thread that made it; those seats are sold again
+        std::vector<std::thread> cancellers;
+        std::atomic<long long> cancelled{0};
+        for (int t = 0; t < threads; ++t) {
+            cancellers.emplace_back([&, t] {
+                std::vector<Booking> kept;
+                Booking released;
+                for (size_t i = 0; i < sold[t].size(); ++i) {
+                    if (i % 10 == 0 && storage.releaseSeats(sold[t][i].ticket, sold[t][i].userId, released) == StorageBackend::ReleaseStatus::Released) {
+                        cancelled += released.numSeats;
+                    } else {
+                        kept.push_back(sold[t][i]);
+                    }
+                }
+                sold[t].swap(kept);
+            });
+        }
+        for (auto& thread : cancellers) thread.join();
+        sellOut(storage, threads, sold, 1);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        for (const auto& perThread : sold) {
+            result.bookings += static_cast<long long>(perThread.size());
+            for (const auto& booking : perThread) result.seatsSold += booking.numSeats;
+        }
+        result.leftOver = storage.findSchedules("")[0].first.sleeperSeatsAvailable;
+        result.rebalances = storage.rebalances(1, "Sleeper");
+        result.exact = result.seatsSold == seats && result.leftOver == 0 && cancelled > 0;
+        return result;
+    }
+
+    static void print(const std::vector<Result>& results, int seats, int threads) {
+        std::cout << "Festival special: " << seats << " Sleeper seats, " << threads << " selling threads\n";
+        const int W_MODE = 8, W_BOOKINGS = 10, W_SEC = 9, W_RATE = 14, W_REBAL = 11, W_CHECK = 30;
+        std::cout << std::left << std::setw(W_MODE) << "Counter" << std::right << std::setw(W_BOOKINGS) << "Bookings"
+                  << std::setw(W_SEC) << "Seconds" << std::setw(W_RATE) << "Bookings/s" << std::setw(W_REBAL) << "Rebalances"
+                  << "  " << std::left << std::setw(W_CHECK) << "Check" << "\n";
+        std::cout << std::string(W_MODE + W_BOOKINGS + W_SEC + W_RATE + W_REBAL + W_CHECK + 2, '-') << "\n";
+        for (const auto& r : results) {
+            std::string check = r.exact ? "exact: " + std::to_string(r.seatsSold) + " sold, 0 left"
+                                        : "MISMATCH: " + std::to_string(r.seatsSold) + " sold, " + std::to_string(r.leftOver) + " left";
+            std::cout << std::left << std::setw(W_MODE) << r.mode << std::right << std::setw(W_BOOKINGS) << r.bookings
+                      << std::setw(W_SEC) << std::fixed << std::setprecision(3) << r.seconds
+                      << std::setw(W_RATE) << std::setprecision(0) << (r.seconds > 0 ? r.bookings / r.seconds : 0.0)
+                      << std::setw(W_REBAL) << r.rebalances << "  " << std::left << std::setw(W_CHECK) << check << "\n";
+        }
+    }
+
+private:
+    // Each thread books 1-4 seats at a time, asking for fewer when a request fails, until one seat is refused
+    static void sellOut(MemoryStorage& storage, int threads, std::vector<std::vector<Booking>>& sold, int round) {
+        std::vector<std::thread> sellers;
+        for (int t = 0; t < threads; ++t) {
+            sellers.emplace_back([&storage, &sold, t, round] {
+                std::mt19937 rng(1000 * round + t);
+                Booking booking;
+                booking.scheduleId = 1;
+                booking.seatClass = "Sleeper";
+                long long next = (static_cast<long long>(round) * 1000 + t) * 100000000LL;
+                int wanted = 1 + static_cast<int>(rng() % 4);
+                while (true) {
+                    booking.ticket = ++next;
+                    booking.userId = static_cast<int>(rng() % 100000);
+                    booking.numSeats = wanted;
+                    booking.totalFare = wanted * 300.0;
+                    if (storage.reserveSeats(booking) == StorageBackend::ReserveStatus::Reserved) {
+                        sold[t].push_back(booking);
+                        wanted = 1 + static_cast<int>(rng() % 4);
+                    } else if (wanted > 1) {
+                        wanted--;
+                    } else {
+                        break;
+                    }
+                }
+            });
+        }
+        for (auto& thread : sellers) thread.join();
+    }
+};
+
+// ===================================================================
+//  PartitionBenchmark Class
+//  Runs the same booking mix (single departures, a tenth spanning two
+//  departures, every fifth booking cancelled) from several client
+//  threads. It runs once against MemoryStorage's shared counters and
+//  then against PartitionedInventory with 1, 2, 4 ... workers. After
+//  each run it checks that the seats left plus the seats still booked
+//  add up to the seats scheduled.
+// ===================================================================
+class PartitionBenchmark {
+public:
+    struct Result {
+        std::string engine;
+        int workers = 0;
+        long long bookings = 0;
+        double seconds = 0, crossWorker = 0;
+        bool conserved = false;
+    };
+
+    Result runShared(int clients, int operations) {
+        Result result;
+        result.engine = "shared";
+        result.workers = clients;
+        MemoryStorage storage;
+        for (int t = 0; t < TRAINS; ++t) {
+            Train train;
+            train.number = "PART-" + std::to_string(t);
+            train.name = "Partition Express " + std::to_string(t);
+            train.source = "Part " + std::to_string(t % 10);
+            train.destination = "Part " + std::to_string(10 + t % 10);
+            train.departureTime = "07:00";
+            train.journeyDuration = "05:00";
+            train.totalAcSeats = AC_SEATS;
+            train.totalSleeperSeats = SLEEPER_SEATS;
+            storage.addTrain(train);
+        }
+        const long today = TimeUtil::today();
+        for (int day = 1; day <= DAYS; ++day) {
+            for (int t = 0; t < TRAINS; ++t) storage.scheduleTrain("PART-" + std::to_string(t), TimeUtil::formatDate(today + day));
+        }
+
+        std::vector<long long> seatsHeld(clients, 0), made(clients, 0);
+        auto started = std::chrono::steady_clock::now();
+        runClients(clients, operations, [&](int client, long long ticket, const std::vector<PartitionedInventory::Leg>& legs, bool cancelLater) {
+            // The shared engine has no multi-leg booking: take each leg as its own booking and undo on failure
+            size_t taken = 0;
+            Booking booking;
+            booking.userId = static_cast<int>(ticket % USERS);
+            for (; taken < legs.size(); ++taken) {
+                booking.ticket = ticket * 2 + static_cast<long long>(taken);
+                booking.scheduleId = legs[taken].scheduleId;
+                booking.seatClass = legs[taken].ac ? "AC" : "Sleeper";
+                booking.numSeats = legs[taken].seats;
+                if (storage.reserveSeats(booking) != StorageBackend::ReserveStatus::Reserved) break;
+            }
+            Booking released;
+            if (taken < legs.size() || cancelLater) {
+                for (size_t i = 0; i < taken; ++i) storage.releaseSeats(ticket * 2 + static_cast<long long>(i), booking.userId, released);
+            }
+            if (taken < legs.size()) return;
+            made[client]++;
+            if (!cancelLater) {
+                for (const auto& leg : legs) seatsHeld[client] += leg.seats;
+            }
+        });
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        long long left = 0;
+        for (const auto& row : storage.findSchedules("")) left += row.first.acSeatsAvailable + row.first.sleeperSeatsAvailable;
+        return finish(result, made, seatsHeld, left);
+    }
+
+    Result runPartitioned(int workers, int clients, int operations) {
+        Result result;
+        result.engine = "partitioned";
+        result.workers = workers;
+        PartitionedInventory inventory(workers, clients);
+        for (int id = 1; id <= TRAINS * DAYS; ++id) inventory.addDeparture(id, AC_SEATS, SLEEPER_SEATS);
+        inventory.start();
+
+        std::vector<long long> seatsHeld(clients, 0), made(clients, 0), legsSent(clients, 0), crossLegs(clients, 0);
+        auto started = std::chrono::steady_clock::now();
+        runClients(clients, operations, [&](int client, long long ticket, const std::vector<PartitionedInventory::Leg>& legs, bool cancelLater) {
+            legsSent[client] += static_cast<long long>(legs.size());
+            if (legs.size() > 1 && inventory.owner(legs[0].scheduleId) != inventory.owner(legs[1].scheduleId)) crossLegs[client] += 2;
+            if (!inventory.book(client, ticket, legs)) return;
+            made[client]++;
+            if (cancelLater) {
+                inventory.cancel(client, ticket, legs);
+            } else {
+                for (const auto& leg : legs) seatsHeld[client] += leg.seats;
+            }
+        });
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        long long left = 0;
+        for (int id = 1; id <= TRAINS * DAYS; ++id) left += inventory.available(0, id, true) + inventory.available(0, id, false);
+        inventory.stop();
+        long long sent = 0, cross = 0;
+        for (int c = 0; c < clients; ++c) {
+            sent += legsSent[c];
+            cross += crossLegs[c];
+        }
+        result.crossWorker = sent ? 100.0 * cross / sent : 0;
+        return finish(result, made, seatsHeld, left);
+    }
+
+    static void print(const std::vector<Result>& results) {
+        const int W_ENGINE = 12, W_WORKERS = 8, W_BOOKINGS = 10, W_SEC = 9, W_RATE = 12, W_SPEEDUP = 9, W_CROSS = 8, W_CHECK = 10;
+        std::cout << TRAINS * DAYS << " departures, " << results.front().workers << " client threads; "
+                  << std::max(1u, std::thread::hardware_concurrency()) << " cores\n";
+        std::cout << std::left << std::setw(W_ENGINE) << "Engine" << std::right << std::setw(W_WORKERS) << "Workers"
+                  << std::setw(W_BOOKINGS) << "Bookings" << std::setw(W_SEC) << "Seconds" << std::setw(W_RATE) << "Bookings/s"
+                  << std::setw(W_SPEEDUP) << "Speedup" << std::setw(W_CROSS) << "Cross%" << "  " << std::left << std::setw(W_CHECK) << "Seats" << "\n";
+        std::cout << std::string(W_ENGINE + W_WORKERS + W_BOOKINGS + W_SEC + W_RATE + W_SPEEDUP + W_CROSS + W_CHECK + 2, '-') << "\n";
+        double base = 0;
+        for (const auto& r : results) {
+            double rate = r.seconds > 0 ? r.bookings / r.seconds : 0.0;
+            if (r.engine == "partitioned" && base == 0) base = rate;
+            std::cout << std::left << std::setw(W_ENGINE) << r.engine << std::right << std::setw(W_WORKERS) << r.workers
+                      << std::setw(W_BOOKINGS) << r.bookings << std::setw(W_SEC) << std::fixed << std::setprecision(3) << r.seconds
+                      << std::setw(W_RATE) << std::setprecision(0) << rate;
+            if (r.engine == "partitioned" && base > 0) {
+                std::cout << std::setw(W_SPEEDUP - 1) << std::setprecision(2) << rate / base << "x"
+                          << std::setw(W_CROSS) << std::setprecision(1) << r.crossWorker;
+            } else {
+                std::cout << std::setw(W_SPEEDUP) << "-" << std::setw(W_CROSS) << "-";
+            }
+            std::cout << "  " << std::left << std::setw(W_CHECK) << (r.conserved ? "conserved" : "MISMATCH") << "\n";
+        }
+    }
+
+private:
+    static const int TRAINS = 50;
+    static const int DAYS = 20;
+    static const int AC_SEATS = 200;
+    static const int SLEEPER_SEATS = 600;
+    static const int USERS = 10000;
+
+    using Step = std::function<void(int, long long, const std::vector<PartitionedInventory::Leg>&, bool)>;
+
+    // Each client draws its own seeded stream of bookings, so every engine sees the same requests
+    static void runClients(int clients, int operations, const Step& step) {
+        std::vector<std::thread> threads;
+        for (int c = 0; c < clients; ++c) {
+            threads.emplace_back([c, clients, operations, &step] {
+                std::mt19937 rng(7000 + c);
+                std::vector<PartitionedInventory::Leg> legs;
+                const int mine = operations / clients + (c < operations % clients ? 1 : 0);
+                for (int i = 0; i < mine; ++i) {
+                    legs.clear();
+                    const int count = rng() % 10 == 0 ? 2 : 1;
+                    for (int l = 0; l < count; ++l) {
+                        PartitionedInventory::Leg leg;
+                        leg.scheduleId = 1 + static_cast<int>(rng() % (TRAINS * DAYS));
+                        leg.ac = rng() % 4 == 0;
+                        leg.seats = 1 + static_cast<int>(rng() % 4);
+                        legs.push_back(leg);
+                    }
+                    step(c, (static_cast<long long>(c) << 32) + i, legs, i % 5 == 0);
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+    }
+
+    static Result finish(Result result, const std::vector<long long>& made, const std::vector<long long>& seatsHeld, long long left) {
+        long long held = 0;
+        for (size_t c = 0; c < made.size(); ++c) {
+            result.bookings += made[c];
+            held += seatsHeld[c];
+        }
+        result.conserved = left + held == static_cast<long long>(TRAINS) * DAYS * (AC_SEATS + SLEEPER_SEATS);
+        return result;
+    }
+};
+
+// ===================================================================
+//  BulkInserter Class
+//  Buffers rows for one table and writes them through a prepared
+//  multi-row INSERT, ROWS_PER_STATEMENT rows per execution. The
+//  caller owns the surrounding transaction.
+// ===================================================================
+class BulkInserter {
+public:
+    static const int ROWS_PER_STATEMENT = 64;
+
+    struct Value {
+        enum class Kind { Integer, Real, Text } kind;
+        long long integer;
+        double real;
+        const std::string* text; // must outlive the next flush
+
+        Value(int v) : kind(Kind::Integer), integer(v), real(0), text(nullptr) {}
+        Value(long long v) : kind(Kind::Integer), integer(v), real(0), text(nullptr) {}
+        Value(double v) : kind(Kind::Real), integer(0), real(v), text(nullptr) {}
+        Value(const std::string& v) : kind(Kind::Text), integer(0), real(0), text(&v) {}
+    };
+
+    // head is "INSERT INTO table (col, ...)"; each row must supply exactly 'columns' values
+    BulkInserter(const std::string& head, int columns)
+        : head(head), columns(columns), full(DatabaseManager::getInstance().prepare(valuesSql(head, columns, ROWS_PER_STATEMENT))) {
+        pending.reserve(static_cast<size_t>(columns) * ROWS_PER_STATEMENT);
+    }
+
+    bool add(std::initializer_list<Value> row) {
+        pending.insert(pending.end(), row.begin(), row.end());
+        inserted++;
+        return pending.size() < static_cast<size_t>(columns) * ROWS_PER_STATEMENT || flush(full);
+    }
+
+    // Writes any partial block through a statement sized to it
+    bool finish() {
+        if (pending.empty()) return true;
+        PreparedStatement tail = DatabaseManager::getInstance().prepare(
+            valuesSql(head, columns, static_cast<int>(pending.size()) / columns));
+        return flush(tail);
+    }
+
+    long long rows() const { return inserted; }
+
+private:
+    std::string head;
+    int columns;
+    PreparedStatement full;
+    std::vector<Value> pending;
+    long long inserted = 0;
+
+    static std::string valuesSql(const std::string& head, int columns, int rows) {
+        std::string tuple = "(?";
+        for (int c = 1; c < columns; ++c) tuple += ", ?";
+        tuple += ")";
+        std::string sql = head + " VALUES " + tuple;
+        for (int r = 1; r < rows; ++r) sql += ", " + tuple;
+        return sql + ";";
+    }
+
+    bool flush(PreparedStatement& stmt) {
+        if (!stmt.valid()) return false;
+        for (size_t i = 0; i < pending.size(); ++i) {
+            const Value& v = pending[i];
+            int index = static_cast<int>(i) + 1;
+            if (v.kind == Value::Kind::Integer) stmt.bind(index, v.integer);
+            else if (v.kind == Value::Kind::Real) stmt.bind(index, v.real);
+            else stmt.bind(index, *v.text);
+        }
+        pending.clear();
+        return stmt.execute();
+    }
+};
+
+// ===================================================================
+//  DatasetGenerator Class
+//  Fills the database with a synthetic network: stations, trains
+//  with intermediate stops, daily departures, users and bookings.
+//  Train popularity follows a Zipf distribution and all randomness
+//  comes from one seeded engine, so a seed always reproduces the
+//  same data with the same build.
+// ===================================================================
+class DatasetGenerator {
+public:
+    struct Options {
+        unsigned long long seed = 42;
+        int stations = 300;
+        int trains = 1000;
+        int days = 30;
+        std::string startDate;      // first departure date; defaults to 'days / 2' days ago
+        long long users = 10000;
+        long long bookings = 100000;
+        double zipfExponent = 1.0;
+    };
+
+    struct Stats {
+        long long trains = 0, stops = 0, schedules = 0, users = 0, bookings = 0;
+        double seconds = 0;
+    };
+
+    bool run(const Options& options, Stats& stats) {
+        auto started = std::chrono::steady_clock::now();
+        auto& db = DatabaseManager::getInstance();
+        std::mt19937_64 rng(options.seed);
+
+        long firstDay = 0;
+        std::string start = options.startDate;
+        if (start.empty()) start = db.executeQuery("SELECT date('now', '-" + std::to_string(options.days / 2) + " day');")[0][0];
+        if (!TimeUtil::parseDate(start, firstDay) || options.stations < 2 || options.trains < 1 || options.days < 1) {
+            std::cerr << "Invalid generator options." << std::endl;
+            return false;
+        }
+
+        long long trainBase = maxOf("SELECT MAX(train_id) FROM trains;");
+        long long scheduleBase = maxOf("SELECT MAX(schedule_id) FROM schedules;");
+        long long userBase = maxOf("SELECT MAX(user_id) FROM users;");
+        long long ticketBase = std::max(1000000LL, maxOf("SELECT MAX(ticket) FROM bookings;"));
+        std::string prefix = "G" + std::to_string(options.seed % 1000) + "-";
+        if (!db.executeQuery("SELECT 1 FROM trains WHERE train_number LIKE '" + prefix + "%' LIMIT 1;").empty()) {
+            std::cerr << "Trains from seed " << options.seed << " already exist; use another seed." << std::endl;
+            return false;
+        }
+
+        // Bulk-load settings: no fsync, journal in memory, big page cache, indexes rebuilt at the end
+        db.executeUpdate("PRAGMA synchronous = OFF;");
+        db.executeUpdate("PRAGMA journal_mode = MEMORY;");
+        db.executeUpdate("PRAGMA cache_size = -262144;");
+        db.dropBookingIndexes();
+
+        bool ok = db.beginTransaction()
+            && generateNetwork(options, rng, prefix, trainBase, stats)
+            && generateUsers(options, userBase, stats)
+            && db.commit()
+            && generateBookings(options, rng, firstDay, scheduleBase, userBase, ticketBase, stats);
+        if (!ok) db.rollback();
+
+        std::cout << "Rebuilding booking indexes...\n";
+        db.createBookingIndexes();
+        db.executeUpdate("PRAGMA journal_mode = WAL;");
+        db.executeUpdate("PRAGMA synchronous = FULL;");
+        db.executeUpdate("ANALYZE;");
+        AvailabilityCache::getInstance().invalidate();
+        TimetableCatalog::getInstance().invalidate();
+        StationIndex::getInstance().invalidate();
+
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        return ok;
+    }
+
+private:
+    // Commit every this many booking rows so the in-memory journal stays bounded
+    static const long long ROWS_PER_TRANSACTION = 2000000;
+
+    struct GeneratedTrain {
+        long long id;
+        int acSeats, sleeperSeats;
+        double acFare, sleeperFare;
+        double weight; // Zipf popularity
+    };
+
+    std::vector<std::string> stationNames;
+    std::vector<GeneratedTrain> trains;
+
+    long long maxOf(const std::string& sql) {
+        auto rows = DatabaseManager::getInstance().executeQuery(sql);
+        return (rows.empty() || rows[0][0] == "NULL") ? 0 : std::stoll(rows[0][0]);
+    }
+
+    static std::string clock(int minutes) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "%02d:%02d", (minutes / 60) % 100, minutes % 60);
+        return buf;
+    }
+
+    void makeStationNames(int count, std::mt19937_64& rng) {
+        static const char* first[] = {"Ka", "Ra", "Ma", "Su", "Pa", "De", "Ba", "Ha", "Ja", "Na", "Sa", "Vi", "Go", "Ko", "Bi", "Ch"};
+        static const char* middle[] = {"ran", "li", "dha", "mal", "ven", "sun", "gar", "tal", "nan", "rup", "shi", "lo"};
+        static const char* last[] = {"pur", "nagar", "abad", "garh", "ganj", "kot", "wadi", " Junction", " Cantt", " Road", "pet", "ner"};
+        std::set<std::string> used;
+        while (static_cast<int>(stationNames.size()) < count) {
+            std::string name = std::string(first[rng() % 16]) + middle[rng() % 12] + last[rng() % 12];
+            if (!used.insert(name).second) name += " " + std::to_string(stationNames.size());
+            used.insert(name);
+            stationNames.push_back(name);
+        }
+    }
+
+    // Scatters stations over a 24 x 29 degree box. About one in four joins an earlier
+    // station's city, a few km from it. Uses its own engine so the rest of the data
+    // is the same as before stations had positions.
+    bool placeStations(unsigned long long seed) {
+        std::mt19937_64 geo(seed ^ 0x9e3779b97f4a7c15ULL);
+        std::uniform_real_distribution<double> latitude(8.0, 32.0), longitude(68.0, 97.0), jitter(-0.06, 0.06);
+        std::vector<size_t> cityOf;
+        std::vector<std::pair<double, double>> centres;
+        BulkInserter stationInsert("INSERT OR IGNORE INTO stations (name, city, latitude, longitude)", 4);
+        for (size_t i = 0; i < stationNames.size(); ++i) {
+            if (i > 0 && geo() % 4 == 0) {
+                cityOf.push_back(cityOf[geo() % i]);
+            } else {
+                cityOf.push_back(centres.size());
+                centres.emplace_back(latitude(geo), longitude(geo));
+            }
+            const auto& centre = centres[cityOf[i]];
+            if (!stationInsert.add({stationNames[i], stationNames[std::find(cityOf.begin(), cityOf.end(), cityOf[i]) - cityOf.begin()],
+                                    centre.first + jitter(geo), centre.second + jitter(geo)})) {
+                return false;
+            }
+        }
+        return stationInsert.finish();
+    }
+
+    bool generateNetwork(const Options& options, std::mt19937_64& rng, const std::string& prefix, long long trainBase, Stats& stats) {
+        makeStationNames(options.stations, rng);
+        if (!placeStations(options.seed)) return false;
+
+        // Popularity ranks are shuffled so they do not follow train numbers
+        std::vector<int> ranks(options.trains);
+        for (int i = 0; i < options.trains; ++i) ranks[i] = i + 1;
+        std::shuffle(ranks.begin(), ranks.end(), rng);
+
+        BulkInserter trainInsert("INSERT INTO trains (train_id, train_number, train_name, source, destination, departure_time, "
+                                 "journey_duration, total_ac_seats, total_sleeper_seats, ac_fare, sleeper_fare)", 11);
+        BulkInserter stopInsert("INSERT INTO train_stops (train_number, stop_seq, station, arrival_offset, departure_offset)", 5);
+        // Bound strings must outlive the inserters' buffers, and a deque never moves its elements
+        std::deque<std::string> text;
+
+        for (int i = 0; i < options.trains; ++i) {
+            int stopCount = 2 + static_cast<int>(rng() % 7);
+            std::vector<int> route;
+            while (static_cast<int>(route.size()) < stopCount) {
+                int station = static_cast<int>(rng() % stationNames.size());
+                if (std::find(route.begin(), route.end(), station) == route.end()) route.push_back(station);
+            }
+
+            const std::string& number = text.emplace_back(prefix + std::to_string(10000 + i));
+            int arrival = 0, departure = 0;
+            for (int s = 0; s < stopCount; ++s) {
+                if (s > 0) arrival = departure + 30 + static_cast<int>(rng() % 151);
+                departure = (s == 0 || s + 1 == stopCount) ? arrival : arrival + 2 + static_cast<int>(rng() % 9);
+                if (!stopInsert.add({number, s, stationNames[route[s]], arrival, departure})) return false;
+                stats.stops++;
+            }
+
+            GeneratedTrain train;
+            train.id = trainBase + 1 + i;
+            train.acSeats = 50 + 10 * static_cast<int>(rng() % 26);
+            train.sleeperSeats = 200 + 10 * static_cast<int>(rng() % 71);
+            train.acFare = std::round(arrival * 2.5);
+            train.sleeperFare = std::round(arrival * 0.8);
+            train.weight = 1.0 / std::pow(ranks[i], options.zipfExponent);
+            trains.push_back(train);
+
+            const std::string& name = text.emplace_back(stationNames[route.front()] + " " + stationNames[route.back()] + " Express");
+            const std::string& departs = text.emplace_back(clock(5 * static_cast<int>(rng() % 288)));
+            const std::string& duration = text.emplace_back(clock(arrival));
+            if (!trainInsert.add({train.id, number, name, stationNames[route.front()], stationNames[route.back()], departs, duration,
+                                  train.acSeats, train.sleeperSeats, train.acFare, train.sleeperFare})) return false;
+            stats.trains++;
+        }
+        return trainInsert.finish() && stopInsert.finish();
+    }
+
+    bool generateUsers(const Options& options, long long userBase, Stats& stats) {
+        BulkInserter userInsert("INSERT INTO users (user_id, username, password)", 3);
+        static const std::string password = "password";
+        std::deque<std::string> names;
+        for (long long u = 1; u <= options.users; ++u) {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "gen%lld_%08lld", options.seed % 1000, u);
+            if (!userInsert.add({userBase + u, names.emplace_back(buf), password})) return false;
+            // The buffer holds at most one block of rows, so older names can be released
+            if (names.size() > 2 * BulkInserter::ROWS_PER_STATEMENT) names.pop_front();
+            stats.users++;
+        }
+        return userInsert.finish();
+    }
+
+    // Walks departures in schedule_id order and emits their bookings with increasing
+    // tickets, so rows append to the (schedule_id, ticket) clustered key instead of
+    // landing on random pages. Each departure's expected share of the booking total
+    // is proportional to its train's Zipf weight, capped by the seats it has.
+    bool generateBookings(const Options& options, std::mt19937_64& rng, long firstDay, long long scheduleBase,
+                          long long userBase, long long ticketBase, Stats& stats) {
+        auto& db = DatabaseManager::getInstance();
+        double totalWeight = 0;
+        for (const auto& t : trains) totalWeight += t.weight;
+
+        std::vector<std::string> dates, bookedOn;
+        for (int d = 0; d < options.days; ++d) dates.push_back(TimeUtil::formatDate(firstDay + d));
+        for (int d = -60; d < options.days; ++d) bookedOn.push_back(TimeUtil::formatDate(firstDay + d) + " 10:00:00");
+        static const std::string ac = "AC", sleeper = "Sleeper";
+
+        std::uniform_int_distribution<long long> pickUser(1, std::max(1LL, options.users));
+        std::discrete_distribution<int> pickSeats({45, 30, 15, 10}); // 1..4 seats per booking
+        long long ticket = ticketBase;
+        long long scheduleId = scheduleBase;
+        long long sinceCommit = 0;
+
+        if (!db.beginTransaction()) return false;
+        BulkInserter scheduleInsert("INSERT INTO schedules (schedule_id, train_id, departure_date, "
+                                    "ac_seats_available, sleeper_seats_available)", 5);
+        BulkInserter bookingInsert("INSERT INTO bookings (schedule_id, ticket, user_id, class, num_seats, "
+                                   "total_fare, date_of_booking)", 7);
+        bool ok = true;
+        for (size_t t = 0; t < trains.size() && ok; ++t) {
+            const GeneratedTrain& train = trains[t];
+            double expected = options.bookings * train.weight / (totalWeight * options.days);
+            std::poisson_distribution<long long> count(std::max(expected, 1e-9));
+            for (int d = 0; d < options.days && ok; ++d) {
+                ++scheduleId;
+                int acLeft = train.acSeats, sleeperLeft = train.sleeperSeats;
+                long long n = count(rng);
+                for (long long b = 0; b < n && (acLeft > 0 || sleeperLeft > 0) && ok; ++b) {
+                    int seats = 1 + pickSeats(rng);
+                    bool isAc = (rng() % 10 < 3 && acLeft >= seats) || sleeperLeft < seats;
+                    int& left = isAc ? acLeft : sleeperLeft;
+                    if (left < seats) seats = left;
+                    if (seats <= 0) break;
+                    left -= seats;
+                    int advance = static_cast<int>(rng() % 60);
+                    ok = bookingInsert.add({scheduleId, ++ticket, userBase + pickUser(rng), isAc ? ac : sleeper, seats,
+                                            seats * (isAc ? train.acFare : train.sleeperFare), bookedOn[d + 60 - advance]});
+                    stats.bookings++;
+                    sinceCommit++;
+                }
+                ok = ok && scheduleInsert.add({scheduleId, train.id, dates[d], acLeft, sleeperLeft});
+                stats.schedules++;
+
+                if (ok && sinceCommit >= ROWS_PER_TRANSACTION) {
+                    ok = bookingInsert.finish() && scheduleInsert.finish() && db.commit() && db.beginTransaction();
+                    sinceCommit = 0;
+                    std::cout << "  " << stats.bookings << " bookings written...\n";
+                }
+            }
+        }
+        if (!(ok && bookingInsert.finish() && scheduleInsert.finish())) return false;
+        return db.commit();
+    }
+};
+
+// ===================================================================
+//  Terminal Class (Singleton)
+//  Draws menus in-process with ANSI escape sequences instead of
+//  spawning a shell to clear the screen. A frame is captured from
+//  std::cout, compared line by line with the previous frame and only
+//  the changed lines are rewritten, all in a single write. Any output
+//  printed outside a frame invalidates the back buffer, so the next
+//  frame repaints the whole screen.
+// ===================================================================
+class Terminal {
+public:
+    static Terminal& getInstance() {
+        static Terminal instance;
+        return instance;
+    }
+
+    // Starts capturing std::cout into the next frame
+    void beginFrame() {
+        std::cout.flush();
+        frame.str("");
+        frame.clear();
+        std::cout.rdbuf(frame.rdbuf());
+    }
+
+    // Ends the frame and puts it on screen; the cursor is left after the frame's last line
+    void present() {
+        std::cout.rdbuf(&tracker);
+        if (resized.exchange(false)) {
+            width = queryWidth();
+            valid = false;
+        }
+
+        std::vector<std::string> lines;
+        std::string text = frame.str(), line;
+        std::stringstream ss(text);
+        while (std::getline(ss, line)) lines.push_back(line.size() > static_cast<size_t>(width) ? line.substr(0, width) : line);
+        if (lines.empty()) lines.emplace_back();
+
+        std::string out;
+        if (!valid || tracker.dirty) {
+            out = "\x1b[H\x1b[2J";
+            for (size_t i = 0; i < lines.size(); ++i) {
+                out += lines[i];
+                if (i + 1 < lines.size()) out += "\r\n";
+            }
+        } else {
+            // The last line is the prompt: it is always rewritten to wipe the echoed input
+            for (size_t i = 0; i < lines.size(); ++i) {
+                if (i + 1 < lines.size() && i < backBuffer.size() && backBuffer[i] == lines[i]) continue;
+                out += "\x1b[" + std::to_string(i + 1) + ";1H" + lines[i] + (i + 1 < lines.size() ? "\x1b[K" : "");
+            }
+            out += "\x1b[J";
+        }
+        writeOut(out);
+        backBuffer.swap(lines);
+        valid = true;
+        tracker.dirty = false;
+    }
+
+    // Width for a flexible table column so that a row of 'fixedWidth' other characters fits the terminal
+    int fitColumn(int preferred, int fixedWidth, int minimum) {
+        if (resized.exchange(false)) {
+            width = queryWidth();
+            valid = false;
+        }
+        return std::max(minimum, std::min(preferred, width - fixedWidth));
+    }
+
+private:
+    // Forwards to the real stdout buffer and records that something was printed
+    struct TrackingBuffer : public std::streambuf {
+        std::streambuf* target = nullptr;
+        bool dirty = true;
+
+        int_type overflow(int_type ch) override {
+            dirty = true;
+            return traits_type::eq_int_type(ch, traits_type::eof()) ? traits_type::not_eof(ch) : target->sputc(traits_type::to_char_type(ch));
+        }
+        std::streamsize xsputn(const char* s, std::streamsize n) override {
+            dirty = true;
+            return target->sputn(s, n);
+        }
+        int sync() override { return target->pubsync(); }
+    };
+
+    TrackingBuffer tracker;
+    std::stringstream frame;
+    std::vector<std::string> backBuffer;
+    bool valid = false;
+    int width = 80;
+    static std::atomic<bool> resized;
+
+    Terminal() {
+        tracker.target = std::cout.rdbuf();
+        std::cout.rdbuf(&tracker);
+        width = queryWidth();
+#ifndef _WIN32
+        std::signal(SIGWINCH, [](int) { resized.store(true); });
+#endif
+    }
+
+    ~Terminal() { std::cout.rdbuf(tracker.target); }
+
+    static int queryWidth() {
+#ifndef _WIN32
+        winsize ws{};
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) return ws.ws_col;
+#endif
+        return 200; // not a terminal: never clip
+    }
+
+    static void writeOut(const std::string& out) {
+        std::cout.flush();
+        std::fflush(stdout);
+#ifdef _WIN32
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        std::fflush(stdout);
+#else
+        const char* p = out.data();
+        size_t left = out.size();
+        while (left > 0) {
+            ssize_t n = ::write(STDOUT_FILENO, p, left);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+#endif
+    }
+};
+
+std::atomic<bool> Terminal::resized{false};
+
+// ===================================================================
+//  CpuProfiler Class (Singleton)
+//  In-process sampling profiler. While armed, a CPU-time timer raises
+//  SIGPROF SAMPLE_HZ times per second; the handler captures the stack
+//  into a preallocated buffer, claiming slots with an atomic counter,
+//  and does nothing else. Stacks are symbolized after the profile
+//  ends and written as folded stacks ("a;b;c count") for flame graph
+//  tools. When no profile is running the timer is not armed, so the
+//  profiler costs nothing. Link with -rdynamic to get function names;
+//  otherwise frames are written as module+offset for addr2line.
+// ===================================================================
+class CpuProfiler {
+public:
+    static CpuProfiler& getInstance() {
+        static CpuProfiler instance;
+        return instance;
+    }
+
+    // Starts sampling for 'seconds' of wall time; the profile goes to outputPath when it ends
+    bool start(int seconds, const std::string& outputPath, std::string& error) {
+#if defined(__linux__)
+        if (running) {
+            error = "A profile is already running.";
+            return false;
+        }
+        if (expired) {
+            error = "The previous profile has ended but has not been written yet.";
+            return false;
+        }
+        if (seconds <= 0) {
+            error = "Duration must be positive.";
+            return false;
+        }
+        capacity = static_cast<size_t>(seconds) * SAMPLE_HZ;
+        samples.reset(new Sample[capacity]);
+        next = 0;
+        dropped = 0;
+        path = outputPath;
+
+        // The first backtrace call loads the unwinder; do it here rather than in the handler
+        void* warmUp[4];
+        backtrace(warmUp, 4);
+
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_sigaction = onSample;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGPROF, &action, nullptr);
+
+        if (!timerCreated) {
+            sigevent event;
+            std::memset(&event, 0, sizeof(event));
+            event.sigev_notify = SIGEV_SIGNAL;
+            event.sigev_signo = SIGPROF;
+            if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &event, &timer) != 0) {
+                error = std::string("timer_create failed: ") + std::strerror(errno);
+                return false;
+            }
+            timerCreated = true;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += seconds;
+        running = true;
+        itimerspec interval;
+        interval.it_interval.tv_sec = 0;
+        interval.it_interval.tv_nsec = 1000000000L / SAMPLE_HZ;
+        interval.it_value = interval.it_interval;
+        timer_settime(timer, 0, &interval, nullptr);
+        return true;
+#else
+        (void)seconds;
+        (void)outputPath;
+        error = "CPU profiling is only available on Linux.";
+        return false;
+#endif
+    }
+
+    bool isRunning() const { return running; }
+
+    // Ends the profile once its time is up (or at once when 'force') and writes it.
+    // Returns true with a one-line summary when a profile was written.
+    bool finishIfDue(bool force, std::string& summary) {
+#if defined(__linux__)
+        if (!running && !expired) return false;
+        if (running) {
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            bool due = now.tv_sec > deadline.tv_sec || (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec);
+            if (!due && !force) return false;
+            disarm();
+        }
+        // A handler on another thread may still be filling its slot
+        while (inFlight.load() > 0) std::this_thread::yield();
+        expired = false;
+
+        std::map<std::string, unsigned long> folded;
+        std::unordered_map<void*, std::string> names;
+        size_t count = std::min(next.load(), capacity);
+        for (size_t i = 0; i < count; ++i) {
+            const Sample& sample = samples[i];
+            if (!sample.complete) continue;
+            std::string stack;
+            // Outermost frame first, skipping the handler and the signal trampoline
+            for (int f = sample.depth - 1; f >= SKIP_FRAMES; --f) {
+                auto it = names.find(sample.frames[f]);
+                if (it == names.end()) it = names.emplace(sample.frames[f], symbolize(sample.frames[f])).first;
+                if (!stack.empty()) stack += ';';
+                stack += it->second;
+            }
+            if (!stack.empty()) folded[stack]++;
+        }
+
+        std::ofstream out(path);
+        if (!out) {
+            summary = "Could not write CPU profile to " + path + ".";
+            return true;
+        }
+        for (const auto& entry : folded) out << entry.first << ' ' << entry.second << '\n';
+        summary = "CPU profile written to " + path + " (" + std::to_string(count) + " samples, " +
+                  std::to_string(dropped.load()) + " dropped).";
+        samples.reset();
+        return true;
+#else
+        (void)force;
+        (void)summary;
+        return false;
+#endif
+    }
+
+private:
+    CpuProfiler() {}
+    CpuProfiler(const CpuProfiler&) = delete;
+    CpuProfiler& operator=(const CpuProfiler&) = delete;
+
+    static const int SAMPLE_HZ = 199;
+    static const int MAX_FRAMES = 64;
+    static const int SKIP_FRAMES = 2;
+
+    struct Sample {
+        void* frames[MAX_FRAMES];
+        int depth;
+        std::atomic<bool> complete{false};
+    };
+
+#if defined(__linux__)
+    static void onSample(int, siginfo_t*, void*) {
+        CpuProfiler& self = getInstance();
+        // Counted before 'running' is checked, so finishIfDue() can wait out every handler that saw it set
+        self.inFlight++;
+        if (!self.running) {
+            self.inFlight--;
+            return;
+        }
+        size_t slot = self.next.fetch_add(1);
+        if (slot >= self.capacity) {
+            self.dropped++;
+            self.disarm();
+            self.inFlight--;
+            return;
+        }
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > self.deadline.tv_sec || (now.tv_sec == self.deadline.tv_sec && now.tv_nsec >= self.deadline.tv_nsec)) {
+            self.disarm();
+        }
+        int savedErrno = errno;
+        Sample& sample = self.samples[slot];
+        sample.depth = backtrace(sample.frames, MAX_FRAMES);
+        sample.complete = true;
+        errno = savedErrno;
+        self.inFlight--;
+    }
+
+    // Async-signal-safe: called from the handler when the buffer is full or time is up
+    void disarm() {
+        itimerspec off;
+        std::memset(&off, 0, sizeof(off));
+        timer_settime(timer, 0, &off, nullptr);
+        if (running.exchange(false)) expired = true;
+    }
+
+    static std::string symbolize(void* address) {
+        Dl_info info;
+        // Return addresses point after the call; look up the call instruction itself
+        void* lookup = static_cast<char*>(address) - 1;
+        if (dladdr(lookup, &info) && info.dli_sname) {
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+            std::free(demangled);
+            // Folded stacks separate frames with ';' (the count follows the last space)
+            std::replace(name.begin(), name.end(), ';', ':');
+            return name;
+        }
+        if (dladdr(lookup, &info) && info.dli_fname) {
+            std::string module = info.dli_fname;
+            size_t slash = module.rfind('/');
+            if (slash != std::string::npos) module = module.substr(slash + 1);
+            char offset[32];
+            std::snprintf(offset, sizeof(offset), "+0x%lx",
+                          static_cast<unsigned long>(static_cast<char*>(lookup) - static_cast<char*>(info.dli_fbase)));
+            return module + offset;
+        }
+        char raw[32];
+        std::snprintf(raw, sizeof(raw), "%p", address);
+        return raw;
+    }
+
+    timer_t timer;
+    bool timerCreated = false;
+    timespec deadline;
+#endif
+
+    std::unique_ptr<Sample[]> samples;
+    size_t capacity = 0;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> dropped{0};
+    std::atomic<bool> running{false};
+    std::atomic<bool> expired{false};
+    std::atomic<int> inFlight{0}; // signal handlers currently running
+    std::string path;
+};
+
+// ===================================================================
+//  StartupWarmup Class (Singleton)
+//  Does the cold-start work before the first request instead of
+//  inside it. The in-memory catalogs are loaded. The pooled read
+//  connections are opened, and the hot statements are prepared on
+//  each of them, which loads that connection's schema and index
+//  statistics. The hot indexes are read once so their pages sit in
+//  the OS page cache. Steps run in parallel lanes, one thread each.
+//  Loaders that share the main connection would only queue on its
+//  mutex, so they run one after another in a single lane. The
+//  pooled-read steps get one lane, and each index read gets its own
+//  lane and connection. The process is ready when every lane is
+//  done. If RAILWAY_READY_FILE is set, that file is removed at
+//  startup and written once the process is ready.
+// ===================================================================
+class StartupWarmup {
+public:
+    struct Step {
+        std::string name, detail;
+        double startMs = 0, durationMs = 0; // start is measured from process start
+        bool ok = false;
+    };
+
+    static StartupWarmup& getInstance() {
+        static StartupWarmup instance;
+        return instance;
+    }
+
+    // Milliseconds since the process started
+    static double sinceStart() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - processStart).count();
+    }
+
+    // Runs every step and returns once all have finished
+    void run() {
+        METRICS_SCOPE("warmup.run");
+        const char* readyFile = std::getenv("RAILWAY_READY_FILE");
+        if (readyFile && *readyFile) std::remove(readyFile);
+
+        // Schema setup and WAL mode come first; every other step needs them
+        timed("database", [] {
+            DatabaseManager::getInstance();
+            return std::string(DatabaseManager::databasePath());
+        });
+
+        using Lane = std::vector<std::pair<std::string, std::function<std::string()>>>;
+        std::vector<Lane> lanes = {
+            // Main connection, smallest loads first
+            {{"stations", [] {
+                 auto& index = StationIndex::getInstance();
+                 index.ensureLoaded();
+                 return std::to_string(index.size()) + " stations";
+             }},
+             {"catalog", [] { return std::to_string(TimetableCatalog::getInstance().current()->trains.size()) + " trains"; }},
+             {"availability", [] {
+                 auto& cache = AvailabilityCache::getInstance();
+                 cache.ensureLoaded();
+                 return std::to_string(cache.allDepartures().size()) + " departures";
+             }}},
+            // Pooled read connections
+            {{"read connections", [] { return openReaders(); }},
+             {"concessions", [] { return std::to_string(ConcessionEngine::getInstance().current()->activeRules) + " rules"; }}},
+        };
+        for (const auto& touch : PAGE_TOUCHES) {
+            lanes.push_back({{std::string("pages: ") + touch.first, [sql = touch.second] { return touchPages(sql); }}});
+        }
+
+        std::vector<std::thread> threads;
+        for (const auto& lane : lanes) {
+            threads.emplace_back([this, &lane] {
+                for (const auto& step : lane) timed(step.first, step.second);
+            });
+        }
+        for (auto& thread : threads) thread.join();
+
+        readyAtMs = sinceStart();
+        readyFlag.store(true, std::memory_order_release);
+        if (readyFile && *readyFile) writeReadyFile(readyFile);
+    }
+
+    // Marks the process ready without warming anything (RAILWAY_WARMUP=0)
+    void skip() {
+        readyAtMs = sinceStart();
+        readyFlag.store(true, std::memory_order_release);
+        const char* readyFile = std::getenv("RAILWAY_READY_FILE");
+        if (readyFile && *readyFile) writeReadyFile(readyFile);
+    }
+
+    bool ready() const { return readyFlag.load(std::memory_order_acquire); }
+    double readyMs() const { return readyAtMs; }
+
+    // One line for the menu status
+    std::string summary() const {
+        std::lock_guard<std::mutex> guard(stepsMutex);
+        double work = 0;
+        int failed = 0;
+        for (const auto& step : steps) {
+            work += step.durationMs;
+            failed += step.ok ? 0 : 1;
+        }
+        std::stringstream out;
+        out << std::fixed << std::setprecision(1) << "Ready " << readyAtMs << " ms after start";
+        if (!steps.empty()) out << " (" << steps.size() << " warm-up steps, " << work << " ms of work)";
+        if (failed) out << "; " << failed << " warm-up steps failed";
+        return out.str();
+    }
+
+    void printReport(std::ostream& out) const {
+        std::lock_guard<std::mutex> guard(stepsMutex);
+        if (steps.empty()) {
+            out << "Warm-up was skipped; ready " << std::fixed << std::setprecision(1) << readyAtMs << " ms after start.\n";
+            return;
+        }
+        const int W_STEP = 28, W_START = 10, W_TIME = 10, W_DETAIL = 26;
+        const int width = W_STEP + W_START + W_TIME + W_DETAIL + 13;
+        out << std::string(width, '-') << "\n";
+        out << "| " << std::left << std::setw(W_STEP) << "Warm-up step" << "| " << std::setw(W_START) << "Start ms"
+            << "| " << std::setw(W_TIME) << "Took ms" << "| " << std::setw(W_DETAIL) << "Result" << " |\n";
+        out << std::string(width, '-') << "\n";
+        for (const auto& step : steps) {
+            out << "| " << std::left << std::setw(W_STEP) << step.name << "| " << std::right << std::fixed << std::setprecision(1)
+                << std::setw(W_START - 1) << step.startMs << " | " << std::setw(W_TIME - 1) << step.durationMs << " | " << std::left
+                << std::setw(W_DETAIL) << step.detail.substr(0, W_DETAIL) << " |\n";
+        }
+        out << std::string(width, '-') << "\n";
+        out << "Ready " << std::fixed << std::setprecision(1) << readyAtMs << " ms after process start.\n";
+    }
+
+    // Times the requests a user makes first, each the first of its kind in this process
+    static void probeFirstRequests(std::ostream& out) {
+        SqliteStorage storage;
+        auto probe = [&](const char* name, const std::function<std::string()>& request) {
+            double start = sinceStart();
+            std::string detail = request();
+            out << "  " << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(2)
+                << std::setw(10) << sinceStart() - start << " ms  " << detail << "\n";
+        };
+        out << "First requests:\n";
+        probe("list departures", [&] { return std::to_string(storage.findSchedules(TimeUtil::formatDate(TimeUtil::today())).size()) + " departures"; });
+        probe("availability lookup", [] {
+            auto& cache = AvailabilityCache::getInstance();
+            cache.ensureLoaded();
+            return std::string(cache.allDepartures().empty() || cache.find(cache.allDepartures()[0].scheduleId) ? "found" : "missing");
+        });
+        probe("my bookings", [&] {
+            auto users = DatabaseManager::getInstance().selectRows<Schema::Users>("ORDER BY user_id DESC LIMIT 1");
+            std::vector<StorageBackend::BookingView> bookings;
+            std::string reason;
+            bool ok = storage.listBookingsForUser(users.empty() ? 0 : users[0].userId, bookings, reason);
+            return ok ? std::to_string(bookings.size()) + " bookings" : "failed: " + reason;
+        });
+        probe("timetable", [] { return std::to_string(TimetableCatalog::getInstance().current()->trains.size()) + " trains"; });
+        probe("fare quote", [] { return std::to_string(ConcessionEngine::getInstance().current()->activeRules) + " rules"; });
+        probe("nearby stations", [] { return std::to_string(StationIndex::getInstance().nearest(20.0, 80.0, 1).size()) + " found"; });
+    }
+
+private:
+    // Indexes the first user requests look up (my bookings, cancel by ticket) that no
+    // loader reads. COUNT(*) walks an index's pages without decoding its rows.
+    static constexpr std::pair<const char*, const char*> PAGE_TOUCHES[] = {
+        {"bookings by user", "SELECT COUNT(*) FROM bookings INDEXED BY idx_bookings_user;"},
+        {"tickets", "SELECT COUNT(*) FROM bookings INDEXED BY idx_bookings_ticket;"},
+    };
+
+    inline static const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+
+    std::vector<Step> steps;
+    mutable std::mutex stepsMutex;
+    std::atomic<bool> readyFlag{false};
+    double readyAtMs = 0;
+
+    StartupWarmup() {}
+    StartupWarmup(const StartupWarmup&) = delete;
+    StartupWarmup& operator=(const StartupWarmup&) = delete;
 
-        auto truncate = [](const std::string& str, int width) {
-            if (str.length() > width) {
-                return str.substr(0, width - 1) + "."; // Truncate and add a '.'
+    void timed(const std::string& name, const std::function<std::string()>& body) {
+        Step step;
+        step.name = name;
+        step.startMs = sinceStart();
+        try {
+            step.detail = body();
+            step.ok = step.detail.compare(0, 6, "error:") != 0;
+        } catch (const std::exception& e) {
+            step.detail = e.what();
+        }
+        step.durationMs = sinceStart() - step.startMs;
+        std::lock_guard<std::mutex> guard(stepsMutex);
+        steps.push_back(step);
+    }
+
+    // Holds every user-read slot at once so each gets its own connection, then returns them to the pool
+    static std::string openReaders() {
+        auto& pool = ConnectionPool::getInstance();
+        const std::string statements[] = {SqliteStorage::departuresSql(), SqliteStorage::userBookingsSql()};
+        std::vector<ConnectionPool::Lease> leases;
+        for (int i = 0; i < ConnectionPool::limits(WorkloadClass::UserRead).maxConcurrent; ++i) {
+            auto lease = pool.acquire(WorkloadClass::UserRead);
+            if (!lease.valid()) break;
+            for (const auto& sql : statements) {
+                PreparedStatement stmt(lease.connection(), sql);
+                if (!stmt.valid()) return "error: could not prepare statements";
             }
-            return str;
-        };
+            leases.push_back(std::move(lease));
+        }
+        return std::to_string(leases.size()) + " opened";
+    }
 
-        std::cout << "| " << std::left << std::setw(W_NUM) << truncate(number, W_NUM)
-                  << "| " << std::setw(W_NAME) << truncate(name, W_NAME)
-                  << "| " << std::setw(W_SRC) << truncate(source, W_SRC)
-                  << "| " << std::setw(W_DEST) << truncate(destination, W_DEST)
-                  << "| " << std::setw(W_DEP) << truncate(departureTime, W_DEP)
-                  << "| " << std::setw(W_DUR) << truncate(journeyDuration, W_DUR) << " |" << std::endl;
+    static std::string touchPages(const char* sql) {
+        sqlite3* connection = nullptr;
+        if (sqlite3_open_v2(DatabaseManager::databasePath(), &connection, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+            sqlite3_close(connection);
+            return "error: could not open database";
+        }
+        sqlite3_busy_timeout(connection, 5000);
+        std::string detail = "error: query failed";
+        {
+            PreparedStatement stmt(connection, sql);
+            if (stmt.valid() && stmt.step() == SQLITE_ROW) detail = stmt.columnText(0) + " entries";
+        }
+        sqlite3_close(connection);
+        return detail;
+    }
+
+    // Written under a temporary name and renamed, so a watcher never sees half a file
+    void writeReadyFile(const char* path) const {
+        std::string temporary = std::string(path) + ".tmp";
+        {
+            std::ofstream out(temporary);
+            out << "ready_ms " << std::fixed << std::setprecision(1) << readyAtMs << "\n";
+            std::lock_guard<std::mutex> guard(stepsMutex);
+            for (const auto& step : steps) out << step.name << " " << step.durationMs << " " << (step.ok ? "ok" : "failed") << "\n";
+        }
+        if (std::rename(temporary.c_str(), path) != 0) std::cerr << "Could not write ready file " << path << std::endl;
     }
-    // ============================ FORMATTING FIX END ============================
 };
 
 // ===================================================================
@@ -206,20 +7397,45 @@ public:
 // ===================================================================
 class RailwaySystem {
 public:
+    explicit RailwaySystem(std::unique_ptr<StorageBackend> backend = std::make_unique<SqliteStorage>())
+        : storage(std::move(backend)) {}
+
     void run() {
+        // What the first requests would otherwise load on demand is loaded before the first menu
+        auto& warmup = StartupWarmup::getInstance();
+        const char* setting = std::getenv("RAILWAY_WARMUP");
+        if (setting && std::strcmp(setting, "0") == 0) warmup.skip(); else warmup.run();
+        menuStatus = warmup.summary();
         mainMenu();
     }
 
 private:
+    std::unique_ptr<StorageBackend> storage;
     std::string loggedInUsername;
+    int loggedInUserId = 0;
+    JourneyPlanner planner;
+    std::string plannerStamp; // timetable fingerprint the planner was built from
 
     // --- Utility Methods ---
-    void clearScreen() {
-    #ifdef _WIN32
-        system("cls");
-    #else
-        system("clear");
-    #endif
+    std::string menuStatus; // one-line message shown in the next menu frame
+
+    // Reads a menu choice; returns 0 for non-numeric input and exits cleanly on end of input
+    int readChoice() {
+        int choice = 0;
+        if (std::cin >> choice) return choice;
+        if (std::cin.eof()) std::exit(0);
+        std::cin.clear();
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        return 0;
+    }
+
+    void printMenuStatus() {
+        std::string profileSummary;
+        if (CpuProfiler::getInstance().finishIfDue(false, profileSummary)) {
+            menuStatus += (menuStatus.empty() ? "" : "\n") + profileSummary;
+        }
+        if (!menuStatus.empty()) std::cout << menuStatus << "\n";
+        menuStatus.clear();
     }
 
     void pressEnterToContinue() {
@@ -228,18 +7444,49 @@ private:
         std::cin.get();
     }
 
-    std::string generateTicketId() {
+    long long generateTicket() {
         std::random_device rd;
         std::mt19937 gen(rd());
         std::uniform_int_distribution<> distrib(100000, 999999);
-        return "TKT" + std::to_string(distrib(gen));
+        return distrib(gen);
+    }
+
+    // Accepts "TKT123456" or "123456"; returns -1 for anything else
+    static long long parseTicket(const std::string& text) {
+        std::string digits = text.compare(0, 3, "TKT") == 0 ? text.substr(3) : text;
+        if (digits.empty() || digits.find_first_not_of("0123456789") != std::string::npos) return -1;
+        return std::stoll(digits);
+    }
+
+public:
+    // Splits "A,B,C" into its items; "ALL" (or an empty string) yields an empty list
+    static std::vector<std::string> splitList(const std::string& list) {
+        std::vector<std::string> items;
+        if (list == "ALL" || list == "all") return items;
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            if (!item.empty()) items.push_back(item);
+        }
+        return items;
+    }
+
+    // Shared by the admin menu and --reload-timetable
+    static void printReloadResult(const TimetableReload::Result& result, std::ostream& out) {
+        if (!result.ok) {
+            out << "Timetable reload failed, nothing was changed: " << result.error << "\n";
+            return;
+        }
+        out << result.added << " trains added, " << result.changed << " changed, " << result.removed << " removed, "
+            << result.unchanged << " unchanged; " << result.stopListsReplaced << " stop lists replaced.\n";
     }
 
+private:
     // --- Main Menus ---
     void mainMenu() {
         int choice;
         do {
-            clearScreen();
+            Terminal::getInstance().beginFrame();
             std::cout << "========================================\n";
             std::cout << "   Railway Reservation System\n";
             std::cout << "========================================\n";
@@ -247,15 +7494,17 @@ private:
             std::cout << "2. User Signup\n";
             std::cout << "3. Admin Login\n";
             std::cout << "4. Exit\n";
+            printMenuStatus();
             std::cout << "Enter your choice: ";
-            std::cin >> choice;
+            Terminal::getInstance().present();
+            choice = readChoice();
 
             switch (choice) {
                 case 1: handleUserLogin(); break;
                 case 2: handleUserSignup(); break;
                 case 3: handleAdminLogin(); break;
                 case 4: std::cout << "Exiting system. Goodbye!\n"; break;
-                default: std::cout << "Invalid choice.\n"; pressEnterToContinue();
+                default: menuStatus = "Invalid choice.";
             }
         } while (choice != 4);
     }
@@ -263,16 +7512,26 @@ private:
     void adminMenu() {
         int choice;
         do {
-            clearScreen();
+            Terminal::getInstance().beginFrame();
             std::cout << "--- Admin Menu ---\n";
             std::cout << "1. Add New Train Route\n";
             std::cout << "2. Schedule a Train for a Date\n";
             std::cout << "3. View All Train Routes\n";
             std::cout << "4. Delete Train Route\n";
             std::cout << "5. View All Bookings\n";
-            std::cout << "6. Logout\n";
+            std::cout << "6. Reconcile Seat Counters\n";
+            std::cout << "7. Bulk Schedule Over Date Range\n";
+            std::cout << "8. Ingest Running Status Feed\n";
+            std::cout << "9. View Metrics\n";
+            std::cout << "10. Profile CPU\n";
+            std::cout << "11. Reload Timetable From File\n";
+            std::cout << "12. Concession Rules\n";
+            std::cout << "13. Coach Composition\n";
+            std::cout << "14. Logout\n";
+            printMenuStatus();
             std::cout << "Enter your choice: ";
-            std::cin >> choice;
+            Terminal::getInstance().present();
+            choice = readChoice();
 
             switch (choice) {
                 case 1: addTrain(); break;
@@ -280,43 +7539,56 @@ private:
                 case 3: viewAllTrains(true); break; // true to pause
                 case 4: deleteTrain(); break;
                 case 5: viewAllBookingsAdmin(); break;
-                case 6: std::cout << "Logging out...\n"; break;
-                default: std::cout << "Invalid choice.\n"; pressEnterToContinue();
+                case 6: reconcileSeats(); break;
+                case 7: bulkScheduleTrains(); break;
+                case 8: ingestRunningStatus(); break;
+                case 9: viewMetrics(); break;
+                case 10: profileCpu(); break;
+                case 11: reloadTimetable(); break;
+                case 12: manageConcessions(); break;
+                case 13: manageCoaches(); break;
+                case 14: std::cout << "Logging out...\n"; break;
+                default: menuStatus = "Invalid choice.";
             }
-        } while (choice != 6);
+        } while (choice != 14);
     }
 
     void userMenu() {
         int choice;
         do {
-            clearScreen();
+            Terminal::getInstance().beginFrame();
             std::cout << "--- Welcome, " << loggedInUsername << "! ---\n";
             std::cout << "1. Book Ticket\n";
             std::cout << "2. View My Bookings\n";
             std::cout << "3. Cancel Ticket\n";
-            std::cout << "4. Logout\n";
+            std::cout << "4. Search Journeys\n";
+            std::cout << "5. Logout\n";
+            printMenuStatus();
             std::cout << "Enter your choice: ";
-            std::cin >> choice;
+            Terminal::getInstance().present();
+            choice = readChoice();
 
             switch (choice) {
                 case 1: bookTicket(); break;
                 case 2: viewMyBookings(); break;
                 case 3: cancelTicket(); break;
-                case 4: std::cout << "Logging out...\n"; break;
-                default: std::cout << "Invalid choice.\n"; pressEnterToContinue();
+                case 4: searchJourneys(); break;
+                case 5: std::cout << "Logging out...\n"; break;
+                default: menuStatus = "Invalid choice.";
             }
-        } while (choice != 4);
+        } while (choice != 5);
     }
 
     // --- Authentication Handlers ---
     void handleUserSignup() {
+        METRICS_SCOPE("menu.handleUserSignup");
         std::string username, password;
         std::cout << "--- User Signup ---\n";
         std::cout << "Enter username: "; 
         std::cin >> username;
 
-        std::string checkSql = "SELECT 1 FROM users WHERE username='" + username + "';";
-        if (!DatabaseManager::getInstance().executeQuery(checkSql).empty()) {
+        auto& db = DatabaseManager::getInstance();
+        if (!db.selectRows<Schema::Users>("WHERE username = ?", {username}).empty()) {
             std::cout << "Username already exists. Please choose a different one.\n";
             pressEnterToContinue();
             return;
@@ -324,8 +7596,10 @@ private:
 
         std::cout << "Enter password: "; 
         std::cin >> password;
-        std::string sql = "INSERT INTO users (username, password) VALUES ('" + username + "', '" + password + "');";
-        if (DatabaseManager::getInstance().executeUpdate(sql)) {
+        User user;
+        user.username = username;
+        user.password = password;
+        if (db.insertRow<Schema::Users>(user)) {
             std::cout << "Signup successful! You can now log in.\n";
         } else {
             std::cout << "An unexpected error occurred during signup.\n";
@@ -339,10 +7613,11 @@ private:
         std::cout << "--- User Login ---\n";
         std::cout << "Enter username: "; std::cin >> username;
         std::cout << "Enter password: "; std::cin >> password;
-        std::string sql = "SELECT * FROM users WHERE username='" + username + "' AND password='" + password + "';";
-        if (!DatabaseManager::getInstance().executeQuery(sql).empty()) {
+        auto user = DatabaseManager::getInstance().selectRows<Schema::Users>("WHERE username = ? AND password = ?", {username, password});
+        if (!user.empty()) {
             std::cout << "Login successful!\n";
             loggedInUsername = username;
+            loggedInUserId = user[0].userId;
             pressEnterToContinue();
             userMenu();
         } else {
@@ -359,6 +7634,8 @@ private:
         if (username == "admin" && password == "admin123") {
             std::cout << "Admin login successful!\n";
             loggedInUsername = "admin";
+            auto admin = DatabaseManager::getInstance().selectRows<Schema::Users>("WHERE username = ?", {"admin"});
+            loggedInUserId = admin.empty() ? 0 : admin[0].userId;
             pressEnterToContinue();
             adminMenu();
         } else {
@@ -369,6 +7646,7 @@ private:
     
     // --- Admin Functionality ---
     void addTrain() {
+        METRICS_SCOPE("menu.addTrain");
         Train t;
         std::cout << "--- Add New Train Route ---\n";
         std::cout << "Enter Train Number: "; std::cin >> t.number;
@@ -378,21 +7656,21 @@ private:
         std::cout << "Enter Departure Time (HH:MM): "; std::cin >> t.departureTime;
         std::cout << "Enter Journey Duration (HH:MM): "; std::cin >> t.journeyDuration;
         
-        int totalAcSeats, totalSleeperSeats;
-        double acFare, sleeperFare;
-        std::cout << "Enter Total AC Seats: "; std::cin >> totalAcSeats;
-        std::cout << "Enter AC Fare: "; std::cin >> acFare;
-        std::cout << "Enter Total Sleeper Seats: "; std::cin >> totalSleeperSeats;
-        std::cout << "Enter Sleeper Fare: "; std::cin >> sleeperFare;
+        std::cout << "Enter Total AC Seats: "; std::cin >> t.totalAcSeats;
+        std::cout << "Enter AC Fare: "; std::cin >> t.acFare;
+        std::cout << "Enter Total Sleeper Seats: "; std::cin >> t.totalSleeperSeats;
+        std::cout << "Enter Sleeper Fare: "; std::cin >> t.sleeperFare;
 
-        std::string sql = "INSERT INTO trains VALUES ('" + t.number + "', '" + t.name + "', '" + t.source + "', '" + t.destination + "', '" + t.departureTime + "', '" + t.journeyDuration + "', " + std::to_string(totalAcSeats) + ", " + std::to_string(totalSleeperSeats) + ", " + std::to_string(acFare) + ", " + std::to_string(sleeperFare) + ");";
-        
-        if (DatabaseManager::getInstance().executeUpdate(sql)) std::cout << "Train route added successfully!\n";
-        else std::cout << "Failed to add train route (Train Number might already exist).\n";
+        if (storage->addTrain(t)) {
+            std::cout << "Train route added successfully!\n";
+        } else {
+            std::cout << "Failed to add train route (Train Number might already exist).\n";
+        }
         pressEnterToContinue();
     }
 
     void scheduleTrain() {
+        METRICS_SCOPE("menu.scheduleTrain");
         std::cout << "--- Schedule a Train for a Date ---\n";
         viewAllTrains(false); // false to not pause
         std::string trainNumber, date;
@@ -401,18 +7679,14 @@ private:
         std::cout << "Enter Departure Date (YYYY-MM-DD): ";
         std::cin >> date;
 
-        auto trainResult = DatabaseManager::getInstance().executeQuery("SELECT total_ac_seats, total_sleeper_seats FROM trains WHERE train_number='" + trainNumber + "';");
-        if (trainResult.empty()) {
+        auto status = storage->scheduleTrain(trainNumber, date);
+        if (status == StorageBackend::ScheduleStatus::NoSuchTrain) {
             std::cout << "Train not found.\n";
             pressEnterToContinue();
             return;
         }
 
-        std::string totalAcSeats = trainResult[0][0];
-        std::string totalSleeperSeats = trainResult[0][1];
-
-        std::string sql = "INSERT INTO schedules (train_number, departure_date, ac_seats_available, sleeper_seats_available) VALUES ('" + trainNumber + "', '" + date + "', " + totalAcSeats + ", " + totalSleeperSeats + ");";
-        if (DatabaseManager::getInstance().executeUpdate(sql)) {
+        if (status == StorageBackend::ScheduleStatus::Scheduled) {
             std::cout << "Train scheduled successfully for " << date << ".\n";
         } else {
             std::cout << "Failed to schedule train. It might already be scheduled for this date.\n";
@@ -420,46 +7694,121 @@ private:
         pressEnterToContinue();
     }
 
+    void bulkScheduleTrains() {
+        METRICS_SCOPE("menu.bulkScheduleTrains");
+        std::cout << "--- Bulk Schedule Over Date Range ---\n";
+        std::string trainList, fromDate, toDate, mask;
+        std::cout << "Enter Train Numbers (comma separated, or ALL): ";
+        std::cin >> trainList;
+        std::cout << "Enter First Departure Date (YYYY-MM-DD): ";
+        std::cin >> fromDate;
+        std::cout << "Enter Last Departure Date (YYYY-MM-DD): ";
+        std::cin >> toDate;
+        std::cout << "Enter Weekday Mask (Mon..Sun as 0/1, e.g. 1111100): ";
+        std::cin >> mask;
+
+        auto start = std::chrono::steady_clock::now();
+        ScheduleRollout rollout;
+        auto result = rollout.run(splitList(trainList), fromDate, toDate, mask);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        if (result.ok) {
+            AvailabilityCache::getInstance().invalidate();
+            std::cout << result.inserted << " departures scheduled, " << (result.requested - result.inserted)
+                      << " already existed (" << elapsed << " ms).\n";
+        } else {
+            std::cout << "Bulk scheduling failed: " << result.error << "\n";
+        }
+        pressEnterToContinue();
+    }
+
+    void ingestRunningStatus() {
+        METRICS_SCOPE("menu.ingestRunningStatus");
+        std::cout << "--- Ingest Running Status Feed ---\n";
+        std::string path;
+        std::cout << "Enter feed file path: ";
+        std::cin >> path;
+        std::ifstream feedFile(path);
+        if (!feedFile) {
+            std::cout << "Could not open " << path << ".\n";
+            pressEnterToContinue();
+            return;
+        }
+        RunningStatusFeed feed;
+        auto stats = feed.ingest(feedFile);
+        std::cout << stats.events << " events applied, " << stats.rejected << " rejected, "
+                  << stats.estimatesChanged << " stop estimates updated.\n";
+        pressEnterToContinue();
+    }
+
     void viewAllTrains(bool pause) {
+        METRICS_SCOPE("menu.viewAllTrains");
         std::cout << "--- List of All Train Routes ---\n";
-        auto results = DatabaseManager::getInstance().executeQuery("SELECT * FROM trains;");
-        if (results.empty()) {
+        auto trains = DatabaseManager::getInstance().selectRows<Schema::Trains>();
+        if (trains.empty()) {
             std::cout << "No train routes found.\n";
         } else {
+            METRICS_SCOPE("render.trainList");
             Train t_header;
-            t_header.displayAsHeader();
-            for (const auto& row : results) {
-                Train t = {row[0], row[1], row[2], row[3], row[4], row[5]};
-                t.displayAsRow();
+            int nameWidth = Terminal::getInstance().fitColumn(45, 10 + 25 + 25 + 11 + 10 + 19, 12);
+            t_header.displayAsHeader(nameWidth);
+            for (const auto& t : trains) {
+                t.displayAsRow(nameWidth);
             }
-            const int W_NUM = 10, W_NAME = 45, W_SRC = 25, W_DEST = 25, W_DEP = 11, W_DUR = 10;
+            const int W_NUM = 10, W_NAME = nameWidth, W_SRC = 25, W_DEST = 25, W_DEP = 11, W_DUR = 10;
             std::cout << std::string(W_NUM + W_NAME + W_SRC + W_DEST + W_DEP + W_DUR + 19, '-') << std::endl;
         }
         if (pause) pressEnterToContinue();
     }
 
     void deleteTrain() {
+        METRICS_SCOPE("menu.deleteTrain");
         std::cout << "--- Delete Train Route ---\n";
         viewAllTrains(false);
         std::string trainNumber;
         std::cout << "\nEnter Train Number to delete: ";
         std::cin >> trainNumber;
-        std::string sql = "DELETE FROM trains WHERE train_number='" + trainNumber + "';";
-        if (DatabaseManager::getInstance().executeUpdate(sql)) std::cout << "Train route deleted successfully.\n";
-        else std::cout << "Failed to delete train route.\n";
+        auto& db = DatabaseManager::getInstance();
+        auto trains = db.selectRows<Schema::Trains>("WHERE train_number = ?", {trainNumber});
+        std::string error;
+        if (trains.empty()) {
+            std::cout << "No train " << trainNumber << ".\n";
+        } else if (db.beginTransaction() && TimetableReload::removeTrain(trains[0].id, trainNumber, error) && db.commit()) {
+            std::cout << "Train route deleted successfully.\n";
+            AvailabilityCache::getInstance().invalidate();
+            TimetableCatalog::getInstance().invalidate();
+        } else {
+            db.rollback();
+            std::cout << "Failed to delete train route" << (error.empty() ? "" : ": " + error) << ".\n";
+        }
         pressEnterToContinue();
     }
 
     void viewAllBookingsAdmin() {
+        METRICS_SCOPE("menu.viewAllBookingsAdmin");
         std::cout << "--- All User Bookings ---\n";
-        std::string sql = "SELECT b.ticket_id, b.username, t.train_name, s.departure_date, b.class, b.num_seats, b.total_fare FROM bookings b JOIN schedules s ON b.schedule_id = s.schedule_id JOIN trains t ON s.train_number = t.train_number;";
-        auto results = DatabaseManager::getInstance().executeQuery(sql);
+        // Runs in the admin-report class: its own read connection, one report at a time and a deadline
+        auto lease = ConnectionPool::getInstance().acquire(WorkloadClass::AdminReport);
+        if (!lease.valid()) {
+            std::cout << "Another report is running; try again later.\n";
+            pressEnterToContinue();
+            return;
+        }
+#ifndef _WIN32
+        ConnectionPool::InterruptScope interruptible(WorkloadClass::AdminReport);
+#endif
+        // The booking's own columns come first; the joined names and date follow them
+        PreparedStatement report(lease.connection(),
+            "SELECT " + Schema::columnList<Schema::Bookings>("b") + ", u.username, t.train_name, s.departure_date "
+            "FROM bookings b JOIN schedules s ON b.schedule_id = s.schedule_id JOIN trains t ON s.train_id = t.train_id "
+            "JOIN users u ON b.user_id = u.user_id;");
+        const int joined = Schema::columnCount<Schema::Bookings>();
+        int rc = report.valid() ? report.step() : SQLITE_ERROR;
 
-        if (results.empty()) {
+        if (rc == SQLITE_DONE) {
             std::cout << "No bookings found.\n";
-        } else {
+        } else if (rc == SQLITE_ROW) {
              // ============================ FORMATTING FIX START ============================
-             const int W_TID = 15, W_USER = 15, W_NAME = 30, W_DATE = 12, W_CLASS = 10, W_SEATS = 7, W_FARE = 12;
+             const int W_TID = 15, W_USER = 15, W_NAME = Terminal::getInstance().fitColumn(30, 15 + 15 + 12 + 10 + 7 + 12 + 22, 10), W_DATE = 12, W_CLASS = 10, W_SEATS = 7, W_FARE = 12;
              std::cout << std::string(W_TID + W_USER + W_NAME + W_DATE + W_CLASS + W_SEATS + W_FARE + 22, '-') << std::endl;
              std::cout << "| " << std::left << std::setw(W_TID) << "Ticket ID" << "| " << std::setw(W_USER) << "Username" << "| " << std::setw(W_NAME) << "Train Name" << "| " << std::setw(W_DATE) << "Date" << "| " << std::setw(W_CLASS) << "Class" << "| " << std::setw(W_SEATS) << "Seats" << "| " << std::setw(W_FARE) << "Fare" << " |" << std::endl;
              std::cout << std::string(W_TID + W_USER + W_NAME + W_DATE + W_CLASS + W_SEATS + W_FARE + 22, '-') << std::endl;
@@ -470,30 +7819,229 @@ private:
                 return str;
              };
 
-             for (const auto& row : results) {
-                totalRevenue += std::stod(row[6]);
+             // Rows are printed as they are read, so memory stays flat however many bookings exist
+             for (; rc == SQLITE_ROW; rc = report.step()) {
+                Booking booking = Schema::readRow<Schema::Bookings>(report);
+                totalRevenue += booking.totalFare;
                 std::cout << "| " << std::left 
-                          << std::setw(W_TID) << truncate(row[0], W_TID) 
-                          << "| " << std::setw(W_USER) << truncate(row[1], W_USER) 
-                          << "| " << std::setw(W_NAME) << truncate(row[2], W_NAME) 
-                          << "| " << std::setw(W_DATE) << row[3] 
-                          << "| " << std::setw(W_CLASS) << row[4] 
-                          << "| " << std::setw(W_SEATS) << row[5] 
-                          << "| " << std::setw(W_FARE) << std::fixed << std::setprecision(2) << std::stod(row[6]) << " |" << std::endl;
+                          << std::setw(W_TID) << truncate("TKT" + std::to_string(booking.ticket), W_TID) 
+                          << "| " << std::setw(W_USER) << truncate(report.columnText(joined), W_USER) 
+                          << "| " << std::setw(W_NAME) << truncate(report.columnText(joined + 1), W_NAME) 
+                          << "| " << std::setw(W_DATE) << report.columnText(joined + 2) 
+                          << "| " << std::setw(W_CLASS) << booking.seatClass 
+                          << "| " << std::setw(W_SEATS) << booking.numSeats 
+                          << "| " << std::setw(W_FARE) << std::fixed << std::setprecision(2) << booking.totalFare << " |" << "\n";
              }
              std::cout << std::string(W_TID + W_USER + W_NAME + W_DATE + W_CLASS + W_SEATS + W_FARE + 22, '-') << std::endl;
              // ============================ FORMATTING FIX END ============================
-             std::cout << "\n--- Total Revenue: " << std::fixed << std::setprecision(2) << totalRevenue << " ---\n";
+             if (rc == SQLITE_DONE) {
+                 std::cout << "\n--- Total Revenue: " << std::fixed << std::setprecision(2) << totalRevenue << " ---\n";
+             }
+        }
+        if (rc == SQLITE_INTERRUPT) {
+            std::cout << "Report stopped: " << lease.interruption() << ".\n";
+        } else if (rc != SQLITE_DONE) {
+            std::cout << "Report failed: " << sqlite3_errmsg(lease.connection()) << "\n";
+        }
+        pressEnterToContinue();
+    }
+
+    void reconcileSeats() {
+        METRICS_SCOPE("menu.reconcileSeats");
+        std::cout << "--- Reconcile Seat Counters ---\n";
+        char fix;
+        std::cout << "Automatically correct mismatched counters? (y/n): ";
+        std::cin >> fix;
+        SeatReconciler reconciler;
+        auto report = reconciler.run(fix == 'y' || fix == 'Y');
+        if (report.corrected > 0) AvailabilityCache::getInstance().invalidate();
+        SeatReconciler::printReport(report);
+        pressEnterToContinue();
+    }
+
+    void reloadTimetable() {
+        METRICS_SCOPE("menu.reloadTimetable");
+        std::cout << "--- Reload Timetable From File ---\n";
+        std::string path;
+        std::cout << "Enter path of the timetable delta file: ";
+        std::cin >> path;
+        std::ifstream file(path);
+        if (!file) {
+            std::cout << "Could not open " << path << ".\n";
+            pressEnterToContinue();
+            return;
+        }
+        TimetableReload reload;
+        printReloadResult(reload.run(file), std::cout);
+        pressEnterToContinue();
+    }
+
+    void manageConcessions() {
+        METRICS_SCOPE("menu.manageConcessions");
+        std::cout << "--- Concession Rules ---\n";
+        auto& db = DatabaseManager::getInstance();
+        auto rules = db.selectRows<Schema::ConcessionRules>("ORDER BY rule_id");
+        const int W_ID = 5, W_NAME = 22, W_CAT = 9, W_CLASS = 9, W_PROMO = 12, W_OFF = 16, W_DATES = 24, W_ACTIVE = 7;
+        const int width = W_ID + W_NAME + W_CAT + W_CLASS + W_PROMO + W_OFF + W_DATES + W_ACTIVE + 25;
+        std::cout << std::string(width, '-') << "\n";
+        std::cout << "| " << std::left << std::setw(W_ID) << "ID" << "| " << std::setw(W_NAME) << "Name" << "| " << std::setw(W_CAT) << "Category"
+                  << "| " << std::setw(W_CLASS) << "Class" << "| " << std::setw(W_PROMO) << "Promo" << "| " << std::setw(W_OFF) << "Discount"
+                  << "| " << std::setw(W_DATES) << "Valid" << "| " << std::setw(W_ACTIVE) << "Active" << " |\n";
+        std::cout << std::string(width, '-') << "\n";
+        for (const auto& rule : rules) {
+            std::stringstream off, dates;
+            off << std::fixed << std::setprecision(0) << rule.percentOff << "% / Rs " << rule.flatOff;
+            dates << (rule.validFrom.empty() ? "..." : rule.validFrom) << " - " << (rule.validTo.empty() ? "..." : rule.validTo);
+            std::cout << "| " << std::left << std::setw(W_ID) << rule.ruleId << "| " << std::setw(W_NAME) << rule.name.substr(0, W_NAME)
+                      << "| " << std::setw(W_CAT) << rule.category << "| " << std::setw(W_CLASS) << rule.seatClass
+                      << "| " << std::setw(W_PROMO) << rule.promoCode << "| " << std::setw(W_OFF) << off.str()
+                      << "| " << std::setw(W_DATES) << dates.str() << "| " << std::setw(W_ACTIVE) << (rule.active ? "yes" : "no") << " |\n";
+        }
+        std::cout << std::string(width, '-') << "\n";
+        auto table = ConcessionEngine::getInstance().current();
+        std::cout << "Compiled table v" << table->version << ": " << table->activeRules << " rules active today.\n";
+        std::string failure = ConcessionEngine::getInstance().compileFailure();
+        if (!failure.empty()) std::cout << "Recompiling failed (" << failure << "); retrying, fares use v" << table->version << " meanwhile.\n";
+
+        std::cout << "\n1. Add Rule\n2. Activate/Deactivate Rule\n3. Back\nEnter your choice: ";
+        int choice = readChoice();
+        if (choice == 1) {
+            ConcessionRule rule;
+            std::cout << "Name: "; std::cin.ignore(); std::getline(std::cin, rule.name);
+            std::cout << "Category (Adult, Child, Student, Senior or * for all): "; std::cin >> rule.category;
+            std::cout << "Class (AC, Sleeper or * for both): "; std::cin >> rule.seatClass;
+            std::cout << "Promo code (- for none): "; std::cin >> rule.promoCode;
+            std::cout << "Percent off: "; std::cin >> rule.percentOff;
+            std::cout << "Flat amount off per passenger: "; std::cin >> rule.flatOff;
+            std::cout << "Valid from (YYYY-MM-DD or -): "; std::cin >> rule.validFrom;
+            std::cout << "Valid to (YYYY-MM-DD or -): "; std::cin >> rule.validTo;
+            for (std::string* field : {&rule.promoCode, &rule.validFrom, &rule.validTo}) {
+                if (*field == "-") field->clear();
+            }
+            ConcessionEngine::Category category;
+            long day = 0;
+            if ((rule.category != "*" && !ConcessionEngine::parseCategory(rule.category, category)) ||
+                (rule.seatClass != "*" && rule.seatClass != "AC" && rule.seatClass != "Sleeper") ||
+                rule.percentOff < 0 || rule.percentOff > 100 || rule.flatOff < 0 ||
+                (!rule.validFrom.empty() && !TimeUtil::parseDate(rule.validFrom, day)) ||
+                (!rule.validTo.empty() && !TimeUtil::parseDate(rule.validTo, day))) {
+                menuStatus = "Invalid rule; nothing was added.";
+            } else if (db.insertRow<Schema::ConcessionRules>(rule)) {
+                ConcessionEngine::getInstance().invalidate();
+                menuStatus = "Rule added; fares use it once the table is recompiled.";
+            } else {
+                menuStatus = "Failed to add rule.";
+            }
+        } else if (choice == 2) {
+            int ruleId = 0;
+            std::cout << "Rule ID: "; std::cin >> ruleId;
+            if (db.executeUpdate("UPDATE concession_rules SET active = 1 - active WHERE rule_id = " + std::to_string(ruleId) + ";") && db.changes() > 0) {
+                ConcessionEngine::getInstance().invalidate();
+                menuStatus = "Rule " + std::to_string(ruleId) + " toggled.";
+            } else {
+                menuStatus = "No rule with ID " + std::to_string(ruleId) + ".";
+            }
+        }
+    }
+
+    void manageCoaches() {
+        METRICS_SCOPE("menu.manageCoaches");
+        std::cout << "--- Coach Composition ---\n";
+        CoachComposition composition;
+        const int W_CODE = 6, W_CLASS = 8, W_BERTHS = 7, W_PREFIX = 7, W_LAYOUT = 30;
+        const int width = W_CODE + W_CLASS + W_BERTHS + W_PREFIX + W_LAYOUT + 16;
+        std::cout << std::string(width, '-') << "\n";
+        std::cout << "| " << std::left << std::setw(W_CODE) << "Type" << "| " << std::setw(W_CLASS) << "Class" << "| " << std::setw(W_BERTHS) << "Berths"
+                  << "| " << std::setw(W_PREFIX) << "Label" << "| " << std::setw(W_LAYOUT) << "Bay layout" << " |\n";
+        std::cout << std::string(width, '-') << "\n";
+        for (const auto& entry : composition.types()) {
+            const CoachType& type = entry.second;
+            std::cout << "| " << std::left << std::setw(W_CODE) << type.code << "| " << std::setw(W_CLASS) << type.seatClass
+                      << "| " << std::setw(W_BERTHS) << type.berths << "| " << std::setw(W_PREFIX) << type.labelPrefix + "1"
+                      << "| " << std::setw(W_LAYOUT) << type.layout.substr(0, W_LAYOUT) << " |\n";
+        }
+        std::cout << std::string(width, '-') << "\n";
+
+        std::cout << "\n1. Set Train's Standard Rake\n2. View Departure Coaches\n3. Add Coach to Departure\n"
+                     "4. Remove Coach from Departure\n5. Add Coach Type\n6. Back\nEnter your choice: ";
+        int choice = readChoice();
+        std::string error, label;
+        int scheduleId = 0;
+        CoachComposition::Departure departure;
+        if (choice == 1) {
+            std::string trainNumber, spec;
+            std::vector<std::string> codes;
+            std::cout << "Train Number: "; std::cin >> trainNumber;
+            std::cout << "Coaches in order (e.g. 1A,2A*2,3A*4,SL*10): "; std::cin >> spec;
+            if (CoachComposition::parseRake(spec, codes, error) && composition.setTrainRake(trainNumber, codes, error)) {
+                menuStatus = trainNumber + " now runs " + std::to_string(codes.size()) + " coaches; departures without their own rake follow it.";
+            } else {
+                menuStatus = "Rake not changed: " + error;
+            }
+        } else if (choice >= 2 && choice <= 4) {
+            std::cout << "Schedule ID: "; std::cin >> scheduleId;
+            bool ok = true;
+            if (choice == 3) {
+                std::string typeCode;
+                std::cout << "Coach type: "; std::cin >> typeCode;
+                ok = composition.addCoach(scheduleId, typeCode, label, error);
+                if (ok) std::cout << "Coach " << label << " added.\n";
+            } else if (choice == 4) {
+                std::cout << "Coach label: "; std::cin >> label;
+                ok = composition.removeCoach(scheduleId, label, error);
+                if (ok) std::cout << "Coach " << label << " removed.\n";
+            }
+            if (ok && composition.loadDeparture(scheduleId, departure, error)) {
+                CoachComposition::printDeparture(departure);
+            } else {
+                std::cout << "Error: " << error << "\n";
+            }
+            pressEnterToContinue();
+        } else if (choice == 5) {
+            CoachType type;
+            std::cout << "Type code: "; std::cin >> type.code;
+            std::cout << "Class (AC or Sleeper): "; std::cin >> type.seatClass;
+            std::cout << "Berths per coach: "; std::cin >> type.berths;
+            std::cout << "Label prefix: "; std::cin >> type.labelPrefix;
+            std::cout << "Berth types of one bay (e.g. LB MB UB SL SU): "; std::cin.ignore(); std::getline(std::cin, type.layout);
+            menuStatus = composition.addType(type, error) ? "Coach type " + type.code + " added." : "Coach type not added: " + error;
         }
+    }
+
+    void viewMetrics() {
+        std::cout << "--- Metrics ---\n";
+        writeMetricsReport(std::cout);
+        std::cout << "\n";
+        StartupWarmup::getInstance().printReport(std::cout);
         pressEnterToContinue();
     }
 
+    // Samples for the given time while the admin keeps using the system; the
+    // folded stacks are written once a menu is shown after the time is up
+    void profileCpu() {
+        std::cout << "--- Profile CPU ---\n";
+        int seconds = 0;
+        std::string path;
+        std::cout << "Seconds to profile: ";
+        std::cin >> seconds;
+        std::cout << "Output file for folded stacks: ";
+        std::cin >> path;
+        std::string error, previous;
+        // A profile that ended since the last menu is written before the next one starts
+        if (CpuProfiler::getInstance().finishIfDue(false, previous)) menuStatus = previous + "\n";
+        if (CpuProfiler::getInstance().start(seconds, path, error)) {
+            menuStatus += "Profiling CPU for " + std::to_string(seconds) + " s.";
+        } else {
+            menuStatus += "Could not start profiler: " + error;
+        }
+    }
+
     // --- User Functionality ---
     void bookTicket() {
+        METRICS_SCOPE("menu.bookTicket");
         std::cout << "--- Book a Ticket ---\n";
-        
-        std::string sql = "SELECT s.schedule_id, t.train_name, t.source, t.destination, s.departure_date, s.ac_seats_available, s.sleeper_seats_available, t.ac_fare, t.sleeper_fare, t.train_number FROM schedules s JOIN trains t ON s.train_number = t.train_number WHERE s.departure_date >= date('now');";
-        auto results = DatabaseManager::getInstance().executeQuery(sql);
+
+        auto results = storage->findSchedules(TimeUtil::formatDate(TimeUtil::today()));
 
         if (results.empty()) {
             std::cout << "No trains are currently scheduled for booking.\n";
@@ -501,74 +8049,76 @@ private:
             return;
         }
 
-        // ============================ FORMATTING FIX START ============================
-        std::cout << "\n--- All Scheduled Journeys ---\n";
-        const int W_ID = 5, W_NAME = 30, W_ROUTE = 30, W_DATE = 12, W_AC = 25, W_SL = 25;
-        std::cout << std::string(W_ID + W_NAME + W_ROUTE + W_DATE + W_AC + W_SL + 19, '-') << std::endl;
-        std::cout << "| " << std::left 
-                  << std::setw(W_ID) << "ID" << "| " 
-                  << std::setw(W_NAME) << "Train Name" << "| " 
-                  << std::setw(W_ROUTE) << "Route" << "| " 
-                  << std::setw(W_DATE) << "Date" << "| " 
-                  << std::setw(W_AC) << "AC Seats (Fare)" << "| " 
-                  << std::setw(W_SL) << "Sleeper Seats (Fare)" << " |" << std::endl;
-        std::cout << std::string(W_ID + W_NAME + W_ROUTE + W_DATE + W_AC + W_SL + 19, '-') << std::endl;
+        {
+            METRICS_SCOPE("render.bookingListing");
+            // ============================ FORMATTING FIX START ============================
+            std::cout << "\n--- All Scheduled Journeys ---\n";
+            const int W_NAME = Terminal::getInstance().fitColumn(30, 5 + 30 + 12 + 25 + 25 + 19, 10);
+            const int W_ID = 5, W_ROUTE = Terminal::getInstance().fitColumn(30, 5 + W_NAME + 12 + 25 + 25 + 19, 12), W_DATE = 12, W_AC = 25, W_SL = 25;
+            std::cout << std::string(W_ID + W_NAME + W_ROUTE + W_DATE + W_AC + W_SL + 19, '-') << std::endl;
+            std::cout << "| " << std::left 
+                      << std::setw(W_ID) << "ID" << "| " 
+                      << std::setw(W_NAME) << "Train Name" << "| " 
+                      << std::setw(W_ROUTE) << "Route" << "| " 
+                      << std::setw(W_DATE) << "Date" << "| " 
+                      << std::setw(W_AC) << "AC Seats (Fare)" << "| " 
+                      << std::setw(W_SL) << "Sleeper Seats (Fare)" << " |" << std::endl;
+            std::cout << std::string(W_ID + W_NAME + W_ROUTE + W_DATE + W_AC + W_SL + 19, '-') << std::endl;
 
-        auto truncate = [](const std::string& str, int width) {
-            if (str.length() > width) return str.substr(0, width - 1) + ".";
-            return str;
-        };
+            auto truncate = [](const std::string& str, int width) {
+                if (str.length() > width) return str.substr(0, width - 1) + ".";
+                return str;
+            };
 
-        for (const auto& row : results) {
-            std::string route = row[2] + " -> " + row[3];
-            std::stringstream ac_info, sleeper_info;
-            ac_info << row[5] << " (Rs " << std::fixed << std::setprecision(2) << std::stod(row[7]) << ")";
-            sleeper_info << row[6] << " (Rs " << std::fixed << std::setprecision(2) << std::stod(row[8]) << ")";
+            for (const auto& row : results) {
+                const Schedule& schedule = row.first;
+                const Train& train = row.second;
+                std::string route = train.source + " -> " + train.destination;
+                std::stringstream ac_info, sleeper_info;
+                ac_info << schedule.acSeatsAvailable << " (Rs " << std::fixed << std::setprecision(2) << train.acFare << ")";
+                sleeper_info << schedule.sleeperSeatsAvailable << " (Rs " << std::fixed << std::setprecision(2) << train.sleeperFare << ")";
 
-            std::cout << "| " << std::left 
-                      << std::setw(W_ID) << row[0] 
-                      << "| " << std::setw(W_NAME) << truncate(row[1], W_NAME) 
-                      << "| " << std::setw(W_ROUTE) << truncate(route, W_ROUTE) 
-                      << "| " << std::setw(W_DATE) << row[4]
-                      << "| " << std::setw(W_AC) << ac_info.str() 
-                      << "| " << std::setw(W_SL) << sleeper_info.str() << " |" << std::endl;
+                std::cout << "| " << std::left 
+                          << std::setw(W_ID) << schedule.scheduleId 
+                          << "| " << std::setw(W_NAME) << truncate(train.name, W_NAME) 
+                          << "| " << std::setw(W_ROUTE) << truncate(route, W_ROUTE) 
+                          << "| " << std::setw(W_DATE) << schedule.departureDate
+                          << "| " << std::setw(W_AC) << ac_info.str() 
+                          << "| " << std::setw(W_SL) << sleeper_info.str() << " |" << std::endl;
+            }
+            std::cout << std::string(W_ID + W_NAME + W_ROUTE + W_DATE + W_AC + W_SL + 19, '-') << std::endl;
+            // ============================ FORMATTING FIX END ============================
         }
-        std::cout << std::string(W_ID + W_NAME + W_ROUTE + W_DATE + W_AC + W_SL + 19, '-') << std::endl;
-        // ============================ FORMATTING FIX END ============================
 
         int scheduleId;
         std::cout << "\nEnter the Schedule ID of the journey you want to book: ";
         std::cin >> scheduleId;
 
-        const std::vector<std::string>* selectedTrainData = nullptr;
-        for(const auto& row : results) {
-            if(std::stoi(row[0]) == scheduleId) {
-                selectedTrainData = &row;
-                break;
-            }
-        }
+        auto selected = std::find_if(results.begin(), results.end(), [&](const std::pair<Schedule, Train>& row) {
+            return row.first.scheduleId == scheduleId;
+        });
         
-        if (!selectedTrainData) {
+        if (selected == results.end()) {
             std::cout << "Invalid ID.\n"; pressEnterToContinue(); return;
         }
         
-        const auto& trainData = *selectedTrainData;
-        int acSeatsAvail = std::stoi(trainData[5]);
-        int sleeperSeatsAvail = std::stoi(trainData[6]);
-        double acFare = std::stod(trainData[7]);
-        double sleeperFare = std::stod(trainData[8]);
+        const Train& train = selected->second;
+        int acSeatsAvail = selected->first.acSeatsAvailable;
+        int sleeperSeatsAvail = selected->first.sleeperSeatsAvailable;
+        double acFare = train.acFare;
+        double sleeperFare = train.sleeperFare;
 
         std::cout << "\nSelect Class:\n1. AC (Fare: " << acFare << ")\n2. Sleeper (Fare: " << sleeperFare << ")\n";
         int choice;
         std::cin >> choice;
 
-        std::string chosenClass, seatColumn;
+        std::string chosenClass;
         int availableSeats = 0;
         double farePerSeat = 0.0;
         if (choice == 1) {
-            chosenClass = "AC"; availableSeats = acSeatsAvail; farePerSeat = acFare; seatColumn = "ac_seats_available";
+            chosenClass = "AC"; availableSeats = acSeatsAvail; farePerSeat = acFare;
         } else if (choice == 2) {
-            chosenClass = "Sleeper"; availableSeats = sleeperSeatsAvail; farePerSeat = sleeperFare; seatColumn = "sleeper_seats_available";
+            chosenClass = "Sleeper"; availableSeats = sleeperSeatsAvail; farePerSeat = sleeperFare;
         } else {
             std::cout << "Invalid choice.\n"; pressEnterToContinue(); return;
         }
@@ -578,15 +8128,46 @@ private:
         std::cin >> numSeats;
 
         if (numSeats <= 0 || numSeats > availableSeats) {
-            std::cout << "Invalid number of seats or not enough seats available.\n"; pressEnterToContinue(); return;
+            std::cout << "Invalid number of seats or not enough seats available.\n";
+            if (numSeats > availableSeats) suggestAlternatives(scheduleId, choice == 1, numSeats);
+            pressEnterToContinue(); return;
         }
 
-        double totalFare = numSeats * farePerSeat;
-        std::string ticketId = generateTicketId();
+        // Each passenger is priced from the compiled concession table
+        auto concessions = ConcessionEngine::getInstance().current();
+        std::string promoCode;
+        std::cout << "Promo code (- for none): ";
+        std::cin >> promoCode;
+        if (promoCode == "-") promoCode.clear();
+        if (!promoCode.empty() && !concessions->knownPromo(promoCode)) {
+            std::cout << "Promo code " << promoCode << " is not valid today and was ignored.\n";
+        }
+        const int promo = concessions->promoSlot(promoCode);
+        std::vector<std::pair<ConcessionEngine::Category, ConcessionEngine::Quote>> passengers;
+        for (int p = 1; p <= numSeats; ++p) {
+            std::cout << "Passenger " << p << " (1. Adult 2. Child 3. Student 4. Senior): ";
+            int category = readChoice();
+            if (category < 1 || category > ConcessionEngine::CATEGORY_COUNT) {
+                std::cout << "Invalid choice.\n"; pressEnterToContinue(); return;
+            }
+            auto cat = static_cast<ConcessionEngine::Category>(category - 1);
+            passengers.emplace_back(cat, concessions->quote(cat, choice == 1, promo, farePerSeat));
+        }
+
+        double totalFare = 0.0;
+        for (const auto& passenger : passengers) totalFare += passenger.second.fare;
+        long long ticket = generateTicket();
 
         std::cout << "\n--- Booking Confirmation ---\n";
-        std::cout << "Train: " << trainData[1] << " (" << trainData[9] << ")\n";
+        std::cout << "Train: " << train.name << " (" << train.number << ")\n";
         std::cout << "Class: " << chosenClass << " | Seats: " << numSeats << "\n";
+        for (size_t p = 0; p < passengers.size(); ++p) {
+            const auto& quote = passengers[p].second;
+            std::cout << "  Passenger " << (p + 1) << " (" << ConcessionEngine::CATEGORY_NAMES[static_cast<int>(passengers[p].first)] << "): "
+                      << std::fixed << std::setprecision(2) << quote.fare;
+            if (!quote.rule.empty()) std::cout << " after " << quote.discount << " off (" << quote.rule << ")";
+            std::cout << "\n";
+        }
         std::cout << "Total Fare: " << std::fixed << std::setprecision(2) << totalFare << "\n";
         
         char confirm;
@@ -594,33 +8175,26 @@ private:
         std::cin >> confirm;
 
         if (confirm == 'y' || confirm == 'Y') {
-            auto& db = DatabaseManager::getInstance();
-            if (!db.beginTransaction()) {
-                std::cout << "Booking failed: Could not start transaction.\n";
-                pressEnterToContinue();
-                return;
-            }
-
-            std::string checkSeatsSql = "SELECT " + seatColumn + " FROM schedules WHERE schedule_id=" + std::to_string(scheduleId) + ";";
-            auto currentSeatsResult = db.executeQuery(checkSeatsSql);
-            if (currentSeatsResult.empty() || std::stoi(currentSeatsResult[0][0]) < numSeats) {
-                db.rollback();
-                std::cout << "Booking failed: Seats were taken by another user.\n";
-                pressEnterToContinue();
-                return;
-            }
-            
-            int currentAvailableSeats = std::stoi(currentSeatsResult[0][0]);
-
-            std::string bookingSql = "INSERT INTO bookings (ticket_id, username, schedule_id, class, num_seats, total_fare) VALUES ('" + ticketId + "', '" + loggedInUsername + "', " + std::to_string(scheduleId) + ", '" + chosenClass + "', " + std::to_string(numSeats) + ", " + std::to_string(totalFare) + ");";
-            std::string updateSql = "UPDATE schedules SET " + seatColumn + " = " + std::to_string(currentAvailableSeats - numSeats) + " WHERE schedule_id=" + std::to_string(scheduleId) + ";";
+            Booking booking;
+            booking.scheduleId = scheduleId;
+            booking.ticket = ticket;
+            booking.userId = loggedInUserId;
+            booking.seatClass = chosenClass;
+            booking.numSeats = numSeats;
+            booking.totalFare = totalFare;
 
-            if (db.executeUpdate(bookingSql) && db.executeUpdate(updateSql)) {
-                db.commit();
-                std::cout << "Booking successful! Your Ticket ID is " << ticketId << "\n";
-            } else {
-                db.rollback();
-                std::cout << "Booking failed due to a database error.\n";
+            switch (storage->reserveSeats(booking)) {
+                case StorageBackend::ReserveStatus::Reserved:
+                    std::cout << "Booking successful! Your Ticket ID is TKT" << ticket << "\n";
+                    break;
+                case StorageBackend::ReserveStatus::NotEnoughSeats:
+                case StorageBackend::ReserveStatus::NoSuchSchedule:
+                    std::cout << "Booking failed: Seats were taken by another user.\n";
+                    suggestAlternatives(scheduleId, choice == 1, numSeats);
+                    break;
+                case StorageBackend::ReserveStatus::Failed:
+                    std::cout << "Booking failed due to a database error.\n";
+                    break;
             }
         } else {
             std::cout << "Booking cancelled.\n";
@@ -628,77 +8202,520 @@ private:
         pressEnterToContinue();
     }
 
+    void suggestAlternatives(int scheduleId, bool ac, int numSeats) {
+        auto& cache = AvailabilityCache::getInstance();
+        cache.ensureLoaded();
+        auto start = std::chrono::steady_clock::now();
+        auto suggestions = AlternativesEngine().suggest(scheduleId, ac, numSeats);
+        auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        AlternativesEngine::print(suggestions);
+        std::cout << "(alternatives computed in " << std::fixed << std::setprecision(1) << elapsed << " us)\n";
+    }
+
     void viewMyBookings() {
+        METRICS_SCOPE("menu.viewMyBookings");
         std::cout << "--- My Bookings ---\n";
-        std::string sql = "SELECT b.ticket_id, t.train_name, t.source, t.destination, s.departure_date, t.departure_time, t.journey_duration, b.class, b.num_seats, b.total_fare FROM bookings b JOIN schedules s ON b.schedule_id = s.schedule_id JOIN trains t ON s.train_number = t.train_number WHERE b.username='" + loggedInUsername + "';";
-        auto results = DatabaseManager::getInstance().executeQuery(sql);
+        std::vector<StorageBackend::BookingView> results;
+        std::string reason;
+        if (!storage->listBookingsForUser(loggedInUserId, results, reason)) {
+            std::cout << "Could not load your bookings" << (reason.empty() ? "" : ": " + reason) << ". Please try again.\n";
+            pressEnterToContinue();
+            return;
+        }
+        auto& runningStatus = RunningStatusBoard::getInstance();
+        runningStatus.sync();
 
         if (results.empty()) {
             std::cout << "You have no bookings.\n";
         } else {
             for (const auto& row : results) {
+                const Booking& booking = row.booking;
+                const Train& train = row.train;
+                std::cout << "\n========================================\n";
+                std::cout << "  Ticket ID:      TKT" << booking.ticket << "\n";
+                std::cout << "----------------------------------------\n";
+                std::cout << "  Train:          " << train.name << "\n";
+                std::cout << "  Route:          " << train.source << " -> " << train.destination << "\n";
+                std::cout << "  Departure:      " << row.departureDate << " at " << train.departureTime << "\n";
+                std::cout << "  Arrival:        " << TimeUtil::calculateArrival(row.departureDate, train.departureTime, train.journeyDuration) << "\n";
+                int delay = runningStatus.arrivalDelay(booking.scheduleId);
+                if (delay != 0) {
+                    long day = 0;
+                    TimeUtil::parseDate(row.departureDate, day);
+                    long eta = day * 1440 + TimeUtil::parseClock(train.departureTime) + TimeUtil::parseClock(train.journeyDuration) + delay;
+                    std::cout << "  Expected:       " << TimeUtil::formatDateTime(eta) << " (" << (delay > 0 ? "+" : "") << delay << " min)\n";
+                }
+                std::cout << "  Class:          " << booking.seatClass << "\n";
+                std::cout << "  Seats:          " << booking.numSeats << "\n";
+                std::cout << "  Total Fare:     Rs " << std::fixed << std::setprecision(2) << booking.totalFare << "\n";
+                std::cout << "========================================\n";
+            }
+        }
+        pressEnterToContinue();
+    }
+
+    void searchJourneys() {
+        METRICS_SCOPE("menu.searchJourneys");
+        std::cout << "--- Search Journeys ---\n";
+        std::string origin, destination, date, earliest;
+        std::cout << "Enter Origin Station: "; std::cin.ignore(); std::getline(std::cin, origin);
+        std::cout << "Enter Destination Station: "; std::getline(std::cin, destination);
+        std::cout << "Enter Travel Date (YYYY-MM-DD): "; std::cin >> date;
+        std::cout << "Leave no earlier than (HH:MM): "; std::cin >> earliest;
+
+        // Rebuild the flat timetable only when the date or the timetable itself changed
+        auto stamp = DatabaseManager::getInstance().executeQuery(
+            "SELECT (SELECT COUNT(*) FROM trains), (SELECT COUNT(*) FROM train_stops), (SELECT COUNT(*) FROM schedules), (SELECT MAX(schedule_id) FROM schedules);");
+        std::string currentStamp = date + "|" + std::to_string(TimetableCatalog::getInstance().current()->version);
+        for (const auto& value : stamp[0]) currentStamp += "|" + value;
+        if (currentStamp != plannerStamp) {
+            if (!planner.build(date)) {
+                std::cout << "Invalid date.\n"; pressEnterToContinue(); return;
+            }
+            plannerStamp = currentStamp;
+        }
+
+        // Nearby stations (or all of a city's stations) are searched as alternative ends
+        auto lookupStart = std::chrono::steady_clock::now();
+        auto origins = placeStations(origin), destinations = placeStations(destination);
+        auto lookup = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - lookupStart).count();
+        printAlternativeStations("from", origin, origins);
+        printAlternativeStations("to", destination, destinations);
+        std::vector<std::string> originNames, destinationNames;
+        for (const auto& place : origins) originNames.push_back(place.name);
+        for (const auto& place : destinations) destinationNames.push_back(place.name);
+
+        auto start = std::chrono::steady_clock::now();
+        auto journeys = planner.search(originNames, destinationNames, static_cast<int>(TimeUtil::parseClock(earliest)));
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (journeys.empty()) {
+            std::cout << "No journeys found.\n";
+        } else {
+            for (const auto& journey : journeys) {
                 std::cout << "\n========================================\n";
-                std::cout << "  Ticket ID:      " << row[0] << "\n";
+                std::cout << "  Arrival:        " << planner.formatTime(journey.arrival) << "\n";
+                std::cout << "  Fare from:      Rs " << std::fixed << std::setprecision(2) << journey.fare << "\n";
+                std::cout << "  Transfers:      " << journey.transfers << "\n";
                 std::cout << "----------------------------------------\n";
-                std::cout << "  Train:          " << row[1] << "\n";
-                std::cout << "  Route:          " << row[2] << " -> " << row[3] << "\n";
-                std::cout << "  Departure:      " << row[4] << " at " << row[5] << "\n";
-                std::cout << "  Arrival:        " << TimeUtil::calculateArrival(row[4], row[5], row[6]) << "\n";
-                std::cout << "  Class:          " << row[7] << "\n";
-                std::cout << "  Seats:          " << row[8] << "\n";
-                std::cout << "  Total Fare:     Rs " << std::fixed << std::setprecision(2) << std::stod(row[9]) << "\n";
+                for (const auto& leg : journey.legs) {
+                    std::cout << "  " << leg.trainNumber << " (schedule " << leg.scheduleId << "): " << leg.from << " "
+                              << planner.formatTime(leg.departure) << " -> " << leg.to << " " << planner.formatTime(leg.arrival) << "\n";
+                }
                 std::cout << "========================================\n";
             }
         }
+        std::cout << "\nSearch took " << std::fixed << std::setprecision(3) << elapsed << " ms (nearby stations: "
+                  << std::setprecision(1) << lookup << " us).\n";
         pressEnterToContinue();
     }
 
+    static const int NEARBY_KM = 25;
+    static const int MAX_NEARBY_STATIONS = 4;
+
+    // The place itself (or every station of a city of that name) followed by the
+    // nearest other stations within NEARBY_KM; just the place when it has no position
+    static std::vector<StationIndex::Nearby> placeStations(const std::string& place) {
+        auto& index = StationIndex::getInstance();
+        double latitude = 0, longitude = 0;
+        if (!index.locate(place, latitude, longitude)) return {{place, "", 0.0}};
+        auto cityStations = index.cityStations(place);
+        if (cityStations.empty()) cityStations.push_back(place);
+        std::vector<StationIndex::Nearby> result;
+        for (const auto& name : cityStations) {
+            double stationLatitude = 0, stationLongitude = 0;
+            index.locate(name, stationLatitude, stationLongitude);
+            result.push_back({name, "", name == place ? 0.0 : StationIndex::distanceKm(latitude, longitude, stationLatitude, stationLongitude)});
+        }
+        size_t extra = 0;
+        for (auto& near : index.nearest(latitude, longitude, cityStations.size() + MAX_NEARBY_STATIONS)) {
+            if (extra == MAX_NEARBY_STATIONS || near.km > NEARBY_KM) break;
+            if (std::find(cityStations.begin(), cityStations.end(), near.name) != cityStations.end()) continue;
+            result.push_back(near);
+            extra++;
+        }
+        return result;
+    }
+
+    static void printAlternativeStations(const char* direction, const std::string& place, const std::vector<StationIndex::Nearby>& stations) {
+        if (stations.size() < 2 && (stations.empty() || stations[0].name == place)) return;
+        std::cout << "Also searching " << direction << ":";
+        for (const auto& station : stations) {
+            if (station.name == place) continue;
+            std::cout << " " << station.name << " (" << std::fixed << std::setprecision(1) << station.km << " km)";
+        }
+        std::cout << "\n";
+    }
+
     void cancelTicket() {
+        METRICS_SCOPE("menu.cancelTicket");
         std::cout << "--- Cancel a Ticket ---\n";
         std::string ticketId;
         std::cout << "Enter Ticket ID to cancel: ";
         std::cin >> ticketId;
+        long long ticket = parseTicket(ticketId);
 
-        auto& db = DatabaseManager::getInstance();
+        Booking released;
+        switch (storage->releaseSeats(ticket, loggedInUserId, released)) {
+            case StorageBackend::ReleaseStatus::Released: std::cout << "Ticket cancelled successfully!\n"; break;
+            case StorageBackend::ReleaseStatus::NoSuchBooking: std::cout << "Invalid Ticket ID or you do not own this ticket.\n"; break;
+            case StorageBackend::ReleaseStatus::Failed: std::cout << "Cancellation failed due to a database error.\n"; break;
+        }
+        pressEnterToContinue();
+    }
+};
 
-        if (!db.beginTransaction()) {
-            std::cout << "Cancellation failed: Could not start transaction.\n";
-            pressEnterToContinue(); return;
+// ===================================================================
+//  Main Function
+// ===================================================================
+int main(int argc, char* argv[]) {
+    dumpMetricsAtExit();
+
+    // Profile any mode from startup: RAILWAY_PROFILE=<SECONDS>:<PATH>
+    if (const char* profile = std::getenv("RAILWAY_PROFILE")) {
+        std::string spec = profile, error;
+        size_t colon = spec.find(':');
+        int seconds = colon == std::string::npos ? 0 : std::atoi(spec.substr(0, colon).c_str());
+        if (!CpuProfiler::getInstance().start(seconds, colon == std::string::npos ? "" : spec.substr(colon + 1), error)) {
+            std::cerr << "RAILWAY_PROFILE: " << (seconds > 0 ? error : "expected <SECONDS>:<PATH>") << std::endl;
+        } else {
+            std::atexit([] {
+                std::string summary;
+                if (CpuProfiler::getInstance().finishIfDue(true, summary)) std::cerr << summary << std::endl;
+            });
         }
+    }
+
+    // Non-interactive mode for cron: railway3 --reconcile [--fix]
+    if (argc > 1 && std::strcmp(argv[1], "--reconcile") == 0) {
+        bool autoCorrect = argc > 2 && std::strcmp(argv[2], "--fix") == 0;
+        SeatReconciler reconciler;
+        auto report = reconciler.run(autoCorrect);
+        SeatReconciler::printReport(report);
+        return static_cast<int>(report.discrepancies.size()) == report.corrected ? 0 : 2;
+    }
 
-        std::string sql = "SELECT schedule_id, class, num_seats FROM bookings WHERE ticket_id='" + ticketId + "' AND username='" + loggedInUsername + "';";
-        auto results = db.executeQuery(sql);
+    // Seasonal timetable rollout: railway3 --rollout <TRAINS|ALL> <FROM> <TO> [MASK]
+    if (argc > 4 && std::strcmp(argv[1], "--rollout") == 0) {
+        ScheduleRollout rollout;
+        auto result = rollout.run(RailwaySystem::splitList(argv[2]), argv[3], argv[4], argc > 5 ? argv[5] : "1111111");
+        if (!result.ok) {
+            std::cerr << "Rollout failed: " << result.error << std::endl;
+            return 1;
+        }
+        std::cout << result.inserted << " departures scheduled, " << (result.requested - result.inserted) << " already existed.\n";
+        return 0;
+    }
 
-        if (results.empty()) {
-            db.rollback();
-            std::cout << "Invalid Ticket ID or you do not own this ticket.\n"; 
-            pressEnterToContinue(); 
-            return;
+    // Live running events from a file, FIFO or stdin ("-"): railway3 --ingest-status <PATH|->
+    if (argc > 2 && std::strcmp(argv[1], "--ingest-status") == 0) {
+        RunningStatusFeed feed;
+        RunningStatusFeed::Stats stats;
+        if (std::strcmp(argv[2], "-") == 0) {
+            stats = feed.ingest(std::cin);
+        } else {
+            std::ifstream feedFile(argv[2]);
+            if (!feedFile) {
+                std::cerr << "Could not open " << argv[2] << std::endl;
+                return 1;
+            }
+            stats = feed.ingest(feedFile);
+        }
+        std::cout << stats.events << " events applied, " << stats.rejected << " rejected, "
+                  << stats.estimatesChanged << " stop estimates updated.\n";
+        return 0;
+    }
+
+    // Timetable delta without downtime: railway3 --reload-timetable <PATH|->
+    if (argc > 2 && std::strcmp(argv[1], "--reload-timetable") == 0) {
+        TimetableReload reload;
+        TimetableReload::Result result;
+        if (std::strcmp(argv[2], "-") == 0) {
+            result = reload.run(std::cin);
+        } else {
+            std::ifstream file(argv[2]);
+            if (!file) {
+                std::cerr << "Could not open " << argv[2] << std::endl;
+                return 1;
+            }
+            result = reload.run(file);
+        }
+        RailwaySystem::printReloadResult(result, result.ok ? std::cout : std::cerr);
+        return result.ok ? 0 : 1;
+    }
+
+    // Storage layer benchmark: railway3 --bench-storage <sqlite|memory|log> [BOOKINGS]
+    if (argc > 2 && std::strcmp(argv[1], "--bench-storage") == 0) {
+        std::unique_ptr<StorageBackend> storage = createStorage(argv[2]);
+        if (!storage) {
+            std::cerr << "Unknown backend " << argv[2] << " (expected sqlite, memory or log)" << std::endl;
+            return 1;
+        }
+#ifndef _WIN32
+        auto* opened = dynamic_cast<LogStorage*>(storage.get());
+        if (opened && !opened->isOpen()) return 1; // the log has said why
+#endif
+        int bookings = argc > 3 ? std::atoi(argv[3]) : 10000;
+        StorageBenchmark benchmark;
+        StorageBenchmark::print(storage->name(), benchmark.run(*storage, bookings));
+#ifndef _WIN32
+        if (auto* log = dynamic_cast<LogStorage*>(storage.get())) {
+            auto stats = log->stats();
+            std::cout << "Log: " << stats.liveBookings << " live bookings, " << stats.segments << " segments, " << stats.liveBytes
+                      << " of " << stats.totalBytes << " bytes live, " << stats.compactions << " compactions; opened "
+                      << (stats.fromSnapshot ? "from snapshot" : "by full replay") << " after " << stats.recordsReplayed << " records.\n";
+        }
+#endif
+        return 0;
+    }
+
+    // Coroutine database API under load: railway3 --bench-async [REQUESTS] [DB_THREADS]
+    if (argc > 1 && std::strcmp(argv[1], "--bench-async") == 0) {
+#if RAILWAY_HAS_COROUTINES
+        int requests = argc > 2 ? std::atoi(argv[2]) : 10000;
+        int databaseThreads = argc > 3 ? std::atoi(argv[3]) : 4;
+        if (requests < 1 || databaseThreads < 1) {
+            std::cerr << "Usage: --bench-async [REQUESTS] [DB_THREADS]" << std::endl;
+            return 1;
+        }
+        const int executorThreads = 2;
+        AsyncBenchmark benchmark;
+        auto result = benchmark.run(requests, executorThreads, databaseThreads);
+        AsyncBenchmark::print(result, executorThreads, databaseThreads);
+        return result.failed == 0 ? 0 : 1;
+#else
+        std::cerr << "--bench-async needs a build with C++20 coroutines (-std=c++20)." << std::endl;
+        return 1;
+#endif
+    }
+
+    // Station coordinates: railway3 --import-stations <PATH|->
+    if (argc > 2 && std::strcmp(argv[1], "--import-stations") == 0) {
+        std::ifstream file;
+        if (std::strcmp(argv[2], "-") != 0) {
+            file.open(argv[2]);
+            if (!file) {
+                std::cerr << "Could not open " << argv[2] << std::endl;
+                return 1;
+            }
+        }
+        int imported = 0;
+        std::string error;
+        if (!StationIndex::getInstance().import(std::strcmp(argv[2], "-") == 0 ? std::cin : file, imported, error)) {
+            std::cerr << "Station import failed, nothing was changed: " << error << std::endl;
+            return 1;
+        }
+        std::cout << imported << " stations imported.\n";
+        return 0;
+    }
+
+    // Standard rake of a train: railway3 --set-rake <TRAIN> <TYPE[*COUNT],...>
+    if (argc > 3 && std::strcmp(argv[1], "--set-rake") == 0) {
+        CoachComposition composition;
+        std::vector<std::string> codes;
+        std::string error;
+        if (!CoachComposition::parseRake(argv[3], codes, error) || !composition.setTrainRake(argv[2], codes, error)) {
+            std::cerr << "Could not set rake: " << error << std::endl;
+            return 1;
+        }
+        auto trains = DatabaseManager::getInstance().selectRows<Schema::Trains>("WHERE train_number = ?", {argv[2]});
+        std::cout << argv[2] << " now runs " << codes.size() << " coaches: " << trains[0].totalAcSeats << " AC and "
+                  << trains[0].totalSleeperSeats << " Sleeper seats.\n";
+        return 0;
+    }
+
+    // One departure's coaches: railway3 --add-coach <SCHEDULE_ID> <TYPE>, --remove-coach <SCHEDULE_ID> <LABEL>
+    if (argc > 3 && (std::strcmp(argv[1], "--add-coach") == 0 || std::strcmp(argv[1], "--remove-coach") == 0)) {
+        CoachComposition composition;
+        CoachComposition::Departure departure;
+        int scheduleId = std::atoi(argv[2]);
+        std::string label = argv[3], error;
+        bool adding = std::strcmp(argv[1], "--add-coach") == 0;
+        if (!(adding ? composition.addCoach(scheduleId, argv[3], label, error) : composition.removeCoach(scheduleId, label, error))) {
+            std::cerr << "Could not " << (adding ? "add" : "remove") << " coach: " << error << std::endl;
+            return 1;
+        }
+        std::cout << "Coach " << label << (adding ? " added.\n" : " removed.\n");
+        if (composition.loadDeparture(scheduleId, departure, error)) CoachComposition::printDeparture(departure);
+        return 0;
+    }
+
+    // Cold-start measurement: railway3 --warmup [--skip]
+    if (argc > 1 && std::strcmp(argv[1], "--warmup") == 0) {
+        auto& warmup = StartupWarmup::getInstance();
+        if (argc > 2 && std::strcmp(argv[2], "--skip") == 0) warmup.skip(); else warmup.run();
+        warmup.printReport(std::cout);
+        StartupWarmup::probeFirstRequests(std::cout);
+        return 0;
+    }
+
+    // Shared-memory availability: railway3 --board [--publish SECONDS | --watch SECONDS] [SCHEDULE_ID...]
+    if (argc > 1 && std::strcmp(argv[1], "--board") == 0) {
+        auto& board = AvailabilityBoard::getInstance();
+        const char* name = std::getenv("RAILWAY_BOARD");
+        if (!name || !*name) {
+            std::cerr << "Set RAILWAY_BOARD to the shared-memory name, for example RAILWAY_BOARD=/railway-board" << std::endl;
+            return 1;
+        }
+        std::string mode;
+        int seconds = 0, arg = 2;
+        if (argc > 2 && (std::strcmp(argv[2], "--publish") == 0 || std::strcmp(argv[2], "--watch") == 0)) {
+            mode = argv[2] + 2;
+            seconds = argc > 3 ? std::atoi(argv[3]) : 60;
+            arg = 4;
         }
+        const auto until = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
 
-        int scheduleId = std::stoi(results[0][0]);
-        std::string seatClass = results[0][1];
-        int numSeats = std::stoi(results[0][2]);
-        std::string seatColumn = (seatClass == "AC") ? "ac_seats_available" : "sleeper_seats_available";
+        if (mode == "publish") {
+            // Publishes for a database that other processes write: reread the counters every second
+            auto& cache = AvailabilityCache::getInstance();
+            do {
+                cache.load();
+                if (!board.publishing()) return 1;
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+            } while (std::chrono::steady_clock::now() < until);
+            std::cout << "Published " << cache.allDepartures().size() << " departures to " << name << ", board version " << board.version() << "\n";
+            return 0;
+        }
+
+        std::string error;
+        if (!board.attach(error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        std::vector<int> ids;
+        for (; arg < argc; ++arg) ids.push_back(std::atoi(argv[arg]));
+        std::cout << "Board " << name << ": publisher pid " << board.publisherPid() << ", version " << board.version()
+                  << (board.publisherAlive() ? "" : " (publisher has exited; counts may be stale)") << "\n";
 
-        std::string deleteSql = "DELETE FROM bookings WHERE ticket_id='" + ticketId + "';";
-        std::string updateSql = "UPDATE schedules SET " + seatColumn + " = " + seatColumn + " + " + std::to_string(numSeats) + " WHERE schedule_id=" + std::to_string(scheduleId) + ";";
+        if (mode == "watch") {
+            unsigned long long seen = board.version();
+            int reportedDead = -1;
+            while (std::chrono::steady_clock::now() < until) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                unsigned long long now = board.version();
+                if (now == seen) {
+                    int pid = board.publisherPid();
+                    if (pid != reportedDead && !board.publisherAlive()) {
+                        std::cout << (pid ? "Publisher " + std::to_string(pid) + " has exited" : std::string("The board was removed"))
+                                  << "; waiting for a new publisher.\n";
+                        reportedDead = pid;
+                    }
+                    continue;
+                }
+                std::vector<AvailabilityBoard::Seats> changed;
+                for (const auto& row : board.changedSince(seen)) {
+                    if (ids.empty() || std::find(ids.begin(), ids.end(), row.scheduleId) != ids.end()) changed.push_back(row);
+                }
+                seen = now;
+                if (changed.empty()) continue;
+                std::cout << "Version " << now << ":\n";
+                AvailabilityBoard::printSeats(std::cout, changed);
+            }
+            return 0;
+        }
 
-        if (db.executeUpdate(deleteSql) && db.executeUpdate(updateSql)) {
-            db.commit();
-            std::cout << "Ticket cancelled successfully!\n";
+        std::vector<AvailabilityBoard::Seats> rows;
+        if (ids.empty()) {
+            for (const auto& row : board.changedSince(0)) {
+                if (row.present) rows.push_back(row);
+            }
+            std::cout << rows.size() << " departures on the board; the 10 changed most recently:\n";
+            std::sort(rows.begin(), rows.end(), [](const AvailabilityBoard::Seats& a, const AvailabilityBoard::Seats& b) { return a.version > b.version; });
+            if (rows.size() > 10) rows.resize(10);
         } else {
-            db.rollback();
-            std::cout << "Cancellation failed due to a database error.\n";
+            for (int id : ids) {
+                AvailabilityBoard::Seats seats;
+                if (board.read(id, seats)) rows.push_back(seats); else std::cout << "Schedule " << id << " is not on the board.\n";
+            }
         }
-        pressEnterToContinue();
+        AvailabilityBoard::printSeats(std::cout, rows);
+        if (!rows.empty()) {
+            const int READS = 1000000;
+            AvailabilityBoard::Seats seats;
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < READS; ++i) {
+                board.read(rows[i % rows.size()].scheduleId, seats);
+            }
+            double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / READS;
+            std::cout << READS << " reads: " << std::fixed << std::setprecision(1) << nanos << " ns each, " << board.retries()
+                      << " retried\n";
+        }
+        return 0;
+    }
+
+    // Hot departure sell-out: railway3 --bench-escrow [SEATS] [THREADS]
+    if (argc > 1 && std::strcmp(argv[1], "--bench-escrow") == 0) {
+        int seats = argc > 2 ? std::atoi(argv[2]) : 10000;
+        int threads = argc > 3 ? std::atoi(argv[3]) : static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+        if (seats < 1 || threads < 1) {
+            std::cerr << "Usage: --bench-escrow [SEATS] [THREADS]" << std::endl;
+            return 1;
+        }
+        EscrowBenchmark benchmark;
+        std::vector<EscrowBenchmark::Result> results = {benchmark.run(false, seats, threads), benchmark.run(true, seats, threads)};
+        EscrowBenchmark::print(results, seats, threads);
+        return std::all_of(results.begin(), results.end(), [](const EscrowBenchmark::Result& r) { return r.exact; }) ? 0 : 1;
+    }
+
+    // Shared-nothing scaling: railway3 --bench-partitioned [OPERATIONS] [WORKERS]
+    if (argc > 1 && std::strcmp(argv[1], "--bench-partitioned") == 0) {
+        int operations = argc > 2 ? std::atoi(argv[2]) : 200000;
+        int workers = argc > 3 ? std::atoi(argv[3]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        if (operations < 1 || workers < 1) {
+            std::cerr << "Usage: --bench-partitioned [OPERATIONS] [WORKERS]" << std::endl;
+            return 1;
+        }
+        PartitionBenchmark benchmark;
+        std::vector<PartitionBenchmark::Result> results = {benchmark.runShared(workers, operations)};
+        for (int w = 1; w < workers; w *= 2) results.push_back(benchmark.runPartitioned(w, workers, operations));
+        results.push_back(benchmark.runPartitioned(workers, workers, operations));
+        PartitionBenchmark::print(results);
+        return std::all_of(results.begin(), results.end(), [](const PartitionBenchmark::Result& r) { return r.conserved; }) ? 0 : 1;
+    }
+
+    // Synthetic data: railway3 --generate [--seed N] [--stations N] [--trains N] [--days N]
+    //                                     [--start DATE] [--users N] [--bookings N] [--zipf S]
+    if (argc > 1 && std::strcmp(argv[1], "--generate") == 0) {
+        DatasetGenerator::Options options;
+        for (int i = 2; i < argc; i += 2) {
+            std::string flag = argv[i];
+            if (i + 1 == argc) {
+                std::cerr << "Missing value for " << flag << std::endl;
+                return 1;
+            }
+            std::string value = argv[i + 1];
+            size_t used = value.size();
+            try {
+                if (flag == "--seed") options.seed = std::stoull(value, &used);
+                else if (flag == "--stations") options.stations = std::stoi(value, &used);
+                else if (flag == "--trains") options.trains = std::stoi(value, &used);
+                else if (flag == "--days") options.days = std::stoi(value, &used);
+                else if (flag == "--start") options.startDate = value;
+                else if (flag == "--users") options.users = std::stoll(value, &used);
+                else if (flag == "--bookings") options.bookings = std::stoll(value, &used);
+                else if (flag == "--zipf") options.zipfExponent = std::stod(value, &used);
+                else {
+                    std::cerr << "Unknown option " << flag << std::endl;
+                    return 1;
+                }
+            } catch (const std::exception&) {
+                used = 0;
+            }
+            if (used != value.size()) {
+                std::cerr << "Invalid value for " << flag << ": " << value << std::endl;
+                return 1;
+            }
+        }
+        DatasetGenerator generator;
+        DatasetGenerator::Stats stats;
+        bool ok = generator.run(options, stats);
+        std::cout << stats.trains << " trains, " << stats.stops << " stops, " << stats.schedules << " departures, "
+                  << stats.users << " users, " << stats.bookings << " bookings in " << std::fixed << std::setprecision(1)
+                  << stats.seconds << " s.\n";
+        return ok ? 0 : 1;
     }
-};
 
-// ===================================================================
-//  Main Function
-// ===================================================================
-int main() {
     RailwaySystem app;
     app.run();
     return 0;